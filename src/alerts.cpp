@@ -0,0 +1,241 @@
+#include "alerts.h"
+#include <algorithm>
+#include <queue>
+
+int AlertEngine::stageAt(int day, int expiry, int nearDays) {
+    if (expiry == kNoExpiry) return 0;
+    if (day > expiry) return 2;
+    return day >= expiry - nearDays ? 1 : 0;
+}
+
+void AlertEngine::reset(int day, const std::vector<std::string> &lowReported) {
+    started = true;
+    seeding = true;
+    current = day;
+    records.clear();
+    wheel.assign(kSlots, std::vector<Timer>());
+    lowFlagged = std::unordered_set<std::string>(lowReported.begin(), lowReported.end());
+    nearSet.clear();
+    expiredSet.clear();
+    heap.clear();
+    heapPos.clear();
+}
+
+void AlertEngine::finishSeed() {
+    seeding = false;
+    // 名单中已不在目录里的药品
+    for (auto it = lowFlagged.begin(); it != lowFlagged.end(); ) {
+        if (records.count(*it)) ++it;
+        else it = lowFlagged.erase(it);
+    }
+}
+
+void AlertEngine::setStage(const std::string &name, Record &r, int stage, bool report) {
+    if (stage == r.stage) return;
+    if (stage == 1) nearSet.insert(name); else nearSet.erase(name);
+    if (stage == 2) expiredSet.insert(name); else expiredSet.erase(name);
+    if (report) pending.push_back(Alert{ stage == 2 ? AlertKind::Expired : AlertKind::NearExpiry, name, current, r.expiry, r.nearDays });
+    r.stage = stage;
+}
+
+// 只挂下一次状态变化：正常 -> 临期（到期日 - 阈值），临期 -> 过期（到期日次日）；已过期或不参与时不挂
+void AlertEngine::schedule(const std::string &name, Record &r) {
+    int due = INT_MAX;
+    if (r.expiry != kNoExpiry && r.stage < 2) due = r.stage == 0 ? r.expiry - r.nearDays : r.expiry + 1;
+    if (due == r.due && (r.timer != 0 || due == INT_MAX)) return;
+    r.due = due;
+    r.timer = 0;
+    if (due == INT_MAX) return;
+    r.timer = ++nextTimer;
+    wheel[static_cast<size_t>((due % kSlots + kSlots) % kSlots)].push_back(Timer{ name, due, r.timer });
+}
+
+void AlertEngine::noteStock(const std::string &name, int stock) {
+    heapSet(name, stock);
+    const bool low = stock < lowThreshold;
+    auto it = lowFlagged.find(name);
+    if (low && it == lowFlagged.end()) {
+        lowFlagged.insert(name);
+        pending.push_back(Alert{ AlertKind::LowStock, name, current, stock, lowThreshold });
+    } else if (!low && it != lowFlagged.end()) {
+        lowFlagged.erase(it);
+    }
+}
+
+void AlertEngine::update(const std::string &name, int stock, int expiryDay, int nearDays) {
+    if (!started) return;
+    auto ins = records.emplace(name, Record());
+    Record &r = ins.first->second;
+    if (ins.second || r.stock != stock) {
+        r.stock = stock;
+        noteStock(name, stock);
+    }
+    if (ins.second || r.expiry != expiryDay || r.nearDays != nearDays) {
+        r.expiry = expiryDay;
+        r.nearDays = nearDays;
+        const int stage = stageAt(current, expiryDay, nearDays);
+        setStage(name, r, stage, !seeding && stage > r.stage);
+        schedule(name, r);
+    }
+}
+
+void AlertEngine::remove(const std::string &name) {
+    if (!records.erase(name)) return; // 槽中的定时器找不到记录，轮到时丢弃
+    heapRemove(name);
+    lowFlagged.erase(name);
+    nearSet.erase(name);
+    expiredSet.erase(name);
+}
+
+void AlertEngine::rename(const std::string &from, const std::string &to) {
+    auto it = records.find(from);
+    if (it == records.end() || from == to) return;
+    Record r = it->second;
+    remove(from);
+    if (r.stock < lowThreshold) lowFlagged.insert(to);
+    if (r.stage == 1) nearSet.insert(to);
+    if (r.stage == 2) expiredSet.insert(to);
+    heapSet(to, r.stock);
+    r.timer = 0;
+    Record &nr = records[to] = r;
+    nr.due = INT_MAX;
+    schedule(to, nr);
+}
+
+void AlertEngine::advance(int today) {
+    if (!started || today <= current) return;
+    const int span = today - current;
+    const int first = current + 1;
+    current = today;
+    // 间隔不少于一圈时每个槽只需处理一次
+    const int visit = span < kSlots ? span : kSlots;
+    for (int k = 0; k < visit; ++k) {
+        std::vector<Timer> &slot = wheel[static_cast<size_t>(((first + k) % kSlots + kSlots) % kSlots)];
+        for (size_t i = 0; i < slot.size(); ) {
+            auto it = records.find(slot[i].name);
+            if (it != records.end() && it->second.timer == slot[i].id && slot[i].due > today) { ++i; continue; }
+            const bool live = it != records.end() && it->second.timer == slot[i].id;
+            const std::string name = slot[i].name;
+            slot[i] = std::move(slot.back());
+            slot.pop_back();
+            if (!live) continue;
+            Record &r = it->second;
+            r.timer = 0;
+            const int stage = stageAt(today, r.expiry, r.nearDays);
+            setStage(name, r, stage, stage > r.stage);
+            schedule(name, r);
+        }
+    }
+}
+
+std::vector<Alert> AlertEngine::takePending() {
+    std::vector<Alert> out;
+    out.swap(pending);
+    return out;
+}
+
+void AlertEngine::setLowStockThreshold(int units) {
+    if (units == lowThreshold) return;
+    const int old = lowThreshold;
+    lowThreshold = units;
+    if (!started) return;
+    if (units < old) {
+        for (auto it = lowFlagged.begin(); it != lowFlagged.end(); ) {
+            auto rec = records.find(*it);
+            if (rec != records.end() && rec->second.stock >= units) it = lowFlagged.erase(it);
+            else ++it;
+        }
+        return;
+    }
+    // 阈值提高：只遍历堆中库存低于新阈值的子树
+    std::vector<size_t> stack;
+    if (!heap.empty() && heap[0].stock < units) stack.push_back(0);
+    while (!stack.empty()) {
+        const size_t i = stack.back();
+        stack.pop_back();
+        const HeapNode &n = heap[i];
+        if (lowFlagged.insert(n.name).second) pending.push_back(Alert{ AlertKind::LowStock, n.name, current, n.stock, units });
+        for (size_t c = 2 * i + 1; c <= 2 * i + 2 && c < heap.size(); ++c)
+            if (heap[c].stock < units) stack.push_back(c);
+    }
+}
+
+std::vector<std::pair<std::string, int>> AlertEngine::lowest(size_t limit) const {
+    std::vector<std::pair<std::string, int>> result;
+    auto cmp = [this](size_t a, size_t b) { return heap[a].stock > heap[b].stock; };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(cmp)> frontier(cmp);
+    if (!heap.empty() && heap[0].stock < lowThreshold) frontier.push(0);
+    while (!frontier.empty() && result.size() < limit) {
+        const size_t i = frontier.top();
+        frontier.pop();
+        result.emplace_back(heap[i].name, heap[i].stock);
+        for (size_t c = 2 * i + 1; c <= 2 * i + 2 && c < heap.size(); ++c)
+            if (heap[c].stock < lowThreshold) frontier.push(c);
+    }
+    return result;
+}
+
+std::vector<std::pair<std::string, int>> AlertEngine::byExpiry(const std::unordered_set<std::string> &names) const {
+    std::vector<std::pair<std::string, int>> out;
+    out.reserve(names.size());
+    for (const auto &n : names) out.emplace_back(n, records.at(n).expiry);
+    std::sort(out.begin(), out.end(), [](const auto &a, const auto &b) { return a.second != b.second ? a.second < b.second : a.first < b.first; });
+    return out;
+}
+
+void AlertEngine::swapNodes(size_t a, size_t b) {
+    std::swap(heap[a], heap[b]);
+    heapPos[heap[a].name] = a;
+    heapPos[heap[b].name] = b;
+}
+
+void AlertEngine::siftUp(size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (heap[parent].stock <= heap[i].stock) break;
+        swapNodes(i, parent);
+        i = parent;
+    }
+}
+
+void AlertEngine::siftDown(size_t i) {
+    const size_t n = heap.size();
+    while (true) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && heap[l].stock < heap[m].stock) m = l;
+        if (r < n && heap[r].stock < heap[m].stock) m = r;
+        if (m == i) return;
+        swapNodes(i, m);
+        i = m;
+    }
+}
+
+void AlertEngine::heapSet(const std::string &name, int stock) {
+    auto it = heapPos.find(name);
+    if (it == heapPos.end()) {
+        heap.push_back(HeapNode{ name, stock });
+        heapPos[name] = heap.size() - 1;
+        siftUp(heap.size() - 1);
+        return;
+    }
+    HeapNode &n = heap[it->second];
+    const int old = n.stock;
+    n.stock = stock;
+    if (stock < old) siftUp(it->second); else siftDown(it->second);
+}
+
+void AlertEngine::heapRemove(const std::string &name) {
+    auto it = heapPos.find(name);
+    if (it == heapPos.end()) return;
+    const size_t i = it->second;
+    heapPos.erase(it);
+    if (i + 1 != heap.size()) {
+        heap[i] = std::move(heap.back());
+        heap.pop_back();
+        heapPos[heap[i].name] = i;
+        siftDown(i);
+        siftUp(i);
+    } else {
+        heap.pop_back();
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef ALERTS_H
+#define ALERTS_H
+
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+enum class AlertKind { LowStock, NearExpiry, Expired };
+
+struct Alert {
+    AlertKind kind = AlertKind::LowStock;
+    std::string name;
+    int day = 0;        // 触发日（日序号）
+    int value = 0;      // 低库存：库存；临期/过期：最早到期日（日序号）
+    int threshold = 0;  // 低库存阈值（件）或临期阈值（天）
+};
+
+// 增量预警：到期用按日分槽的时间轮（每种药品只挂下一次状态变化的定时器），低库存用按库存排序的索引最小堆。
+// 药品变化时 update 为 O(log n)；跨日时 advance 只处理到期的槽位，不扫描目录。只产生新预警：
+// 已报告过的（到期按“已报告到”的日期，低库存按已报告的药品名单）不会重复出现，由 takePending 取出。
+class AlertEngine {
+public:
+    static const int kNoExpiry = INT_MIN;
+
+    // 重新开始：day 为上次已报告到的日期，lowReported 为已报告且尚未解除的低库存药品。
+    // 随后的 update 只建立状态（到期按 day 计算，不产生预警），finishSeed 后恢复正常
+    void reset(int day, const std::vector<std::string> &lowReported);
+    void finishSeed();
+    bool active() const { return started; }
+
+    void setLowStockThreshold(int units);
+    int lowStockThreshold() const { return lowThreshold; }
+    // 药品的库存或最早到期日（kNoExpiry 表示不参与）、临期阈值有变化时调用
+    void update(const std::string &name, int stock, int expiryDay, int nearDays);
+    void remove(const std::string &name);
+    void rename(const std::string &from, const std::string &to);
+    // 推进到 today，到期的定时器产生临期/过期预警
+    void advance(int today);
+    int day() const { return current; }
+
+    std::vector<Alert> takePending();
+    size_t pendingCount() const { return pending.size(); }
+    size_t lowCount() const { return lowFlagged.size(); }
+    size_t nearCount() const { return nearSet.size(); }
+    size_t expiredCount() const { return expiredSet.size(); }
+    // 库存低于阈值的药品，按库存升序取前 limit 个（只访问堆顶附近的节点）
+    std::vector<std::pair<std::string, int>> lowest(size_t limit) const;
+    // 当前临期/过期的药品及最早到期日，按到期日升序
+    std::vector<std::pair<std::string, int>> nearList() const { return byExpiry(nearSet); }
+    std::vector<std::pair<std::string, int>> expiredList() const { return byExpiry(expiredSet); }
+    std::vector<std::string> lowReported() const { return std::vector<std::string>(lowFlagged.begin(), lowFlagged.end()); }
+
+private:
+    static const int kSlots = 512; // 时间轮槽数（天）；更远的定时器留在槽中，轮到时按到期日判断
+
+    struct Record {
+        int stock = 0;
+        int expiry = kNoExpiry;
+        int nearDays = 0;
+        int stage = 0;        // 0 正常，1 临期，2 过期（按 current 计算）
+        int due = INT_MAX;    // 下一次状态变化的日期
+        uint64_t timer = 0;   // 有效定时器编号，槽中编号不同的为已取消的定时器
+    };
+    struct Timer {
+        std::string name;
+        int due;
+        uint64_t id;
+    };
+    struct HeapNode {
+        std::string name;
+        int stock;
+    };
+
+    bool started = false;
+    bool seeding = false;
+    int current = 0;
+    int lowThreshold = 10;
+    uint64_t nextTimer = 0;
+    std::unordered_map<std::string, Record> records;
+    std::vector<std::vector<Timer>> wheel;
+    std::unordered_set<std::string> lowFlagged;
+    std::unordered_set<std::string> nearSet;
+    std::unordered_set<std::string> expiredSet;
+    std::vector<HeapNode> heap;
+    std::unordered_map<std::string, size_t> heapPos;
+    std::vector<Alert> pending;
+
+    static int stageAt(int day, int expiry, int nearDays);
+    std::vector<std::pair<std::string, int>> byExpiry(const std::unordered_set<std::string> &names) const;
+    void setStage(const std::string &name, Record &r, int stage, bool report);
+    void schedule(const std::string &name, Record &r);
+    void noteStock(const std::string &name, int stock);
+    void heapSet(const std::string &name, int stock);
+    void heapRemove(const std::string &name);
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+    void swapNodes(size_t a, size_t b);
+};
+
+#endif // ALERTS_H
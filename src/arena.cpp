@@ -0,0 +1,58 @@
+#include "arena.h"
+#include <cstring>
+#include <utility>
+
+StringArena::StringArena(StringArena &&other) noexcept
+    : blockList(std::move(other.blockList)), cur(other.cur), left(other.left), nextBlock(other.nextBlock),
+      usedBytes(other.usedBytes), capacityBytes(other.capacityBytes) {
+    other.blockList.clear();
+    other.cur = nullptr;
+    other.left = 0;
+    other.usedBytes = 0;
+    other.capacityBytes = 0;
+}
+
+StringArena &StringArena::operator=(StringArena &&other) noexcept {
+    if (this == &other) return *this;
+    blockList = std::move(other.blockList);
+    cur = other.cur;
+    left = other.left;
+    nextBlock = other.nextBlock;
+    usedBytes = other.usedBytes;
+    capacityBytes = other.capacityBytes;
+    other.blockList.clear();
+    other.cur = nullptr;
+    other.left = 0;
+    other.usedBytes = 0;
+    other.capacityBytes = 0;
+    return *this;
+}
+
+void StringArena::grow(size_t atLeast) {
+    size_t size = nextBlock;
+    if (size < atLeast) size = atLeast;
+    blockList.emplace_back(new char[size]);
+    cur = blockList.back().get();
+    left = size;
+    capacityBytes += size;
+    if (nextBlock < kMaxBlock) nextBlock = nextBlock * 2 < kMaxBlock ? nextBlock * 2 : kMaxBlock;
+}
+
+std::string_view StringArena::copy(const char *data, size_t len) {
+    if (len == 0) return std::string_view();
+    if (left < len) grow(len);
+    char *dst = cur;
+    std::memcpy(dst, data, len);
+    cur += len;
+    left -= len;
+    usedBytes += len;
+    return std::string_view(dst, len);
+}
+
+void StringArena::clear() {
+    blockList.clear();
+    cur = nullptr;
+    left = 0;
+    usedBytes = 0;
+    capacityBytes = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// 单调（bump）字符串区：按块申请内存，copy 只移动块内指针，整区一次释放。
+// 块大小从 firstBlock 起倍增到 kMaxBlock，超长字符串单独成块；返回的 string_view 在区对象销毁或 clear 前有效，
+// 移动区对象不改变块地址，已返回的 view 仍然有效。
+class StringArena {
+public:
+    static const size_t kMaxBlock = 8u << 20;
+
+    explicit StringArena(size_t firstBlock = 64u << 10) : nextBlock(firstBlock) {}
+    // 移动后源对象为空区（不再持有块，后续 copy 重新申请）
+    StringArena(StringArena &&other) noexcept;
+    StringArena &operator=(StringArena &&other) noexcept;
+    StringArena(const StringArena &) = delete;
+    StringArena &operator=(const StringArena &) = delete;
+
+    std::string_view copy(const char *data, size_t len);
+    void clear();
+
+    size_t used() const { return usedBytes; }
+    size_t capacity() const { return capacityBytes; }
+    size_t blocks() const { return blockList.size(); }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blockList;
+    char *cur = nullptr;
+    size_t left = 0;
+    size_t nextBlock;
+    size_t usedBytes = 0;
+    size_t capacityBytes = 0;
+
+    void grow(size_t atLeast);
+};
+
+// 只读视图记录：字段指向同一张表的字符串区，适合整表读入后只读使用的场景（报表、汇总、基准）
+struct DrugView {
+    std::string_view name;
+    std::string_view category;
+    std::string_view manufacturer;
+    std::string_view specification;
+    std::string_view productionDate;
+    int stock = 0;
+    int totalSold = 0;
+    int shelfLifeDays = 0;
+    int nearExpiryThresholdDays = 0;
+};
+
+struct SaleView {
+    std::string_view drugName;
+    int quantity = 0;
+    std::string_view timestamp;
+    std::string_view operatorName;
+    std::string_view type;
+    long long id = 0;
+};
+
+// 表 = 行 + 行所引用的字符串区；不可复制，移动后行中的 view 仍然有效
+struct DrugTable {
+    StringArena arena;
+    std::vector<DrugView> rows;
+};
+
+struct SalesTable {
+    StringArena arena;
+    std::vector<SaleView> rows;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,425 @@
+// pharmacy_bench：在确定性合成数据上测量各核心操作耗时，每项输出一行 JSON，便于追踪性能回归。
+//
+// 用法：pharmacy_bench [--drugs N] [--sales M] [--seed S] [--iters K] [--appends A]
+//                      [--dir 目录] [--only 名称,名称] [--quadratic-limit N] [--out 文件] [--generate-only]
+//                      [--threads T]（并行报表线程数，默认取硬件并发数）
+//                      [--shards S]（连锁汇总基准的分片数，默认 4：同一生成库作 S 个门店）
+// 每项输出耗时分布与每次迭代的堆分配次数（allocs_per_iter）。
+#include "datagen.h"
+#include "federation.h"
+#include "pharmacy.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <set>
+#include <sstream>
+#include <streambuf>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// 堆分配计数：替换全局 operator new，每项基准同时输出每次迭代的分配次数（SQLite 内部的 malloc 不计入）
+static std::atomic<long long> g_allocs{0};
+
+void *operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+// 丢弃所有输出的流缓冲：报表仍完成格式化，只是不写终端
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c == EOF ? 0 : c; }
+    std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+// 通过友元访问 Pharmacy 的内部状态，直接驱动真实的业务代码路径
+class PharmacyBench {
+public:
+    explicit PharmacyBench(Pharmacy &p) : app(p) {}
+    bool init() { return app.db->init(); }
+    IDatabase &db() { return *app.db; }
+    std::vector<Drug> &drugs() { return app.drugs; }
+    void loadDrugs() { app.drugs = app.db->loadDrugs(); }
+    void loadLots() { app.loadLotBooks(); }
+    void loadDemand() { app.loadDemand(); }
+    void reorderReport() { app.printReorder(14, 20); }
+    void filterQuery(const std::string &expr) { app.printFilter(expr, 50); }
+    void fuzzySearch(const std::string &q) { app.printFuzzy(q, 10); }
+    // 模拟 config.txt 中某分类的保质期被改为 days 后的增量重算，随后改回原配置（一次调用含两次重算）
+    void toggleCategoryShelfLife(const std::string &category, int days) {
+        const std::string original = app.config.canonical();
+        ConfigChange change;
+        std::vector<std::string> warnings;
+        int n = 0;
+        app.config.parse(original + "shelf_life." + category + "=" + std::to_string(days) + "\n", change, warnings);
+        app.applyShelfLifeChange(change, false, n);
+        app.config.parse(original, change, warnings);
+        app.applyShelfLifeChange(change, false, n);
+    }
+    // 对照：按当前配置核对全部药品的批次到期日
+    void recheckAllExpiry() { int n = 0; app.applyShelfLifeChange(ConfigChange(), true, n); }
+    void migratePasswords() { app.migratePasswords(); }
+    bool publishLive(const std::string &name) { std::string error; return app.publishLiveCounters(name, error); }
+    // 与交易路径相同的一次发布：槽位更新 + 交易计数，合为一个顺序锁写区间
+    void liveUpdate(size_t row) {
+        const Drug &d = app.drugs[row];
+        LiveCounters::WriteScope w(app.liveCounters);
+        app.liveCounters.publish(static_cast<uint32_t>(row), d.name, d.stock, d.totalSold);
+        app.liveCounters.countEvent(LiveEvent::Sale, 1);
+    }
+    // cold 时先清空会话缓存，测完整的 scrypt 校验；否则测缓存命中
+    bool login(const std::string &username, const std::string &password, bool cold) {
+        if (cold) app.authCache.clear();
+        User user;
+        return app.authenticate(username, password, user);
+    }
+    // 预警引擎：按当前目录重新建立全部状态（与启动载入时相同，经 indexDrug 逐个更新）
+    void alertSeed() {
+        app.alerts.reset(todayDay(), {});
+        for (const auto &d : app.drugs) app.indexDrug(d);
+        app.alerts.finishSeed();
+        app.alerts.takePending();
+    }
+    // 与交易路径相同的单次更新：改库存后 indexDrug（含预警堆调整），随后改回
+    void alertMutate(size_t row, int delta) {
+        Drug &d = app.drugs[row];
+        d.stock += delta;
+        app.indexDrug(d);
+        d.stock -= delta;
+        app.indexDrug(d);
+    }
+    void recordTrend(const Drug &d, long long t) { app.trending.record(d.name, d.category, 1, t); }
+    void saveDrugs() { app.db->saveDrugs(app.drugs); }
+    // 交互式功能：把输入喂给 std::cin，再调用原函数
+    void withInput(const std::string &input, const std::function<void(Pharmacy &)> &fn) {
+        std::istringstream in(input);
+        std::streambuf *old = std::cin.rdbuf(in.rdbuf());
+        fn(app);
+        std::cin.rdbuf(old);
+        std::cin.clear();
+    }
+    void queryByName(const std::string &kw) { withInput(kw + "\n", [](Pharmacy &p) { p.queryByName(); }); }
+    void queryByCategory(const std::string &cat) { withInput(cat + "\n", [](Pharmacy &p) { p.queryByCategory(); }); }
+    void salesReport() { app.salesReport(); }
+    void analyzeTopBottom() { app.analyzeTopBottom(); }
+    void categorySalesTrend() { app.categorySalesTrend(); }
+    // 账实核对（只算不改）：扫描全部流水并与内存目录比较，返回需修复的药品数
+    size_t reconcile() {
+        std::unordered_map<std::string, long long> lots;
+        for (const auto &kv : app.lotBooks) lots[kv.first] = kv.second.total();
+        return app.runReconcile(app.drugs, lots).plan.size();
+    }
+    void setReportThreads(int n) { app.reportThreads = n; app.scanEngine.reset(); }
+    void showNearExpiry() { app.showNearExpiry(); }
+    SqliteDatabase &sqlite() { return *app.sqliteDb; }
+
+private:
+    Pharmacy &app;
+};
+
+namespace {
+
+struct BenchConfig {
+    DataGenOptions gen;
+    int iters = 5;
+    int appends = 200;
+    long long quadraticLimit = 20000; // 冒泡排序类报表在药品数超过该值时跳过
+    std::string dir;
+    std::string outPath;
+    std::set<std::string> only;
+    bool generateOnly = false;
+    int threads = 0; // 0 表示使用硬件并发数
+    int shards = 4;
+};
+
+struct Sample {
+    std::vector<double> ms;
+    double allocsPerIter = -1;
+};
+
+void emit(std::ostream &out, const BenchConfig &cfg, const std::string &name, const Sample &s,
+          long long opsPerIter, const std::string &skipped) {
+    out << "{\"bench\":\"" << name << "\",\"drugs\":" << cfg.gen.drugs << ",\"sales\":" << cfg.gen.sales
+        << ",\"seed\":" << cfg.gen.seed;
+    if (cfg.threads > 0) out << ",\"threads\":" << cfg.threads;
+    if (!skipped.empty()) {
+        out << ",\"skipped\":\"" << skipped << "\"}\n";
+        return;
+    }
+    std::vector<double> v = s.ms;
+    std::sort(v.begin(), v.end());
+    double sum = 0;
+    for (double x : v) sum += x;
+    double mean = v.empty() ? 0 : sum / v.size();
+    double p50 = v.empty() ? 0 : v[v.size() / 2];
+    double p99 = v.empty() ? 0 : v[std::min(v.size() - 1, static_cast<size_t>(v.size() * 0.99))];
+    out << ",\"iters\":" << v.size() << ",\"mean_ms\":" << mean << ",\"min_ms\":" << (v.empty() ? 0 : v.front())
+        << ",\"p50_ms\":" << p50 << ",\"p99_ms\":" << p99 << ",\"max_ms\":" << (v.empty() ? 0 : v.back());
+    if (opsPerIter > 0 && mean > 0) out << ",\"ops_per_sec\":" << opsPerIter * 1000.0 / mean;
+    if (s.allocsPerIter >= 0) out << ",\"allocs_per_iter\":" << s.allocsPerIter;
+    out << "}\n";
+    out.flush();
+}
+
+Sample timeIt(int iters, const std::function<void()> &fn) {
+    Sample s;
+    s.ms.reserve(static_cast<size_t>(iters));
+    long long allocs = 0;
+    for (int i = 0; i < iters; ++i) {
+        const long long a0 = g_allocs.load(std::memory_order_relaxed);
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        allocs += g_allocs.load(std::memory_order_relaxed) - a0;
+        s.ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    if (iters > 0) s.allocsPerIter = static_cast<double>(allocs) / iters;
+    return s;
+}
+
+long long maxSaleId(const std::string &dbPath) {
+    sqlite3 *db = nullptr;
+    long long id = 0;
+    if (sqlite3_open(dbPath.c_str(), &db) == SQLITE_OK) {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT COALESCE(MAX(id),0) FROM sales", -1, &stmt, nullptr) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int64(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+    }
+    if (db) sqlite3_close(db);
+    return id;
+}
+
+// 撤销基准中追加的销售，保持生成数据可复用
+void truncateSales(const std::string &dbPath, long long keepUpTo) {
+    sqlite3 *db = nullptr;
+    if (sqlite3_open(dbPath.c_str(), &db) == SQLITE_OK) {
+        std::string sql = "DELETE FROM sales WHERE id > " + std::to_string(keepUpTo);
+        sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    }
+    if (db) sqlite3_close(db);
+}
+
+bool parseArgs(int argc, char **argv, BenchConfig &cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&](std::string &out) { if (i + 1 >= argc) return false; out = argv[++i]; return true; };
+        std::string v;
+        try {
+            if (a == "--drugs" && next(v)) cfg.gen.drugs = std::stoll(v);
+            else if (a == "--sales" && next(v)) cfg.gen.sales = std::stoll(v);
+            else if (a == "--seed" && next(v)) cfg.gen.seed = std::stoull(v);
+            else if (a == "--history-days" && next(v)) cfg.gen.historyDays = std::stoi(v);
+            else if (a == "--anchor" && next(v)) cfg.gen.anchorDate = v;
+            else if (a == "--iters" && next(v)) cfg.iters = std::stoi(v);
+            else if (a == "--appends" && next(v)) cfg.appends = std::stoi(v);
+            else if (a == "--quadratic-limit" && next(v)) cfg.quadraticLimit = std::stoll(v);
+            else if (a == "--dir" && next(v)) cfg.dir = v;
+            else if (a == "--out" && next(v)) cfg.outPath = v;
+            else if (a == "--only" && next(v)) {
+                std::stringstream ss(v); std::string item;
+                while (std::getline(ss, item, ',')) if (!item.empty()) cfg.only.insert(item);
+            }
+            else if (a == "--threads" && next(v)) cfg.threads = std::stoi(v);
+            else if (a == "--shards" && next(v)) cfg.shards = std::stoi(v);
+            else if (a == "--generate-only") cfg.generateOnly = true;
+            else return false;
+        } catch (...) {
+            return false;
+        }
+    }
+    if (cfg.dir.empty()) cfg.dir = "bench_data/d" + std::to_string(cfg.gen.drugs) + "_s" + std::to_string(cfg.gen.sales)
+                                   + "_seed" + std::to_string(cfg.gen.seed);
+    return cfg.iters > 0 && cfg.shards > 0;
+}
+
+void makeDirs(const std::string &path) {
+    for (size_t pos = 0; (pos = path.find_first_of("/\\", pos + 1)) != std::string::npos; ) {
+        std::string part = path.substr(0, pos);
+#ifdef _WIN32
+        _mkdir(part.c_str());
+#else
+        mkdir(part.c_str(), 0755);
+#endif
+    }
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    BenchConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::cerr << "用法：pharmacy_bench [--drugs N] [--sales M] [--seed S] [--iters K] [--appends A]\n"
+                  << "                      [--dir 目录] [--only 名称,...] [--quadratic-limit N] [--out 文件] [--generate-only]\n"
+                  << "                      [--threads T] [--shards S]\n";
+        return 2;
+    }
+    makeDirs(cfg.dir);
+    const std::string dbPath = cfg.dir + "/pharmacy.db";
+    if (!generatedDatabaseMatches(dbPath, cfg.gen)) {
+        auto t0 = std::chrono::steady_clock::now();
+        if (!generateDatabase(dbPath, cfg.gen, std::cerr)) return 1;
+        Sample s; s.ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+        emit(std::cout, cfg, "generate", s, cfg.gen.drugs + cfg.gen.sales, "");
+    }
+    if (cfg.generateOnly) return 0;
+
+    std::ofstream outFile;
+    if (!cfg.outPath.empty()) outFile.open(cfg.outPath, std::ios::app);
+    std::ostream &out = cfg.outPath.empty() ? std::cout : outFile;
+
+    Pharmacy app(dbPath);
+    PharmacyBench bench(app);
+    if (!bench.init()) return 1;
+    bench.loadDrugs();
+    if (cfg.threads > 0) bench.setReportThreads(cfg.threads);
+
+    // 业务函数的输出全部丢弃，基准结果单独写到 out
+    NullBuffer nullBuf;
+    std::streambuf *realCout = std::cout.rdbuf();
+    // 首次打开旧数据时会把库存迁移为批次、用全部流水建立需求状态，提示信息同样丢弃
+    std::cout.rdbuf(&nullBuf);
+    bench.loadLots();
+    bench.loadDemand();
+    bench.migratePasswords();
+    std::cout.rdbuf(realCout);
+    auto run = [&](const std::string &name, long long opsPerIter, bool quadratic, const std::function<void()> &fn) {
+        if (!cfg.only.empty() && !cfg.only.count(name)) return;
+        if (quadratic && cfg.gen.drugs > cfg.quadraticLimit) {
+            emit(out, cfg, name, Sample{}, 0, "O(n^2) 排序，药品数超过 --quadratic-limit");
+            return;
+        }
+        std::cout.rdbuf(&nullBuf);
+        Sample s = timeIt(cfg.iters, fn);
+        std::cout.rdbuf(realCout);
+        emit(out, cfg, name, s, opsPerIter, "");
+    };
+
+    run("loadDrugs", cfg.gen.drugs, false, [&]() { bench.loadDrugs(); });
+    run("saveDrugs", cfg.gen.drugs, false, [&]() { bench.saveDrugs(); });
+    run("loadLots", cfg.gen.drugs, false, [&]() { bench.loadLots(); });
+    run("queryByName", cfg.gen.drugs, false, [&]() { bench.queryByName("阿莫西林"); });
+    run("queryByCategory", cfg.gen.drugs, false, [&]() { bench.queryByCategory("抗生素"); });
+    run("filterQuery", cfg.gen.drugs, false, [&]() { bench.filterQuery("分类=抗生素 AND 库存<50 AND 到期<=60"); });
+    run("fuzzySearchTypo", cfg.gen.drugs, false, [&]() { bench.fuzzySearch("阿莫西淋"); });
+    run("fuzzySearchPinyin", cfg.gen.drugs, false, [&]() { bench.fuzzySearch("amxl"); });
+    run("loadSales", cfg.gen.sales, false, [&]() { bench.db().loadSales(); });
+    // 字符串区载入：与 loadDrugs / loadSales 同样的整表读取，字段为视图
+    run("loadDrugTable", cfg.gen.drugs, false, [&]() { DrugTable t; bench.sqlite().loadDrugTable(t); });
+    run("loadSalesTable", cfg.gen.sales, false, [&]() { SalesTable t; bench.sqlite().loadSalesTable(t); });
+    run("querySalesPage", 1, false, [&]() { SalesQuery q; bench.sqlite().querySales(q); });
+    run("salesReport", cfg.gen.drugs, true, [&]() { bench.salesReport(); });
+    run("analyzeTopBottom", cfg.gen.drugs, true, [&]() { bench.analyzeTopBottom(); });
+    run("categorySalesTrend", cfg.gen.sales, false, [&]() { bench.categorySalesTrend(); });
+    run("reconcile", cfg.gen.sales, false, [&]() { bench.reconcile(); });
+    run("nearExpiryScan", cfg.gen.drugs, false, [&]() { bench.showNearExpiry(); });
+    run("configReloadCategory", 2, false, [&]() { bench.toggleCategoryShelfLife("抗生素", 400); });
+    run("configRecheckAll", cfg.gen.drugs, false, [&]() { bench.recheckAllExpiry(); });
+    run("loginScrypt", 1, false, [&]() { bench.login("admin", "admin", true); });
+    run("loginCached", 1000, false, [&]() { for (int i = 0; i < 1000; ++i) bench.login("admin", "admin", false); });
+    // 实时计数：写方单次发布与读方整段一致快照
+    if ((cfg.only.empty() || cfg.only.count("livePublish") || cfg.only.count("liveSnapshot")) && !bench.drugs().empty()
+        && bench.publishLive("/pharmacy_bench_live")) {
+        const size_t n = bench.drugs().size();
+        size_t k = 0;
+        run("livePublish", 10000, false, [&]() { for (int i = 0; i < 10000; ++i, ++k) bench.liveUpdate(k % n); });
+        LiveCountersReader reader;
+        LiveSnapshot snap;
+        std::string error;
+        if (reader.open("/pharmacy_bench_live", error))
+            run("liveSnapshot", cfg.gen.drugs, false, [&]() { reader.snapshot(snap, error); });
+    }
+    // 连锁汇总：1 个分片与 S 个分片（同一库重复 S 次）对比，墙钟之比反映分片并行的扩展性
+    run("federate1", cfg.gen.sales, false, [&]() { runFederatedReports({ dbPath }, 20, cfg.threads); });
+    run("federate" + std::to_string(cfg.shards), cfg.gen.sales * cfg.shards, false, [&]() {
+        runFederatedReports(std::vector<std::string>(static_cast<size_t>(cfg.shards), dbPath), 20, cfg.threads);
+    });
+    // 归档段：把全部流水按月写成段文件（不改动数据库），对比段内翻页与直接读取段头合计
+    if (cfg.only.empty() || cfg.only.count("archiveWrite") || cfg.only.count("archiveQueryPage") || cfg.only.count("archiveSummary")) {
+        std::map<std::string, std::vector<SaleRecord>> months;
+        for (auto &r : bench.db().loadSales())
+            if (SalesArchive::isArchivable(r.timestamp)) months[r.timestamp.substr(0, 7)].push_back(std::move(r));
+        for (auto &m : months)
+            std::sort(m.second.begin(), m.second.end(), [](const SaleRecord &a, const SaleRecord &b) {
+                return a.timestamp != b.timestamp ? a.timestamp < b.timestamp : a.id < b.id;
+            });
+        const std::string dir = cfg.dir + "/archive_bench";
+        std::string manifest, error;
+        auto writeAll = [&]() {
+            manifest.clear();
+            for (const auto &m : months) {
+                SalesArchive::SegmentInfo info;
+                if (SalesArchive::writeSegment(dir + "/sales-" + m.first + ".seg", m.second, info, error)) manifest += info.file + "\n";
+            }
+        };
+        writeAll();
+        run("archiveWrite", cfg.gen.sales, false, writeAll);
+        SalesArchive archive;
+        if (archive.open(dir, manifest, error)) {
+            run("archiveQueryPage", 1, false, [&]() { SalesQuery q; archive.query(q); });
+            long long sum = 0;
+            run("archiveSummary", archive.rows(), false, [&]() {
+                archive.forEachSummary([&](const SalesArchive::SummaryEntry &e) { sum += e.quantity; });
+            });
+        }
+    }
+    run("loadDemand", cfg.gen.drugs, false, [&]() { bench.loadDemand(); });
+    run("reorderReport", 1, false, [&]() { bench.reorderReport(); });
+    // 热销窗口更新：每次迭代按 t² 取模轮转药品记录 10000 笔（满员后持续发生顶替），时间逐笔推进 1 秒
+    {
+        const std::vector<Drug> &ds = bench.drugs();
+        long long t = 0;
+        run("trendingRecord", 10000, false, [&]() {
+            for (int i = 0; i < 10000 && !ds.empty(); ++i, ++t) {
+                size_t idx = static_cast<size_t>((t * t) % static_cast<long long>(ds.size()));
+                bench.recordTrend(ds[idx], t);
+            }
+        });
+    }
+
+    run("alertSeed", cfg.gen.drugs, false, [&]() { bench.alertSeed(); });
+    // 预警更新：每次迭代按 t² 取模轮转药品，库存减 20 再恢复，共 20000 次 indexDrug
+    {
+        const size_t n = bench.drugs().size();
+        long long t = 0;
+        if (cfg.only.empty() || cfg.only.count("alertUpdate")) bench.alertSeed();
+        run("alertUpdate", 20000, false, [&]() {
+            for (int i = 0; i < 10000 && n > 0; ++i, ++t) bench.alertMutate(static_cast<size_t>((t * t) % static_cast<long long>(n)), -20);
+        });
+    }
+
+    // 追加销售：每次迭代逐条提交 appends 条记录，结束后删除以保持数据可复用
+    if (cfg.only.empty() || cfg.only.count("appendSale")) {
+        long long before = maxSaleId(dbPath);
+        const std::vector<Drug> &ds = bench.drugs();
+        long long k = 0;
+        run("appendSale", cfg.appends, false, [&]() {
+            for (int i = 0; i < cfg.appends && !ds.empty(); ++i, ++k) {
+                SaleRecord r{ ds[static_cast<size_t>(k) % ds.size()].name, 1, "2025-01-01T12:00:00", "bench" };
+                bench.db().appendSale(r);
+            }
+        });
+        truncateSales(dbPath, before);
+    }
+    return 0;
+}
@@ -0,0 +1,255 @@
+#include "bitmap.h"
+#include <algorithm>
+#include <bitset>
+#include <map>
+
+static int popcount64(uint64_t w) {
+    return static_cast<int>(std::bitset<64>(w).count());
+}
+
+RoaringBitmap::Container *RoaringBitmap::find(uint16_t key) {
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container &c, uint16_t k) { return c.key < k; });
+    return it != containers.end() && it->key == key ? &*it : nullptr;
+}
+
+const RoaringBitmap::Container *RoaringBitmap::find(uint16_t key) const {
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container &c, uint16_t k) { return c.key < k; });
+    return it != containers.end() && it->key == key ? &*it : nullptr;
+}
+
+void RoaringBitmap::toBits(Container &c) {
+    c.bits.assign(kWords, 0);
+    for (uint16_t v : c.array) c.bits[v >> 6] |= uint64_t(1) << (v & 63);
+    c.array.clear();
+    c.array.shrink_to_fit();
+}
+
+void RoaringBitmap::toArray(Container &c) {
+    std::vector<uint16_t> arr;
+    arr.reserve(static_cast<size_t>(c.card));
+    for (size_t w = 0; w < c.bits.size(); ++w) {
+        uint64_t word = c.bits[w];
+        for (int b = 0; word; ++b, word >>= 1)
+            if (word & 1) arr.push_back(static_cast<uint16_t>(w * 64 + b));
+    }
+    c.array.swap(arr);
+    c.bits.clear();
+    c.bits.shrink_to_fit();
+}
+
+// 运算结果按基数选择合适的容器类型
+void RoaringBitmap::normalize(Container &c) {
+    if (c.bits.empty()) {
+        c.card = static_cast<int>(c.array.size());
+        if (c.card > kArrayMax) toBits(c);
+    } else {
+        int n = 0;
+        for (uint64_t w : c.bits) n += popcount64(w);
+        c.card = n;
+        if (c.card <= kArrayMax) toArray(c);
+    }
+}
+
+void RoaringBitmap::add(uint32_t v) {
+    const uint16_t key = static_cast<uint16_t>(v >> 16), low = static_cast<uint16_t>(v & 0xFFFF);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container &c, uint16_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) {
+        Container c;
+        c.key = key;
+        it = containers.insert(it, c);
+    }
+    Container &c = *it;
+    if (!c.bits.empty()) {
+        uint64_t &w = c.bits[low >> 6], m = uint64_t(1) << (low & 63);
+        if (!(w & m)) { w |= m; ++c.card; }
+        return;
+    }
+    auto pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+    if (pos != c.array.end() && *pos == low) return;
+    c.array.insert(pos, low);
+    if (++c.card > kArrayMax) toBits(c);
+}
+
+void RoaringBitmap::remove(uint32_t v) {
+    const uint16_t key = static_cast<uint16_t>(v >> 16), low = static_cast<uint16_t>(v & 0xFFFF);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container &c, uint16_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) return;
+    Container &c = *it;
+    if (!c.bits.empty()) {
+        uint64_t &w = c.bits[low >> 6], m = uint64_t(1) << (low & 63);
+        if (!(w & m)) return;
+        w &= ~m;
+        if (--c.card <= kArrayMax) toArray(c);
+    } else {
+        auto pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (pos == c.array.end() || *pos != low) return;
+        c.array.erase(pos);
+        --c.card;
+    }
+    if (c.card == 0) containers.erase(it);
+}
+
+bool RoaringBitmap::contains(uint32_t v) const {
+    const Container *c = find(static_cast<uint16_t>(v >> 16));
+    if (!c) return false;
+    const uint16_t low = static_cast<uint16_t>(v & 0xFFFF);
+    if (!c->bits.empty()) return (c->bits[low >> 6] >> (low & 63)) & 1;
+    return std::binary_search(c->array.begin(), c->array.end(), low);
+}
+
+uint64_t RoaringBitmap::cardinality() const {
+    uint64_t n = 0;
+    for (const auto &c : containers) n += static_cast<uint64_t>(c.card);
+    return n;
+}
+
+size_t RoaringBitmap::memoryBytes() const {
+    size_t n = containers.capacity() * sizeof(Container);
+    for (const auto &c : containers) n += c.array.capacity() * sizeof(uint16_t) + c.bits.capacity() * sizeof(uint64_t);
+    return n;
+}
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container &a, const Container &b) {
+    Container r;
+    r.key = a.key;
+    if (!a.bits.empty() && !b.bits.empty()) {
+        r.bits.resize(kWords);
+        for (size_t i = 0; i < kWords; ++i) r.bits[i] = a.bits[i] & b.bits[i];
+    } else if (a.bits.empty() && b.bits.empty()) {
+        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(r.array));
+    } else {
+        // 数组 ∩ 位集：逐个查位
+        const Container &arr = a.bits.empty() ? a : b, &bs = a.bits.empty() ? b : a;
+        for (uint16_t v : arr.array)
+            if ((bs.bits[v >> 6] >> (v & 63)) & 1) r.array.push_back(v);
+    }
+    normalize(r);
+    return r;
+}
+
+RoaringBitmap::Container RoaringBitmap::unite(const Container &a, const Container &b) {
+    Container r;
+    r.key = a.key;
+    if (a.bits.empty() && b.bits.empty()) {
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(r.array));
+    } else {
+        r.bits.assign(kWords, 0);
+        for (const Container *c : { &a, &b }) {
+            if (!c->bits.empty()) for (size_t i = 0; i < kWords; ++i) r.bits[i] |= c->bits[i];
+            else for (uint16_t v : c->array) r.bits[v >> 6] |= uint64_t(1) << (v & 63);
+        }
+    }
+    normalize(r);
+    return r;
+}
+
+RoaringBitmap::Container RoaringBitmap::subtract(const Container &a, const Container &b) {
+    Container r;
+    r.key = a.key;
+    if (a.bits.empty()) {
+        if (b.bits.empty()) {
+            std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(r.array));
+        } else {
+            for (uint16_t v : a.array)
+                if (!((b.bits[v >> 6] >> (v & 63)) & 1)) r.array.push_back(v);
+        }
+    } else {
+        r.bits = a.bits;
+        if (!b.bits.empty()) for (size_t i = 0; i < kWords; ++i) r.bits[i] &= ~b.bits[i];
+        else for (uint16_t v : b.array) r.bits[v >> 6] &= ~(uint64_t(1) << (v & 63));
+    }
+    normalize(r);
+    return r;
+}
+
+RoaringBitmap RoaringBitmap::operator&(const RoaringBitmap &o) const {
+    RoaringBitmap r;
+    size_t i = 0, j = 0;
+    while (i < containers.size() && j < o.containers.size()) {
+        const Container &a = containers[i], &b = o.containers[j];
+        if (a.key < b.key) { ++i; continue; }
+        if (b.key < a.key) { ++j; continue; }
+        Container c = intersect(a, b);
+        if (c.card > 0) r.containers.push_back(std::move(c));
+        ++i; ++j;
+    }
+    return r;
+}
+
+RoaringBitmap RoaringBitmap::operator|(const RoaringBitmap &o) const {
+    RoaringBitmap r;
+    size_t i = 0, j = 0;
+    while (i < containers.size() || j < o.containers.size()) {
+        if (j == o.containers.size() || (i < containers.size() && containers[i].key < o.containers[j].key)) {
+            r.containers.push_back(containers[i++]);
+        } else if (i == containers.size() || o.containers[j].key < containers[i].key) {
+            r.containers.push_back(o.containers[j++]);
+        } else {
+            r.containers.push_back(unite(containers[i++], o.containers[j++]));
+        }
+    }
+    return r;
+}
+
+RoaringBitmap RoaringBitmap::andNot(const RoaringBitmap &o) const {
+    RoaringBitmap r;
+    size_t j = 0;
+    for (const auto &a : containers) {
+        while (j < o.containers.size() && o.containers[j].key < a.key) ++j;
+        if (j == o.containers.size() || o.containers[j].key != a.key) { r.containers.push_back(a); continue; }
+        Container c = subtract(a, o.containers[j]);
+        if (c.card > 0) r.containers.push_back(std::move(c));
+    }
+    return r;
+}
+
+RoaringBitmap RoaringBitmap::unionAll(const std::vector<const RoaringBitmap *> &parts) {
+    std::map<uint16_t, std::vector<const Container *>> byKey;
+    for (const RoaringBitmap *b : parts)
+        for (const auto &c : b->containers) byKey[c.key].push_back(&c);
+    RoaringBitmap r;
+    r.containers.reserve(byKey.size());
+    for (auto &kv : byKey) {
+        if (kv.second.size() == 1) { r.containers.push_back(*kv.second[0]); continue; }
+        Container c;
+        c.key = kv.first;
+        c.bits.assign(kWords, 0);
+        for (const Container *src : kv.second) {
+            if (!src->bits.empty()) for (size_t i = 0; i < kWords; ++i) c.bits[i] |= src->bits[i];
+            else for (uint16_t v : src->array) c.bits[v >> 6] |= uint64_t(1) << (v & 63);
+        }
+        normalize(c);
+        r.containers.push_back(std::move(c));
+    }
+    return r;
+}
+
+RoaringBitmap RoaringBitmap::range(uint32_t begin, uint32_t end) {
+    RoaringBitmap r;
+    for (uint64_t start = begin; start < end; ) {
+        Container c;
+        c.key = static_cast<uint16_t>(start >> 16);
+        uint64_t stop = std::min<uint64_t>(end, (static_cast<uint64_t>(c.key) + 1) << 16);
+        if (stop - start > static_cast<uint64_t>(kArrayMax)) {
+            c.bits.assign(kWords, 0);
+            for (uint64_t v = start; v < stop; ++v) c.bits[(v & 0xFFFF) >> 6] |= uint64_t(1) << (v & 63);
+        } else {
+            for (uint64_t v = start; v < stop; ++v) c.array.push_back(static_cast<uint16_t>(v & 0xFFFF));
+        }
+        c.card = static_cast<int>(stop - start);
+        r.containers.push_back(std::move(c));
+        start = stop;
+    }
+    return r;
+}
+
+std::vector<uint32_t> RoaringBitmap::toVector() const {
+    std::vector<uint32_t> list;
+    list.reserve(static_cast<size_t>(cardinality()));
+    forEach([&](uint32_t v) { list.push_back(v); });
+    return list;
+}
@@ -0,0 +1,67 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Roaring 风格的压缩位图：按高 16 位分成若干容器，每个容器存低 16 位。
+// 元素不超过 4096 个时用有序数组（每个 2 字节），更多时换成 65536 位的位集（8 KB），
+// 因此稀疏与稠密的集合都能紧凑存放；交/并/差按容器逐对合并，只处理两边都有的键段。
+class RoaringBitmap {
+public:
+    void add(uint32_t v);
+    void remove(uint32_t v);
+    bool contains(uint32_t v) const;
+    uint64_t cardinality() const;
+    bool empty() const { return containers.empty(); }
+    void clear() { containers.clear(); }
+    size_t memoryBytes() const;
+
+    RoaringBitmap operator&(const RoaringBitmap &o) const;
+    RoaringBitmap operator|(const RoaringBitmap &o) const;
+    RoaringBitmap andNot(const RoaringBitmap &o) const;
+    RoaringBitmap &operator|=(const RoaringBitmap &o) { *this = *this | o; return *this; }
+    // 一次合并多个位图：同一键段的容器直接累加到一个位集，避免逐个两两合并的反复拷贝
+    static RoaringBitmap unionAll(const std::vector<const RoaringBitmap *> &parts);
+    // [begin, end) 内的全部整数
+    static RoaringBitmap range(uint32_t begin, uint32_t end);
+
+    std::vector<uint32_t> toVector() const;
+    template <typename F> void forEach(F f) const {
+        for (const auto &c : containers) {
+            const uint32_t high = static_cast<uint32_t>(c.key) << 16;
+            if (c.bits.empty()) {
+                for (uint16_t low : c.array) f(high | low);
+            } else {
+                for (size_t w = 0; w < c.bits.size(); ++w) {
+                    uint64_t word = c.bits[w];
+                    for (int b = 0; word; ++b, word >>= 1)
+                        if (word & 1) f(high | static_cast<uint32_t>(w * 64 + b));
+                }
+            }
+        }
+    }
+
+private:
+    static const int kArrayMax = 4096;
+    static const size_t kWords = 1024;
+    struct Container {
+        uint16_t key = 0;
+        int card = 0;
+        std::vector<uint16_t> array; // 有序数组容器
+        std::vector<uint64_t> bits;  // 位集容器（非空即表示使用位集）
+    };
+    std::vector<Container> containers; // 按 key 升序
+
+    Container *find(uint16_t key);
+    const Container *find(uint16_t key) const;
+    static void toBits(Container &c);
+    static void toArray(Container &c);
+    static void normalize(Container &c);
+    static Container intersect(const Container &a, const Container &b);
+    static Container unite(const Container &a, const Container &b);
+    static Container subtract(const Container &a, const Container &b);
+};
+
+#endif // BITMAP_H
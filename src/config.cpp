@@ -0,0 +1,203 @@
+#include "config.h"
+#include "password.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int kMaxDays = 36500; // 超过 100 年的值视为笔误
+
+void trim(const char *&b, const char *&e) {
+    while (b < e && (*b == ' ' || *b == '\t')) ++b;
+    while (e > b && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) --e;
+}
+
+bool parseDays(const char *b, const char *e, int &out) {
+    if (b == e) return false;
+    long v = 0;
+    for (const char *p = b; p < e; ++p) {
+        if (*p < '0' || *p > '9') return false;
+        v = v * 10 + (*p - '0');
+        if (v > kMaxDays) return false;
+    }
+    if (v <= 0) return false;
+    out = static_cast<int>(v);
+    return true;
+}
+
+} // namespace
+
+uint32_t AppConfig::findCategory(const std::string &category) const {
+    auto it = categoryIds.find(category);
+    return it == categoryIds.end() ? kNoCategory : it->second;
+}
+
+uint32_t AppConfig::internCategory(const std::string &category) {
+    auto it = categoryIds.find(category);
+    if (it != categoryIds.end()) return it->second;
+    const uint32_t id = static_cast<uint32_t>(categoryNames.size());
+    categoryIds.emplace(category, id);
+    categoryNames.push_back(category);
+    return id;
+}
+
+int AppConfig::categoryShelfLife(uint32_t id) const {
+    return id < shelfByCategory.size() ? shelfByCategory[id] : 0;
+}
+
+int AppConfig::shelfLifeFor(const Drug &d) const {
+    int days = categoryShelfLife(d.category);
+    if (days > 0) return days;
+    return d.shelfLifeDays > 0 ? d.shelfLifeDays : defaultShelfLife;
+}
+
+int AppConfig::nearExpiryFor(const Drug &d) const {
+    return d.nearExpiryThresholdDays > 0 ? d.nearExpiryThresholdDays : nearExpiryThreshold;
+}
+
+// 逐行切分，不经过流与正则；同一键出现多次时以最后一次为准
+void AppConfig::parse(const std::string &text, ConfigChange &change, std::vector<std::string> &warnings) {
+    static const std::string kShelfPrefix = "shelf_life.";
+    int newDefault = 730, newThreshold = 30, newLowStock = 10, newLog2N = 14;
+    std::vector<int> newShelf;
+    const char *p = text.data(), *end = p + text.size();
+    if (text.compare(0, 3, "\xEF\xBB\xBF") == 0) p += 3; // UTF-8 BOM
+    for (int lineNo = 1; p < end; ++lineNo) {
+        const char *lineEnd = std::find(p, end, '\n');
+        const char *b = p, *e = lineEnd;
+        p = lineEnd == end ? end : lineEnd + 1;
+        trim(b, e);
+        if (b == e || *b == '#') continue;
+        const char *eq = std::find(b, e, '=');
+        const char *kb = b, *ke = eq, *vb = eq == e ? e : eq + 1, *ve = e;
+        trim(kb, ke);
+        trim(vb, ve);
+        const std::string key(kb, ke);
+        int days = 0;
+        if (eq == e || key.empty() || !parseDays(vb, ve, days)) {
+            warnings.push_back("第 " + std::to_string(lineNo) + " 行无法识别（应为 键=正整数）：" + std::string(b, e));
+            continue;
+        }
+        if (key == "default_shelf_life_days") {
+            newDefault = days;
+        } else if (key == "near_expiry_threshold_days") {
+            newThreshold = days;
+        } else if (key == "low_stock_threshold") {
+            newLowStock = days;
+        } else if (key == "password_scrypt_log2n") {
+            if (days >= kScryptMinLog2N && days <= kScryptMaxLog2N) newLog2N = days;
+            else warnings.push_back("第 " + std::to_string(lineNo) + " 行：password_scrypt_log2n 应在 " + std::to_string(kScryptMinLog2N)
+                                    + "-" + std::to_string(kScryptMaxLog2N) + " 之间，沿用 " + std::to_string(newLog2N));
+        } else if (key.compare(0, kShelfPrefix.size(), kShelfPrefix) == 0 && key.size() > kShelfPrefix.size()) {
+            const uint32_t id = internCategory(key.substr(kShelfPrefix.size()));
+            if (newShelf.size() <= id) newShelf.resize(id + 1, 0);
+            newShelf[id] = days;
+        } else {
+            warnings.push_back("第 " + std::to_string(lineNo) + " 行的配置项未知：" + key);
+        }
+    }
+
+    change = ConfigChange();
+    change.defaultShelfLife = newDefault != defaultShelfLife;
+    change.nearExpiryThreshold = newThreshold != nearExpiryThreshold;
+    change.lowStockThreshold = newLowStock != lowStock;
+    const size_t ids = std::max(newShelf.size(), shelfByCategory.size());
+    for (size_t id = 0; id < ids; ++id) {
+        int before = id < shelfByCategory.size() ? shelfByCategory[id] : 0;
+        int after = id < newShelf.size() ? newShelf[id] : 0;
+        if (before != after) change.categories.push_back(static_cast<uint32_t>(id));
+    }
+    defaultShelfLife = newDefault;
+    nearExpiryThreshold = newThreshold;
+    lowStock = newLowStock;
+    passwordLog2N = newLog2N;
+    shelfByCategory.swap(newShelf);
+}
+
+bool AppConfig::loadFile(const std::string &path, ConfigChange &change, std::vector<std::string> &warnings) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream buf;
+    buf << in.rdbuf();
+    parse(buf.str(), change, warnings);
+    return true;
+}
+
+std::string AppConfig::canonical() const {
+    std::vector<std::pair<std::string, int>> shelves;
+    for (size_t id = 0; id < shelfByCategory.size(); ++id)
+        if (shelfByCategory[id] > 0) shelves.emplace_back(categoryNames[id], shelfByCategory[id]);
+    std::sort(shelves.begin(), shelves.end());
+    std::string out = "default_shelf_life_days=" + std::to_string(defaultShelfLife) + "\n"
+                    + "near_expiry_threshold_days=" + std::to_string(nearExpiryThreshold) + "\n"
+                    + "low_stock_threshold=" + std::to_string(lowStock) + "\n";
+    for (const auto &s : shelves) out += "shelf_life." + s.first + "=" + std::to_string(s.second) + "\n";
+    return out;
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+}
+
+bool ConfigWatcher::start(const std::string &filePath) {
+    stop();
+    path = filePath;
+    auto pos = path.find_last_of("/\\");
+    fileName = pos == std::string::npos ? path : path.substr(pos + 1);
+    lastStamp = stamp();
+    active = true;
+#ifdef __linux__
+    const std::string dir = pos == std::string::npos ? "." : path.substr(0, pos);
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0 && inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+        close(fd);
+        fd = -1; // 监视失败时退回比较修改时间
+    }
+#endif
+    return true;
+}
+
+void ConfigWatcher::stop() {
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+    fd = -1;
+    active = false;
+}
+
+bool ConfigWatcher::changed() {
+    if (!active) return false;
+#ifdef __linux__
+    if (fd >= 0) {
+        bool hit = false;
+        alignas(inotify_event) char buf[4096];
+        while (true) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) break; // EAGAIN：没有更多事件
+            for (char *q = buf; q < buf + n; ) {
+                const inotify_event *ev = reinterpret_cast<const inotify_event *>(q);
+                if (ev->len > 0 && fileName == ev->name) hit = true;
+                q += sizeof(inotify_event) + ev->len;
+            }
+        }
+        return hit;
+    }
+#endif
+    long long now = stamp();
+    if (now == lastStamp) return false;
+    lastStamp = now;
+    return true;
+}
+
+// 修改时间（秒）与文件大小合成的指纹；文件不存在时为 -1
+long long ConfigWatcher::stamp() const {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return -1;
+    return static_cast<long long>(st.st_mtime) * 1000003LL + static_cast<long long>(st.st_size);
+}
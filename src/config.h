@@ -0,0 +1,89 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "drug.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 重新载入前后的差异
+struct ConfigChange {
+    bool defaultShelfLife = false;        // 默认保质期变化
+    bool nearExpiryThreshold = false;     // 默认临期阈值变化
+    bool lowStockThreshold = false;       // 低库存预警阈值变化
+    std::vector<uint32_t> categories;     // 分类保质期有变化（新增、删除或改值）的分类 id
+    bool any() const { return defaultShelfLife || nearExpiryThreshold || lowStockThreshold || !categories.empty(); }
+};
+
+// 运行配置（config.txt）：
+//   default_shelf_life_days=<天数>      默认保质期
+//   near_expiry_threshold_days=<天数>   默认临期阈值
+//   low_stock_threshold=<件数>          库存低于该值时预警（默认 10）
+//   shelf_life.<分类>=<天数>            分类保质期
+//   password_scrypt_log2n=<10-18>       口令哈希 scrypt 的 N = 2^值（新哈希与登录时重算用）
+// 分类名驻留为从 0 起的整数 id（进程内不变），分类保质期按 id 存在数组里，查找为一次哈希加一次下标；
+// 重新载入时逐 id 比较新旧数组即可得出变化的分类。
+// 生效的保质期：分类配置 > 药品自身的保质期 > 默认值；临期阈值：药品自身 > 默认值。
+class AppConfig {
+public:
+    static const uint32_t kNoCategory = UINT32_MAX;
+
+    // 按 config.txt 语法解析文本并替换当前设置，change 给出与替换前的差异；无法识别的行写入 warnings
+    void parse(const std::string &text, ConfigChange &change, std::vector<std::string> &warnings);
+    // 读取文件后解析；文件无法打开时保持当前设置并返回 false
+    bool loadFile(const std::string &path, ConfigChange &change, std::vector<std::string> &warnings);
+    // 当前设置的规范文本（同样可被 parse 解析），用于记录上次生效的配置
+    std::string canonical() const;
+
+    int defaultShelfLifeDays() const { return defaultShelfLife; }
+    int nearExpiryThresholdDays() const { return nearExpiryThreshold; }
+    int lowStockThreshold() const { return lowStock; }
+    int passwordCostLog2() const { return passwordLog2N; }
+    // 未驻留的分类返回 kNoCategory（查询不会让驻留表增长）
+    uint32_t findCategory(const std::string &category) const;
+    const std::string &categoryName(uint32_t id) const { return categoryNames[id]; }
+    // 分类保质期（天），未配置返回 0
+    int categoryShelfLife(uint32_t id) const;
+    int categoryShelfLife(const std::string &category) const { return categoryShelfLife(findCategory(category)); }
+
+    int shelfLifeFor(const Drug &d) const;
+    int nearExpiryFor(const Drug &d) const;
+
+private:
+    int defaultShelfLife = 730;
+    int nearExpiryThreshold = 30;
+    int lowStock = 10;
+    int passwordLog2N = 14;
+    std::unordered_map<std::string, uint32_t> categoryIds;
+    std::vector<std::string> categoryNames; // id -> 分类名
+    std::vector<int> shelfByCategory;       // id -> 保质期，0 表示未配置
+
+    uint32_t internCategory(const std::string &category);
+};
+
+// 配置文件变化检测（非阻塞，由菜单循环轮询）：Linux 用 inotify 监视所在目录
+// （编辑器常先写临时文件再改名覆盖，直接监视文件本身会丢失），其他平台比较修改时间与大小
+class ConfigWatcher {
+public:
+    ConfigWatcher() = default;
+    ConfigWatcher(const ConfigWatcher &) = delete;
+    ConfigWatcher &operator=(const ConfigWatcher &) = delete;
+    ~ConfigWatcher();
+
+    bool start(const std::string &path);
+    void stop();
+    // 自上次调用以来文件是否可能有变化
+    bool changed();
+
+private:
+    std::string path;
+    std::string fileName;
+    bool active = false;
+    int fd = -1;
+    long long lastStamp = 0;
+
+    long long stamp() const;
+};
+
+#endif // CONFIG_H
@@ -7,7 +7,7 @@
 
 struct User {
     std::string username;
-    std::string password; // 简化处理，明文存储；生产建议使用哈希
+    std::string password; // scrypt 哈希串（见 password.h）；旧库中的明文在启动时自动迁移
     std::string role;     // "admin" 或 "clerk"
 };
 
@@ -16,6 +16,52 @@ struct SaleRecord {
     int quantity = 0;
     std::string timestamp;    
     std::string operatorName;  // 执行销售的用户
+    std::string type = "SALE"; // SALE / RETURN / WASTAGE；旧数据中的负数量记为 ADJ
+    long long id = 0;          // 流水号（读取时填充，追加时忽略）
+};
+
+// 药品批次：同一药品按到货批次分别记录生产日期、到期日与数量
+struct Lot {
+    long long id = 0;
+    std::string drugName;
+    std::string productionDate; // YYYY-MM-DD
+    std::string expiryDate;     // YYYY-MM-DD，入库时按保质期计算
+    int quantity = 0;
+};
+
+// 单个批次的数量变化（正为入库/退货，负为出库/报损）
+struct LotDelta {
+    long long lotId = 0;
+    int delta = 0;
+};
+
+// 账实核对的修复项：把 drugs 表中一种药品的累计销量与库存由 old 改为 new（不需要修改的字段 old == new）
+struct DrugRepair {
+    std::string name;
+    int oldSold = 0, newSold = 0;
+    int oldStock = 0, newStock = 0;
+};
+
+// 单个药品的需求平滑状态（Holt 线性指数平滑，观测值为日净销量）
+struct DemandState {
+    double level = 0.0;     // 平滑后的日需求水平
+    double trend = 0.0;     // 日需求的日变化趋势
+    int day = -1;           // 当前未结算日的日序号（-1 表示尚无观测）
+    long long pending = 0;  // 当前未结算日已累计的净销量
+    bool seeded = false;    // 是否已结算过至少一天
+};
+
+// 销售流水筛选与键集分页：按 (timestamp, id) 排序，从上一页最后一条之后继续读取，不使用 OFFSET
+struct SalesQuery {
+    std::string fromDate;      // YYYY-MM-DD，含当日；空为不限
+    std::string toDate;        // YYYY-MM-DD，含当日；空为不限
+    std::string drugName;
+    std::string operatorName;
+    std::string type;
+    bool newestFirst = true;
+    int limit = 20;
+    std::string afterTimestamp; // 分页游标：上一页最后一条的时间戳与流水号，空为第一页
+    long long afterId = 0;
 };
 
 class IDatabase {
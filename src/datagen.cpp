@@ -0,0 +1,254 @@
+#include "datagen.h"
+#include "sqlite_db.h"
+#include <sqlite3.h>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// splitmix64：轻量、可复现的伪随机数
+struct Rng {
+    uint64_t state;
+    explicit Rng(uint64_t seed) : state(seed) {}
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    uint64_t below(uint64_t n) { return n ? next() % n : 0; }
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+struct BaseDrug { const char *name; const char *category; };
+
+const BaseDrug kBaseDrugs[] = {
+    {"阿莫西林胶囊", "抗生素"}, {"头孢克肟", "抗生素"}, {"头孢呋辛", "抗生素"}, {"阿奇霉素", "抗生素"},
+    {"左氧氟沙星", "抗生素"}, {"罗红霉素", "抗生素"}, {"克拉霉素", "抗生素"}, {"甲硝唑片", "抗生素"},
+    {"诺氟沙星", "抗生素"}, {"青霉素V钾片", "抗生素"},
+    {"布洛芬缓释胶囊", "止痛药"}, {"对乙酰氨基酚", "止痛药"}, {"双氯芬酸钠", "止痛药"}, {"塞来昔布", "止痛药"},
+    {"洛索洛芬钠", "止痛药"}, {"萘普生", "止痛药"}, {"阿司匹林肠溶片", "止痛药"},
+    {"感冒灵颗粒", "感冒药"}, {"连花清瘟胶囊", "感冒药"}, {"板蓝根颗粒", "感冒药"}, {"维C银翘片", "感冒药"},
+    {"白加黑", "感冒药"}, {"新康泰克", "感冒药"}, {"小柴胡颗粒", "感冒药"}, {"双黄连口服液", "感冒药"},
+    {"氨溴索", "呼吸系统药物"}, {"急支糖浆", "呼吸系统药物"}, {"川贝枇杷膏", "呼吸系统药物"},
+    {"肺力咳合剂", "呼吸系统药物"}, {"沙丁胺醇气雾剂", "呼吸系统药物"}, {"右美沙芬", "呼吸系统药物"},
+    {"奥美拉唑肠溶胶囊", "消化系统药物"}, {"蒙脱石散", "消化系统药物"}, {"多潘立酮", "消化系统药物"},
+    {"健胃消食片", "消化系统药物"}, {"铝碳酸镁咀嚼片", "消化系统药物"}, {"双歧杆菌三联活菌", "消化系统药物"},
+    {"雷贝拉唑", "消化系统药物"}, {"法莫替丁", "消化系统药物"},
+    {"硝苯地平控释片", "心血管药物"}, {"氨氯地平", "心血管药物"}, {"阿托伐他汀钙片", "心血管药物"},
+    {"瑞舒伐他汀", "心血管药物"}, {"缬沙坦", "心血管药物"}, {"美托洛尔", "心血管药物"}, {"氯吡格雷", "心血管药物"},
+    {"复方丹参滴丸", "心血管药物"},
+    {"维生素C片", "维生素"}, {"维生素B族", "维生素"}, {"维生素D3", "维生素"}, {"善存", "维生素"},
+    {"钙尔奇D", "维生素"}, {"21金维他", "维生素"},
+    {"六味地黄丸", "中成药"}, {"逍遥丸", "中成药"}, {"藿香正气水", "中成药"}, {"牛黄解毒片", "中成药"},
+    {"补中益气丸", "中成药"}, {"金匮肾气丸", "中成药"}, {"安宫牛黄丸", "中成药"},
+    {"小儿感冒颗粒", "儿科药物"}, {"小儿氨酚黄那敏颗粒", "儿科药物"}, {"小儿七星茶颗粒", "儿科药物"},
+    {"妈咪爱", "儿科药物"}, {"小儿化痰止咳颗粒", "儿科药物"},
+    {"乌鸡白凤丸", "妇科药物"}, {"妇科千金片", "妇科药物"}, {"益母草颗粒", "妇科药物"}, {"保妇康栓", "妇科药物"},
+    {"皮炎平", "皮肤科药物"}, {"红霉素软膏", "皮肤科药物"}, {"酮康唑乳膏", "皮肤科药物"}, {"炉甘石洗剂", "皮肤科药物"},
+    {"莫匹罗星软膏", "皮肤科药物"}, {"云南白药气雾剂", "外用药"}, {"风油精", "外用药"}, {"创可贴", "外用药"},
+    {"玻璃酸钠滴眼液", "眼科药物"}, {"左氧氟沙星滴眼液", "眼科药物"}, {"人工泪液", "眼科药物"}, {"萘敏维滴眼液", "眼科药物"},
+};
+const int kBaseCount = static_cast<int>(sizeof(kBaseDrugs) / sizeof(kBaseDrugs[0]));
+
+const char *kManufacturers[] = {
+    "国药集团", "恒瑞医药", "广药集团", "华润三九", "北京同仁堂", "云南白药", "以岭药业", "修正药业",
+    "步长制药", "哈药集团", "上海医药", "复星医药", "石药集团", "齐鲁制药", "扬子江药业", "华北制药",
+    "东北制药", "康缘药业", "片仔癀", "白云山", "拜耳制药", "辉瑞制药", "阿斯利康", "赛诺菲",
+    "罗氏制药", "诺华制药", "强生制药", "葛兰素史克",
+};
+const int kManufacturerCount = static_cast<int>(sizeof(kManufacturers) / sizeof(kManufacturers[0]));
+
+const char *kSpecs[] = {
+    "0.25g*24粒", "0.5g*12片", "10ml*6支", "15ml*1瓶", "1g*20袋", "3g*9袋", "20g*1支", "60ml*1瓶",
+    "75mg*10片", "5mg*28片", "100ml*1瓶", "0.1g*30粒", "6粒*2板", "2.5mg*28片", "10g*6袋",
+};
+const int kSpecCount = static_cast<int>(sizeof(kSpecs) / sizeof(kSpecs[0]));
+
+const char *kOperators[] = { "admin", "clerk", "张敏", "李娜", "王强", "刘洋", "陈静", "赵磊" };
+const int kOperatorCount = static_cast<int>(sizeof(kOperators) / sizeof(kOperators[0]));
+
+const int kShelfLives[] = { 365, 540, 730, 1095 };
+
+// 公历日期与 1970-01-01 起算天数互转（Howard Hinnant 算法），避免逐行调用 mktime
+long long daysFromCivil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const long long era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<long long>(doe) - 719468;
+}
+
+void civilFromDays(long long z, int &y, unsigned &m, unsigned &d) {
+    z += 719468;
+    const long long era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int>(yoe) + static_cast<int>(era * 400) + (m <= 2);
+}
+
+std::string formatDate(long long day) {
+    int y; unsigned m, d;
+    civilFromDays(day, y, m, d);
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%04d-%02u-%02u", y, m, d);
+    return buf;
+}
+
+std::string formatTimestamp(long long seconds) {
+    long long day = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+    long long sod = seconds - day * 86400;
+    int y; unsigned m, d;
+    civilFromDays(day, y, m, d);
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%04d-%02u-%02uT%02d:%02d:%02d", y, m, d,
+                  static_cast<int>(sod / 3600), static_cast<int>(sod / 60 % 60), static_cast<int>(sod % 60));
+    return buf;
+}
+
+bool parseAnchor(const std::string &s, long long &day) {
+    int y = 0, m = 0, d = 0;
+    if (std::sscanf(s.c_str(), "%d-%d-%d", &y, &m, &d) != 3) return false;
+    day = daysFromCivil(y, static_cast<unsigned>(m), static_cast<unsigned>(d));
+    return true;
+}
+
+std::string drugName(long long i) {
+    std::string name = kBaseDrugs[i % kBaseCount].name;
+    long long round = i / kBaseCount;
+    if (round > 0) name += "_" + std::to_string(round);
+    return name;
+}
+
+bool execSql(sqlite3 *db, const char *sql) {
+    char *err = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        if (err) sqlite3_free(err);
+        return false;
+    }
+    return true;
+}
+
+// 生成格式版本：数据布局变化（如新增列）时递增，使旧缓存失效
+const int kFormatVersion = 2;
+
+std::string metaValue(const DataGenOptions &opt) {
+    return "v" + std::to_string(kFormatVersion) + "/" + std::to_string(opt.seed) + "/" + std::to_string(opt.drugs) + "/" + std::to_string(opt.sales) + "/" +
+           std::to_string(opt.historyDays) + "/" + opt.anchorDate;
+}
+
+} // namespace
+
+bool generatedDatabaseMatches(const std::string &dbPath, const DataGenOptions &opt) {
+    sqlite3 *db = nullptr;
+    if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        if (db) sqlite3_close(db);
+        return false;
+    }
+    bool match = false;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT value FROM bench_meta WHERE key='datagen'", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char *v = sqlite3_column_text(stmt, 0);
+            match = v && metaValue(opt) == reinterpret_cast<const char*>(v);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+    return match;
+}
+
+bool generateDatabase(const std::string &dbPath, const DataGenOptions &opt, std::ostream &log) {
+    long long anchorDay = 0;
+    if (!parseAnchor(opt.anchorDate, anchorDay)) { log << "[生成] 锚定日期格式错误：" << opt.anchorDate << "\n"; return false; }
+    // 先用正式的建表逻辑初始化，保证结构与程序一致
+    {
+        SqliteDatabase schema(dbPath);
+        if (!schema.init()) return false;
+    }
+    sqlite3 *db = nullptr;
+    if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
+        log << "[生成] 打开数据库失败：" << sqlite3_errmsg(db) << "\n";
+        if (db) sqlite3_close(db);
+        return false;
+    }
+    // 批量导入：关闭同步与回滚日志，单事务写入
+    execSql(db, "PRAGMA synchronous=OFF");
+    execSql(db, "PRAGMA journal_mode=OFF");
+    execSql(db, "CREATE TABLE IF NOT EXISTS bench_meta(key TEXT PRIMARY KEY, value TEXT)");
+    execSql(db, "BEGIN");
+    execSql(db, "DELETE FROM drugs");
+    execSql(db, "DELETE FROM sales");
+    execSql(db, "DELETE FROM sqlite_sequence WHERE name='sales'");
+    execSql(db, "DELETE FROM bench_meta");
+
+    auto t0 = std::chrono::steady_clock::now();
+    Rng rng(opt.seed);
+    std::vector<int> totalSold(static_cast<size_t>(opt.drugs > 0 ? opt.drugs : 0), 0);
+
+    // 销售记录：时间单调递增，药品按幂律分布（少数畅销品占多数销量）
+    sqlite3_stmt *ins = nullptr;
+    sqlite3_prepare_v2(db, "INSERT INTO sales(drug_name, quantity, timestamp, operator, type) VALUES(?,?,?,?,?)", -1, &ins, nullptr);
+    const long long startSec = (anchorDay - opt.historyDays) * 86400LL;
+    const long long spanSec = opt.historyDays * 86400LL;
+    for (long long i = 0; i < opt.sales && opt.drugs > 0; ++i) {
+        double u = rng.unit();
+        long long rank = static_cast<long long>(u * u * u * static_cast<double>(opt.drugs));
+        long long idx = static_cast<long long>((static_cast<unsigned long long>(rank) * 2654435761ULL) % static_cast<unsigned long long>(opt.drugs));
+        uint64_t kind = rng.below(100);
+        int qty;
+        if (kind < 95) qty = 1 + static_cast<int>(rng.below(5));        // 销售
+        else if (kind < 99) qty = -(1 + static_cast<int>(rng.below(2))); // 退货
+        else qty = -(1 + static_cast<int>(rng.below(3)));                // 报损
+        if (kind < 95) totalSold[idx] += qty;
+        else if (kind < 99) totalSold[idx] = totalSold[idx] + qty < 0 ? 0 : totalSold[idx] + qty;
+        long long ts = startSec + static_cast<long long>(static_cast<double>(i) / static_cast<double>(opt.sales) * spanSec)
+                       + static_cast<long long>(rng.below(60));
+        std::string name = drugName(idx);
+        std::string tsText = formatTimestamp(ts);
+        sqlite3_bind_text(ins, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(ins, 2, qty);
+        sqlite3_bind_text(ins, 3, tsText.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(ins, 4, kOperators[rng.below(kOperatorCount)], -1, SQLITE_STATIC);
+        sqlite3_bind_text(ins, 5, kind < 95 ? "SALE" : (kind < 99 ? "RETURN" : "WASTAGE"), -1, SQLITE_STATIC);
+        if (sqlite3_step(ins) != SQLITE_DONE) { log << "[生成] 写入销售失败：" << sqlite3_errmsg(db) << "\n"; break; }
+        sqlite3_reset(ins);
+        if ((i + 1) % 1000000 == 0) log << "[生成] 销售 " << (i + 1) << "/" << opt.sales << "\n";
+    }
+    sqlite3_finalize(ins);
+
+    sqlite3_prepare_v2(db, "INSERT INTO drugs(name, category, manufacturer, specification, production_date, stock, total_sold, shelf_life_days, near_expiry_days) VALUES(?,?,?,?,?,?,?,?,?)", -1, &ins, nullptr);
+    for (long long i = 0; i < opt.drugs; ++i) {
+        const BaseDrug &base = kBaseDrugs[i % kBaseCount];
+        std::string name = drugName(i);
+        std::string prod = formatDate(anchorDay - static_cast<long long>(rng.below(3 * 365)));
+        sqlite3_bind_text(ins, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(ins, 2, base.category, -1, SQLITE_STATIC);
+        sqlite3_bind_text(ins, 3, kManufacturers[rng.below(kManufacturerCount)], -1, SQLITE_STATIC);
+        sqlite3_bind_text(ins, 4, kSpecs[rng.below(kSpecCount)], -1, SQLITE_STATIC);
+        sqlite3_bind_text(ins, 5, prod.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(ins, 6, static_cast<int>(rng.below(1000)));
+        sqlite3_bind_int(ins, 7, totalSold[i]);
+        sqlite3_bind_int(ins, 8, kShelfLives[rng.below(4)]);
+        sqlite3_bind_int(ins, 9, 30 + static_cast<int>(rng.below(151)));
+        if (sqlite3_step(ins) != SQLITE_DONE) { log << "[生成] 写入药品失败：" << sqlite3_errmsg(db) << "\n"; break; }
+        sqlite3_reset(ins);
+        if ((i + 1) % 1000000 == 0) log << "[生成] 药品 " << (i + 1) << "/" << opt.drugs << "\n";
+    }
+    sqlite3_finalize(ins);
+
+    std::string meta = "INSERT INTO bench_meta(key, value) VALUES('datagen', '" + metaValue(opt) + "')";
+    execSql(db, meta.c_str());
+    bool ok = execSql(db, "COMMIT");
+    execSql(db, "PRAGMA journal_mode=DELETE");
+    sqlite3_close(db);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    log << "[生成] 完成：药品 " << opt.drugs << "，销售 " << opt.sales << "，耗时 " << secs << " s\n";
+    return ok;
+}
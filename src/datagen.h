@@ -0,0 +1,24 @@
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// 确定性合成数据生成器：相同参数（含种子）生成逐字节相同的药品与销售记录，
+// 用于基准测试与回放压测。药名、分类、厂家、规格取自常见中文药品词表。
+struct DataGenOptions {
+    uint64_t seed = 20240101;
+    long long drugs = 1000;
+    long long sales = 10000;
+    int historyDays = 730;             // 销售历史跨度（天），截止于 anchorDate
+    std::string anchorDate = "2025-01-01"; // 视为“今天”的日期，固定以保证可复现
+};
+
+// 在 dbPath 生成数据库（已存在的 drugs/sales 会被清空）。进度输出到 log。
+bool generateDatabase(const std::string &dbPath, const DataGenOptions &opt, std::ostream &log);
+
+// 若 dbPath 中记录的生成参数与 opt 一致则返回 true，可跳过重新生成
+bool generatedDatabaseMatches(const std::string &dbPath, const DataGenOptions &opt);
+
+#endif // DATAGEN_H
@@ -2,6 +2,7 @@
 #include <iomanip>
 #include <sstream>
 #include <cctype>
+#include <cstdio>
 
 // 解析严格格式 YYYY-MM-DD 到 std::tm（必须为四位年、两位月、两位日，且日期有效）
 bool parseDate(const std::string &dateStr, std::tm &tmOut) {
@@ -60,4 +61,47 @@ int daysUntil(std::time_t future) {
     std::time_t now = std::time(nullptr);
     double diff = std::difftime(future, now);
     return static_cast<int>(diff / (24 * 3600));
-}
\ No newline at end of file
+}
+
+// 公历日期与日序号互转（proleptic Gregorian，按 400 年周期计算）
+static int days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;
+    const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+bool dateToDay(const std::string &dateStr, int &dayOut) {
+    std::tm tm{};
+    if (!parseDate(dateStr, tm)) return false;
+    dayOut = days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    return true;
+}
+
+std::string dayToDate(int day) {
+    int z = day + 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const int doe = z - era * 146097;
+    const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int mp = (5 * doy + 2) / 153;
+    const int d = doy - (153 * mp + 2) / 5 + 1;
+    const int m = mp + (mp < 10 ? 3 : -9);
+    const int y = yoe + era * 400 + (m <= 2);
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d", y, m, d);
+    return std::string(buf);
+}
+
+int todayDay() {
+    std::time_t now = std::time(nullptr);
+    std::tm tmNow{};
+#ifdef _WIN32
+    localtime_s(&tmNow, &now);
+#else
+    localtime_r(&now, &tmNow);
+#endif
+    return days_from_civil(tmNow.tm_year + 1900, tmNow.tm_mon + 1, tmNow.tm_mday);
+}
@@ -20,5 +20,9 @@ bool parseDate(const std::string &dateStr, std::tm &tmOut);
 std::time_t toTimeT(std::tm &tmVal);
 std::time_t addDays(std::time_t start, int days);
 int daysUntil(std::time_t future);
+// 日序号：1970-01-01 起的天数（与时区无关），用于批次到期日的整数比较
+bool dateToDay(const std::string &dateStr, int &dayOut);
+std::string dayToDate(int day);
+int todayDay(); // 本地日期的日序号
 
 #endif 
\ No newline at end of file
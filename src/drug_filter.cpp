@@ -0,0 +1,312 @@
+#include "drug_filter.h"
+#include <cctype>
+#include <cstdlib>
+
+static const int kStockBuckets = 33;
+
+// 0 号桶：库存 ≤ 0；b 号桶（b ≥ 1）：[2^(b-1), 2^b - 1]
+int DrugFilterIndex::stockBucket(int stock) {
+    if (stock <= 0) return 0;
+    int b = 0;
+    for (unsigned v = static_cast<unsigned>(stock); v; v >>= 1) ++b;
+    return b;
+}
+
+int DrugFilterIndex::expiryBucket(int day) {
+    return day >= 0 ? day / 7 : -((-day + 6) / 7);
+}
+
+void DrugFilterIndex::clear() {
+    info.clear();
+    byCategory.clear();
+    byManufacturer.clear();
+    stockBuckets.assign(kStockBuckets, RoaringBitmap());
+    expiryBuckets.clear();
+}
+
+void DrugFilterIndex::indexRow(uint32_t row) {
+    const RowInfo &r = info[row];
+    byCategory[r.category].add(row);
+    byManufacturer[r.manufacturer].add(row);
+    stockBuckets[static_cast<size_t>(stockBucket(r.stock))].add(row);
+    if (r.expiryDay != kNoExpiry) expiryBuckets[expiryBucket(r.expiryDay)].add(row);
+}
+
+// 从各位图中移除一行，位图变空时删除该键，避免已改名的分类/厂家残留
+void DrugFilterIndex::unindexRow(uint32_t row) {
+    const RowInfo &r = info[row];
+    auto dropFrom = [row](std::unordered_map<std::string, RoaringBitmap> &m, const std::string &key) {
+        auto it = m.find(key);
+        if (it == m.end()) return;
+        it->second.remove(row);
+        if (it->second.empty()) m.erase(it);
+    };
+    dropFrom(byCategory, r.category);
+    dropFrom(byManufacturer, r.manufacturer);
+    stockBuckets[static_cast<size_t>(stockBucket(r.stock))].remove(row);
+    if (r.expiryDay != kNoExpiry) {
+        auto it = expiryBuckets.find(expiryBucket(r.expiryDay));
+        if (it != expiryBuckets.end()) {
+            it->second.remove(row);
+            if (it->second.empty()) expiryBuckets.erase(it);
+        }
+    }
+}
+
+void DrugFilterIndex::set(uint32_t row, const std::string &category, const std::string &manufacturer, int stock, int expiryDay) {
+    if (stockBuckets.empty()) stockBuckets.assign(kStockBuckets, RoaringBitmap());
+    while (info.size() < row) {
+        info.emplace_back();
+        indexRow(static_cast<uint32_t>(info.size() - 1));
+    }
+    if (row < info.size()) {
+        const RowInfo &old = info[row];
+        if (old.category == category && old.manufacturer == manufacturer && old.stock == stock && old.expiryDay == expiryDay) return;
+        unindexRow(row);
+    } else {
+        info.emplace_back();
+    }
+    RowInfo &r = info[row];
+    r.category = category;
+    r.manufacturer = manufacturer;
+    r.stock = stock;
+    r.expiryDay = expiryDay;
+    indexRow(row);
+}
+
+size_t DrugFilterIndex::memoryBytes() const {
+    size_t n = 0;
+    for (const auto &kv : byCategory) n += kv.second.memoryBytes();
+    for (const auto &kv : byManufacturer) n += kv.second.memoryBytes();
+    for (const auto &b : stockBuckets) n += b.memoryBytes();
+    for (const auto &kv : expiryBuckets) n += kv.second.memoryBytes();
+    return n;
+}
+
+const RoaringBitmap *DrugFilterIndex::categoryRows(const std::string &category) const {
+    auto it = byCategory.find(category);
+    return it == byCategory.end() ? nullptr : &it->second;
+}
+
+namespace {
+
+enum class CmpOp { Eq, Ne, Lt, Le, Gt, Ge };
+
+bool compare(long long x, CmpOp op, long long v) {
+    switch (op) {
+        case CmpOp::Eq: return x == v;
+        case CmpOp::Ne: return x != v;
+        case CmpOp::Lt: return x < v;
+        case CmpOp::Le: return x <= v;
+        case CmpOp::Gt: return x > v;
+        case CmpOp::Ge: return x >= v;
+    }
+    return false;
+}
+
+// 区间 [lo, hi] 与条件的关系：0 全不满足，1 部分满足（需逐行核对），2 全部满足
+int rangeMatch(long long lo, long long hi, CmpOp op, long long v) {
+    bool loOk = compare(lo, op, v), hiOk = compare(hi, op, v);
+    if (op == CmpOp::Eq) return (v < lo || v > hi) ? 0 : (lo == hi ? 2 : 1);
+    if (op == CmpOp::Ne) return (v < lo || v > hi) ? 2 : (lo == hi ? 0 : 1);
+    // 其余运算在区间上单调：两端结果相同即整段相同
+    if (loOk && hiOk) return 2;
+    if (!loOk && !hiOk) return 0;
+    return 1;
+}
+
+struct Token {
+    enum Kind { Word, Op, LParen, RParen, End } kind = End;
+    std::string text;
+    bool quoted = false;
+};
+
+bool startsWith(const std::string &s, size_t i, const char *lit) {
+    return s.compare(i, std::char_traits<char>::length(lit), lit) == 0;
+}
+
+bool tokenize(const std::string &s, std::vector<Token> &out, std::string &error) {
+    size_t i = 0;
+    while (i < s.size()) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (std::isspace(c)) { ++i; continue; }
+        Token t;
+        if (c == '(' || startsWith(s, i, "（")) {
+            t.kind = Token::LParen; i += c == '(' ? 1 : 3;
+        } else if (c == ')' || startsWith(s, i, "）")) {
+            t.kind = Token::RParen; i += c == ')' ? 1 : 3;
+        } else if (c == '=' || c == '!' || c == '<' || c == '>') {
+            t.kind = Token::Op;
+            t.text = s.substr(i, (i + 1 < s.size() && s[i + 1] == '=') ? 2 : 1);
+            i += t.text.size();
+            if (t.text == "!") { error = "无法识别的运算符 !"; return false; }
+        } else if (c == '"') {
+            size_t end = s.find('"', i + 1);
+            if (end == std::string::npos) { error = "引号未闭合"; return false; }
+            t.kind = Token::Word; t.quoted = true;
+            t.text = s.substr(i + 1, end - i - 1);
+            i = end + 1;
+        } else {
+            size_t start = i;
+            while (i < s.size()) {
+                unsigned char ch = static_cast<unsigned char>(s[i]);
+                if (std::isspace(ch) || ch == '(' || ch == ')' || ch == '=' || ch == '!' || ch == '<' || ch == '>' || ch == '"'
+                    || startsWith(s, i, "（") || startsWith(s, i, "）")) break;
+                ++i;
+            }
+            t.kind = Token::Word;
+            t.text = s.substr(start, i - start);
+        }
+        out.push_back(t);
+    }
+    out.push_back(Token());
+    return true;
+}
+
+std::string upper(std::string s) {
+    for (auto &ch : s) ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+    return s;
+}
+
+} // namespace
+
+// 递归下降：expr := term (OR term)*；term := factor (AND factor)*；factor := '(' expr ')' | 字段 运算符 值
+class FilterParser {
+public:
+    FilterParser(const DrugFilterIndex &idx, std::vector<Token> toks, int today)
+        : idx(idx), toks(std::move(toks)), today(today) {}
+
+    bool parse(RoaringBitmap &out, std::string &error) {
+        bool ok = parseOr(out);
+        if (ok && peek().kind != Token::End) { err = "多余的内容：" + peek().text; ok = false; }
+        if (!ok) error = err;
+        return ok;
+    }
+
+private:
+    const DrugFilterIndex &idx;
+    std::vector<Token> toks;
+    size_t p = 0;
+    int today;
+    std::string err;
+
+    const Token &peek() const { return toks[p]; }
+    bool isKeyword(const char *en, const char *zh) const {
+        const Token &t = peek();
+        return t.kind == Token::Word && !t.quoted && (upper(t.text) == en || t.text == zh);
+    }
+
+    bool parseOr(RoaringBitmap &out) {
+        if (!parseAnd(out)) return false;
+        while (isKeyword("OR", "或")) {
+            ++p;
+            RoaringBitmap rhs;
+            if (!parseAnd(rhs)) return false;
+            out |= rhs;
+        }
+        return true;
+    }
+
+    bool parseAnd(RoaringBitmap &out) {
+        if (!parseFactor(out)) return false;
+        while (isKeyword("AND", "且")) {
+            ++p;
+            RoaringBitmap rhs;
+            if (!parseFactor(rhs)) return false;
+            out = out & rhs;
+        }
+        return true;
+    }
+
+    bool parseFactor(RoaringBitmap &out) {
+        if (peek().kind == Token::LParen) {
+            ++p;
+            if (!parseOr(out)) return false;
+            if (peek().kind != Token::RParen) { err = "缺少右括号"; return false; }
+            ++p;
+            return true;
+        }
+        if (peek().kind != Token::Word) { err = peek().kind == Token::End ? "条件不完整" : "此处应为字段名：" + peek().text; return false; }
+        std::string field = peek().text;
+        ++p;
+        if (peek().kind != Token::Op) { err = "字段 " + field + " 后缺少比较运算符"; return false; }
+        std::string opText = peek().text;
+        ++p;
+        if (peek().kind != Token::Word) { err = "运算符 " + opText + " 后缺少取值"; return false; }
+        std::string value = peek().text;
+        ++p;
+
+        CmpOp op;
+        if (opText == "=" || opText == "==") op = CmpOp::Eq;
+        else if (opText == "!=") op = CmpOp::Ne;
+        else if (opText == "<") op = CmpOp::Lt;
+        else if (opText == "<=") op = CmpOp::Le;
+        else if (opText == ">") op = CmpOp::Gt;
+        else op = CmpOp::Ge;
+
+        std::string f = upper(field);
+        if (f == "CATEGORY" || field == "分类") return matchValue(idx.byCategory, op, value, field, out);
+        if (f == "MANUFACTURER" || field == "厂家" || field == "生产厂家") return matchValue(idx.byManufacturer, op, value, field, out);
+        bool isStock = f == "STOCK" || field == "库存";
+        bool isExpiry = f == "EXPIRY" || field == "到期";
+        if (!isStock && !isExpiry) { err = "未知字段：" + field; return false; }
+        char *end = nullptr;
+        long long v = std::strtoll(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0') { err = "数值格式错误：" + value; return false; }
+        if (isStock) matchStock(op, v, out);
+        else matchExpiry(op, v, out);
+        return true;
+    }
+
+    bool matchValue(const std::unordered_map<std::string, RoaringBitmap> &m, CmpOp op, const std::string &value,
+                    const std::string &field, RoaringBitmap &out) {
+        if (op != CmpOp::Eq && op != CmpOp::Ne) { err = field + " 只支持 = 或 !="; return false; }
+        auto it = m.find(value);
+        RoaringBitmap hit = it == m.end() ? RoaringBitmap() : it->second;
+        out = op == CmpOp::Eq ? hit : RoaringBitmap::range(0, static_cast<uint32_t>(idx.info.size())).andNot(hit);
+        return true;
+    }
+
+    void matchStock(CmpOp op, long long v, RoaringBitmap &out) {
+        std::vector<const RoaringBitmap *> parts;
+        RoaringBitmap partial;
+        for (size_t b = 0; b < idx.stockBuckets.size(); ++b) {
+            const RoaringBitmap &bucket = idx.stockBuckets[b];
+            if (bucket.empty()) continue;
+            long long lo = b == 0 ? INT_MIN : (1LL << (b - 1)), hi = b == 0 ? 0 : (1LL << b) - 1;
+            int m = rangeMatch(lo, hi, op, v);
+            if (m == 2) parts.push_back(&bucket);
+            else if (m == 1) refine(bucket, partial, [&](uint32_t row) { return compare(idx.info[row].stock, op, v); });
+        }
+        parts.push_back(&partial);
+        out = RoaringBitmap::unionAll(parts);
+    }
+
+    // 到期条件比较剩余天数：expiryDay - today op v  等价于  expiryDay op today + v
+    void matchExpiry(CmpOp op, long long v, RoaringBitmap &out) {
+        std::vector<const RoaringBitmap *> parts;
+        RoaringBitmap partial;
+        const long long target = static_cast<long long>(today) + v;
+        for (const auto &kv : idx.expiryBuckets) {
+            long long lo = static_cast<long long>(kv.first) * 7, hi = lo + 6;
+            int m = rangeMatch(lo, hi, op, target);
+            if (m == 2) parts.push_back(&kv.second);
+            else if (m == 1) refine(kv.second, partial, [&](uint32_t row) { return compare(idx.info[row].expiryDay, op, target); });
+        }
+        parts.push_back(&partial);
+        out = RoaringBitmap::unionAll(parts);
+    }
+
+    // 边界桶逐行核对（每个条件至多两个边界桶）
+    template <typename Pred> static void refine(const RoaringBitmap &bucket, RoaringBitmap &out, Pred pred) {
+        bucket.forEach([&](uint32_t row) { if (pred(row)) out.add(row); });
+    }
+};
+
+bool DrugFilterIndex::query(const std::string &expr, int today, RoaringBitmap &out, std::string &error) const {
+    std::vector<Token> toks;
+    if (!tokenize(expr, toks, error)) return false;
+    if (toks.size() == 1) { error = "表达式为空"; return false; }
+    FilterParser parser(*this, std::move(toks), today);
+    return parser.parse(out, error);
+}
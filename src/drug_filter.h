@@ -0,0 +1,52 @@
+#ifndef DRUG_FILTER_H
+#define DRUG_FILTER_H
+
+#include "bitmap.h"
+#include <climits>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 药品组合条件查询的位图索引，行号即药品在目录中的下标。
+// 分类、厂家按取值各建一个位图；库存按 2 的幂分桶（0 及以下、1、2-3、4-7 ...），
+// 最早到期日按周分桶。范围条件先并上整桶落在范围内的位图，边界桶再逐行核对。
+//
+// 表达式示例：分类=抗生素 AND 厂家=华北制药 AND 库存<50 AND 到期<=60
+//   字段：category/分类、manufacturer/厂家、stock/库存、expiry/到期（距今天数，负数为已过期）
+//   运算：= != < <= > >=（分类与厂家只支持 = 与 !=），AND/且、OR/或，括号分组；含空格的值用双引号
+class DrugFilterIndex {
+public:
+    static const int kNoExpiry = INT_MIN; // 日期无法解析、没有批次的药品不参与到期条件
+
+    void clear();
+    // 写入或更新一行；row 等于当前行数时追加
+    void set(uint32_t row, const std::string &category, const std::string &manufacturer, int stock, int expiryDay);
+    size_t rows() const { return info.size(); }
+    size_t memoryBytes() const;
+    // 某分类的全部行；没有该分类时返回 nullptr
+    const RoaringBitmap *categoryRows(const std::string &category) const;
+    // 解析并求值，today 为计算到期剩余天数的基准日
+    bool query(const std::string &expr, int today, RoaringBitmap &out, std::string &error) const;
+
+private:
+    friend class FilterParser;
+    struct RowInfo {
+        std::string category;
+        std::string manufacturer;
+        int stock = 0;
+        int expiryDay = kNoExpiry;
+    };
+    std::vector<RowInfo> info;
+    std::unordered_map<std::string, RoaringBitmap> byCategory;
+    std::unordered_map<std::string, RoaringBitmap> byManufacturer;
+    std::vector<RoaringBitmap> stockBuckets;    // 下标见 stockBucket
+    std::map<int, RoaringBitmap> expiryBuckets; // 周序号 -> 位图
+
+    static int stockBucket(int stock);
+    static int expiryBucket(int day);
+    void indexRow(uint32_t row);
+    void unindexRow(uint32_t row);
+};
+
+#endif // DRUG_FILTER_H
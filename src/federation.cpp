@@ -0,0 +1,159 @@
+#include "federation.h"
+#include "thread_pool.h"
+#include "sales_archive.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <thread>
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// 只读读取分片的药品（名称、分类、库存、累计销量，其余列报表用不到）、归档段清单与归档目录；
+// 名称与分类复制进分片表的字符串区，合并阶段直接以视图为键
+bool loadShardDrugs(const std::string &path, DrugTable &out, std::string &manifest, std::string &archiveDir, std::string &error) {
+    sqlite3 *db = nullptr;
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        error = db ? sqlite3_errmsg(db) : "无法打开";
+        if (db) sqlite3_close(db);
+        return false;
+    }
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT name, category, stock, total_sold FROM drugs", -1, &stmt, nullptr) != SQLITE_OK) {
+        error = sqlite3_errmsg(db);
+        sqlite3_close(db);
+        return false;
+    }
+    sqlite3_stmt *count = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM drugs", -1, &count, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(count) == SQLITE_ROW) out.rows.reserve(static_cast<size_t>(sqlite3_column_int64(count, 0)));
+        sqlite3_finalize(count);
+    }
+    auto text = [&](int col) {
+        const unsigned char *t = sqlite3_column_text(stmt, col);
+        return t ? out.arena.copy(reinterpret_cast<const char *>(t), static_cast<size_t>(sqlite3_column_bytes(stmt, col))) : std::string_view();
+    };
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        DrugView d;
+        d.name = text(0);
+        d.category = text(1);
+        d.stock = sqlite3_column_int(stmt, 2);
+        d.totalSold = sqlite3_column_int(stmt, 3);
+        out.rows.push_back(d);
+    }
+    if (rc != SQLITE_DONE) error = sqlite3_errmsg(db);
+    sqlite3_finalize(stmt);
+    // 旧库可能没有 app_meta 表，视为没有归档
+    if (rc == SQLITE_DONE && sqlite3_prepare_v2(db, "SELECT value FROM app_meta WHERE key = ?", -1, &stmt, nullptr) == SQLITE_OK) {
+        auto meta = [&](const char *key, std::string &value) {
+            sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0))
+                value = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+            sqlite3_reset(stmt);
+        };
+        meta(SalesArchive::manifestKey(), manifest);
+        meta(SalesArchive::dirKey(), archiveDir);
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+    return rc == SQLITE_DONE;
+}
+
+std::string dirOf(const std::string &path) {
+    auto pos = path.find_last_of("/\\");
+    return pos == std::string::npos ? std::string(".") : path.substr(0, pos);
+}
+
+} // namespace
+
+FederatedReport runFederatedReports(const std::vector<std::string> &dbPaths, size_t topK, int threads) {
+    const auto t0 = std::chrono::steady_clock::now();
+    FederatedReport report;
+    if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (threads <= 0) threads = 4;
+    const int shardCount = static_cast<int>(dbPaths.size());
+    report.threads = std::max(1, std::min(threads, shardCount));
+    report.scanThreads = std::max(1, threads / std::max(1, shardCount));
+    report.shards.resize(dbPaths.size());
+    std::vector<DrugTable> shardDrugs(dbPaths.size());
+    std::vector<CategoryMonthTotals> shardMonths(dbPaths.size());
+
+    // 各分片的结果写入自己的下标，互不共享
+    {
+        WorkStealingPool pool(report.threads);
+        for (size_t i = 0; i < dbPaths.size(); ++i) {
+            pool.submit([&, i](int) {
+                const auto s0 = std::chrono::steady_clock::now();
+                ShardResult &r = report.shards[i];
+                r.path = dbPaths[i];
+                const std::vector<DrugView> &drugs = shardDrugs[i].rows;
+                std::string manifest, archiveDir;
+                if (!loadShardDrugs(r.path, shardDrugs[i], manifest, archiveDir, r.error)) { r.seconds = secondsSince(s0); return; }
+                // 归档目录以分片自己记录的为准；未记录（旧库）时取库文件同目录下的 archive/
+                if (archiveDir.empty()) archiveDir = dirOf(r.path) + "/archive";
+                SalesArchive archive;
+                if (!archive.open(archiveDir, manifest, r.error)) { r.seconds = secondsSince(s0); return; }
+                r.loadSeconds = secondsSince(s0);
+                r.drugs = static_cast<long long>(drugs.size());
+                for (const auto &d : drugs) { r.totalSold += d.totalSold; r.totalStock += d.stock; }
+                SalesScanEngine engine(r.path, report.scanThreads);
+                shardMonths[i] = aggregateCategoryMonthly(engine, drugs, r.scan, &archive);
+                r.ok = !r.scan.failed;
+                if (!r.ok) r.error = "扫描销售记录失败";
+                r.seconds = secondsSince(s0);
+            });
+        }
+        pool.waitIdle();
+    }
+
+    // 合并：按输入顺序，结果与分片完成先后无关。键与分类是各分片字符串区的视图，只有前 K 名转成 std::string
+    const auto m0 = std::chrono::steady_clock::now();
+    struct Merged {
+        std::string_view category;
+        long long totalSold = 0;
+        long long stock = 0;
+        int stores = 0;
+    };
+    std::unordered_map<std::string_view, Merged> merged;
+    for (size_t i = 0; i < dbPaths.size(); ++i) {
+        const ShardResult &r = report.shards[i];
+        if (!r.ok) continue;
+        report.totalSold += r.totalSold;
+        report.totalStock += r.totalStock;
+        if (merged.empty()) merged.reserve(shardDrugs[i].rows.size());
+        for (const auto &d : shardDrugs[i].rows) {
+            Merged &f = merged[d.name];
+            if (f.stores == 0) f.category = d.category;
+            f.totalSold += d.totalSold;
+            f.stock += d.stock;
+            f.stores++;
+        }
+        for (const auto &cat : shardMonths[i])
+            for (const auto &m : cat.second) report.catMonth[cat.first][m.first] += m.second;
+    }
+    report.distinctDrugs = merged.size();
+    std::vector<std::pair<std::string_view, const Merged *>> all;
+    all.reserve(merged.size());
+    for (const auto &kv : merged) all.emplace_back(kv.first, &kv.second);
+    const size_t k = std::min(topK, all.size());
+    std::partial_sort(all.begin(), all.begin() + static_cast<std::ptrdiff_t>(k), all.end(), [](const auto &a, const auto &b) {
+        return a.second->totalSold != b.second->totalSold ? a.second->totalSold > b.second->totalSold : a.first < b.first;
+    });
+    report.top.reserve(k);
+    for (size_t i = 0; i < k; ++i) {
+        FederatedDrug f;
+        f.category = std::string(all[i].second->category);
+        f.totalSold = all[i].second->totalSold;
+        f.stock = all[i].second->stock;
+        f.stores = all[i].second->stores;
+        report.top.emplace_back(std::string(all[i].first), std::move(f));
+    }
+    report.mergeSeconds = secondsSince(m0);
+    report.wallSeconds = secondsSince(t0);
+    return report;
+}
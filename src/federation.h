@@ -0,0 +1,50 @@
+#ifndef FEDERATION_H
+#define FEDERATION_H
+
+#include "sales_scan.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 单个门店（分片）的部分聚合与耗时
+struct ShardResult {
+    std::string path;
+    bool ok = false;
+    std::string error;
+    long long drugs = 0;
+    long long totalSold = 0;
+    long long totalStock = 0;
+    ScanStats scan;          // 品类×月份扫描（行数、线程、耗时）
+    double loadSeconds = 0;  // 读取 drugs 表
+    double seconds = 0;      // 分片总耗时
+};
+
+// 按药品名合并后的连锁数据
+struct FederatedDrug {
+    std::string category;
+    long long totalSold = 0;
+    long long stock = 0;
+    int stores = 0;          // 有该药品的门店数
+};
+
+struct FederatedReport {
+    std::vector<ShardResult> shards;  // 与输入顺序一致
+    long long totalSold = 0;
+    long long totalStock = 0;
+    size_t distinctDrugs = 0;
+    std::vector<std::pair<std::string, FederatedDrug>> top; // 连锁销量前 K（同销量按名称）
+    CategoryMonthTotals catMonth;
+    int threads = 0;         // 分片级并行度
+    int scanThreads = 0;     // 每个分片内的扫描线程数
+    double mergeSeconds = 0;
+    double wallSeconds = 0;
+};
+
+// 连锁汇总：每个门店数据库（或其备份快照）为一个分片，只读打开（不建表、不迁移）。
+// 分片在线程池上并行计算部分聚合——药品合计、按药品的销量与库存、品类×月份净销量（复用 aggregateCategoryMonthly），
+// 门店库同目录下有 archive/ 时（见 SalesArchive），品类×月份合计叠加归档段头；清单中的段缺失视为分片失败。
+// 分片数少于线程数时把余下的线程分给分片内的 rowid 区间扫描；全部完成后按药品名、品类、月份合并。
+// threads ≤ 0 时取硬件并发数。
+FederatedReport runFederatedReports(const std::vector<std::string> &dbPaths, size_t topK, int threads);
+
+#endif // FEDERATION_H
@@ -0,0 +1,155 @@
+#include "forecast.h"
+
+// 超过该天数没有销售时直接视为需求为 0，避免逐日结算很长的空白期
+static const int kMaxIdleDays = 120;
+
+void DemandForecaster::settle(DemandState &s, double x) const {
+    if (!s.seeded) {
+        s.level = x;
+        s.trend = 0.0;
+        s.seeded = true;
+        return;
+    }
+    double prev = s.level;
+    s.level = alpha * x + (1 - alpha) * (s.level + s.trend);
+    s.trend = beta * (s.level - prev) + (1 - beta) * s.trend;
+}
+
+void DemandForecaster::observe(DemandState &s, int day, long long netQty) const {
+    if (s.day < 0) { s.day = day; s.pending = netQty; return; }
+    // 晚到的旧日期流水无法回溯修正，计入当前未结算日
+    if (day <= s.day) { s.pending += netQty; return; }
+    settle(s, static_cast<double>(s.pending));
+    int gap = day - s.day - 1;
+    if (gap > kMaxIdleDays) {
+        s.level = 0.0;
+        s.trend = 0.0;
+    } else {
+        for (int i = 0; i < gap; ++i) settle(s, 0.0);
+    }
+    s.day = day;
+    s.pending = netQty;
+}
+
+double DemandForecaster::forecast(const DemandState &s, int today) const {
+    if (s.day < 0) return 0.0;
+    DemandState t = s;
+    if (t.day < today) {
+        if (today - t.day > kMaxIdleDays) return 0.0;
+        settle(t, static_cast<double>(t.pending));
+        for (int d = t.day + 1; d < today; ++d) settle(t, 0.0);
+    } else if (!t.seeded) {
+        // 只有今天的销量：以当天累计量作为初始估计
+        return t.pending > 0 ? static_cast<double>(t.pending) : 0.0;
+    }
+    double f = t.level + t.trend;
+    return f > 0 ? f : 0.0;
+}
+
+void ReorderHeap::swapNodes(size_t a, size_t b) {
+    std::swap(nodes[a], nodes[b]);
+    pos[nodes[a].name] = a;
+    pos[nodes[b].name] = b;
+}
+
+void ReorderHeap::siftUp(size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (nodes[parent].cover <= nodes[i].cover) break;
+        swapNodes(i, parent);
+        i = parent;
+    }
+}
+
+void ReorderHeap::siftDown(size_t i) {
+    const size_t n = nodes.size();
+    while (true) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && nodes[l].cover < nodes[m].cover) m = l;
+        if (r < n && nodes[r].cover < nodes[m].cover) m = r;
+        if (m == i) return;
+        swapNodes(i, m);
+        i = m;
+    }
+}
+
+void ReorderHeap::removeAt(size_t i) {
+    pos.erase(nodes[i].name);
+    if (i + 1 != nodes.size()) {
+        nodes[i] = std::move(nodes.back());
+        nodes.pop_back();
+        pos[nodes[i].name] = i;
+        siftDown(i);
+        siftUp(i);
+    } else {
+        nodes.pop_back();
+    }
+}
+
+void ReorderHeap::update(const std::string &name, double cover, int day) {
+    auto it = pos.find(name);
+    if (cover < 0) {
+        if (it != pos.end()) removeAt(it->second);
+        return;
+    }
+    if (it == pos.end()) {
+        nodes.push_back(Node{ name, cover, day });
+        pos[name] = nodes.size() - 1;
+        siftUp(nodes.size() - 1);
+        return;
+    }
+    Node &n = nodes[it->second];
+    double old = n.cover;
+    n.cover = cover;
+    n.day = day;
+    if (cover < old) siftUp(it->second); else siftDown(it->second);
+}
+
+void ReorderHeap::remove(const std::string &name) {
+    auto it = pos.find(name);
+    if (it != pos.end()) removeAt(it->second);
+}
+
+void ReorderHeap::rename(const std::string &from, const std::string &to) {
+    auto it = pos.find(from);
+    if (it == pos.end()) return;
+    size_t i = it->second;
+    pos.erase(it);
+    nodes[i].name = to;
+    pos[to] = i;
+}
+
+void ReorderHeap::clear() {
+    nodes.clear();
+    pos.clear();
+    refreshedDay = INT_MIN;
+}
+
+std::vector<std::pair<std::string, double>> ReorderHeap::lowest(double maxCover, size_t limit, int today,
+                                                                const std::function<double(const std::string &)> &refresh) {
+    std::vector<std::pair<std::string, double>> result;
+    if (refreshedDay != today) {
+        // 跨日后前一天的销量计入预测、批次可能过期，任一节点的可售天数都可能降到堆顶以下，
+        // 只重算堆顶会漏掉它们：当天首次取用时重算全部旧节点（每天一次，O(n log n)）
+        std::vector<std::string> stale;
+        for (const auto &n : nodes) if (n.day != today) stale.push_back(n.name);
+        for (const auto &name : stale) update(name, refresh(name), today);
+        refreshedDay = today;
+    }
+    std::vector<Node> popped;
+    while (!nodes.empty() && result.size() < limit) {
+        Node &top = nodes[0];
+        if (top.day != today) {
+            // 重算之后又以旧日期写入的节点（如跨日前夕的交易）
+            std::string name = top.name;
+            update(name, refresh(name), today);
+            continue;
+        }
+        if (top.cover >= maxCover) break;
+        result.emplace_back(top.name, top.cover);
+        popped.push_back(top);
+        removeAt(0);
+    }
+    for (const auto &n : popped) update(n.name, n.cover, n.day);
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef FORECAST_H
+#define FORECAST_H
+
+#include "database.h"
+#include <climits>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 按日净销量做 Holt 线性指数平滑：当天的销量先累计，跨日时结算（空白日按 0 结算），
+// 因此每笔交易只是一次加法，跨日结算的摊销成本也是 O(1)。
+class DemandForecaster {
+public:
+    explicit DemandForecaster(double alpha = 0.3, double beta = 0.1) : alpha(alpha), beta(beta) {}
+    void observe(DemandState &s, int day, long long netQty) const;
+    // 预测 today 的日需求（不修改状态；当天未结算的部分不计入）
+    double forecast(const DemandState &s, int today) const;
+
+private:
+    double alpha, beta;
+    void settle(DemandState &s, double x) const;
+};
+
+// 按可售天数（可售库存 ÷ 预测日需求）排序的索引最小堆：库存或预测变化时 O(log n) 更新，
+// 补货报表只取堆顶若干项而不扫描全部药品。键带有计算日，跨日后当天首次取用时重算全部旧节点。
+class ReorderHeap {
+public:
+    void update(const std::string &name, double cover, int day);
+    void remove(const std::string &name);
+    void rename(const std::string &from, const std::string &to);
+    void clear();
+    size_t size() const { return nodes.size(); }
+    // 取可售天数 < maxCover 的前 limit 项（升序）；refresh(name) 返回 today 的可售天数，<0 表示移出堆
+    std::vector<std::pair<std::string, double>> lowest(double maxCover, size_t limit, int today,
+                                                      const std::function<double(const std::string &)> &refresh);
+
+private:
+    struct Node {
+        std::string name;
+        double cover = 0.0;
+        int day = 0;
+    };
+    std::vector<Node> nodes;
+    std::unordered_map<std::string, size_t> pos;
+    int refreshedDay = INT_MIN; // 已重算全部节点的日期
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+    void swapNodes(size_t a, size_t b);
+    void removeAt(size_t i);
+};
+
+#endif // FORECAST_H
@@ -0,0 +1,211 @@
+#include "fuzzy.h"
+#include "pinyin.h"
+#include <queue>
+#include <tuple>
+
+namespace {
+
+// UTF-8 解码为码点，ASCII 字母转小写；非法字节按单字节处理
+std::vector<uint32_t> decodeLower(const std::string &s) {
+    std::vector<uint32_t> out;
+    out.reserve(s.size());
+    size_t i = 0;
+    const size_t n = s.size();
+    while (i < n) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        uint32_t cp;
+        size_t adv;
+        if (c < 0x80) { cp = c; adv = 1; }
+        else if ((c & 0xE0) == 0xC0 && i + 1 < n) { cp = c & 0x1F; adv = 2; }
+        else if ((c & 0xF0) == 0xE0 && i + 2 < n) { cp = c & 0x0F; adv = 3; }
+        else if ((c & 0xF8) == 0xF0 && i + 3 < n) { cp = c & 0x07; adv = 4; }
+        else { cp = c; adv = 1; }
+        for (size_t k = 1; k < adv; ++k) cp = (cp << 6) | (static_cast<unsigned char>(s[i + k]) & 0x3F);
+        if (cp >= 'A' && cp <= 'Z') cp += 'a' - 'A';
+        out.push_back(cp);
+        i += adv;
+    }
+    return out;
+}
+
+uint64_t sigBit(uint32_t cp) {
+    return uint64_t(1) << ((cp * 0x9E3779B1u) >> 26);
+}
+
+// 名称按码点、首字母串按字节，统一取码点值
+uint32_t unit(uint32_t c) { return c; }
+uint32_t unit(char c) { return static_cast<unsigned char>(c); }
+
+template <typename Seq> uint64_t signature(const Seq &seq) {
+    uint64_t sig = 0;
+    for (auto c : seq) sig |= sigBit(unit(c));
+    return sig;
+}
+
+// 序列前 4 个单位各取低 16 位拼成 64 位；两者的这部分不同就一定不是前缀关系
+template <typename Seq> uint64_t packHead(const Seq &seq) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < seq.size() && i < 4; ++i) key |= uint64_t(unit(seq[i]) & 0xFFFF) << (16 * i);
+    return key;
+}
+
+// w 中置位数是否不超过 n（n 很小，逐个清掉最低位比通用 popcount 更快）
+bool atMostBits(uint64_t w, int n) {
+    for (int i = 0; i < n && w; ++i) w &= w - 1;
+    return w == 0;
+}
+
+// Myers（1999）位并行近似匹配：模式的第 i 个码点对应第 i 位，逐个读入文本码点更新整列差分，
+// 文本起点不计代价，返回模式与文本中任意一段的最小编辑距离
+class MyersPattern {
+public:
+    explicit MyersPattern(const std::vector<uint32_t> &pattern) : m(static_cast<int>(pattern.size())) {
+        for (int i = 0; i < m; ++i) {
+            size_t k = 0;
+            while (k < chars.size() && chars[k] != pattern[static_cast<size_t>(i)]) ++k;
+            if (k == chars.size()) { chars.push_back(pattern[static_cast<size_t>(i)]); masks.push_back(0); }
+            masks[k] |= uint64_t(1) << i;
+        }
+    }
+
+    template <typename It> int bestDistance(It begin, It end) const {
+        uint64_t pv = ~uint64_t(0), mv = 0;
+        const uint64_t high = uint64_t(1) << (m - 1);
+        int score = m, best = m;
+        for (It it = begin; it != end && best > 0; ++it) {
+            const uint64_t eq = peq(unit(*it));
+            const uint64_t xv = eq | mv;
+            const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            if (ph & high) ++score;
+            else if (mh & high) --score;
+            ph <<= 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+            if (score < best) best = score;
+        }
+        return best;
+    }
+
+private:
+    int m;
+    std::vector<uint32_t> chars; // 模式中的不同码点（一般只有几个，线性查找即可）
+    std::vector<uint64_t> masks;
+
+    uint64_t peq(uint32_t c) const {
+        for (size_t k = 0; k < chars.size(); ++k) if (chars[k] == c) return masks[k];
+        return 0;
+    }
+};
+
+template <typename Seq> bool startsWith(const Seq &text, const std::vector<uint32_t> &q) {
+    if (text.size() < q.size()) return false;
+    for (size_t i = 0; i < q.size(); ++i)
+        if (unit(text[i]) != q[i]) return false;
+    return true;
+}
+
+} // namespace
+
+int FuzzyNameIndex::maxDistance(size_t queryLength) {
+    if (queryLength <= 1) return 0;
+    if (queryLength <= 4) return 1;
+    if (queryLength <= 7) return 2;
+    return 3;
+}
+
+void FuzzyNameIndex::clear() {
+    entries.clear();
+    nameSig.clear();
+    initialSig.clear();
+    nameLength.clear();
+    nameHead.clear();
+    initialHead.clear();
+}
+
+void FuzzyNameIndex::set(uint32_t row, const std::string &name) {
+    if (row < entries.size() && entries[row].name == name) return;
+    if (entries.size() <= row) {
+        entries.resize(row + 1);
+        nameSig.resize(row + 1);
+        initialSig.resize(row + 1);
+        nameLength.resize(row + 1);
+        nameHead.resize(row + 1);
+        initialHead.resize(row + 1);
+    }
+    Entry &e = entries[row];
+    e.name = name;
+    e.codePoints = decodeLower(name);
+    e.initials.clear();
+    for (uint32_t cp : e.codePoints) {
+        char c = pinyinInitial(cp);
+        if (c) e.initials.push_back(c);
+        else if (cp >= 0x80) e.initials.push_back('?'); // 表外汉字占位，ASCII 符号（如 _）忽略
+    }
+    nameSig[row] = signature(e.codePoints);
+    initialSig[row] = signature(e.initials);
+    nameLength[row] = static_cast<uint32_t>(e.codePoints.size());
+    nameHead[row] = packHead(e.codePoints);
+    initialHead[row] = packHead(e.initials);
+}
+
+std::vector<FuzzyHit> FuzzyNameIndex::search(const std::string &query, size_t topN) const {
+    std::vector<uint32_t> q = decodeLower(query);
+    while (!q.empty() && q.back() == ' ') q.pop_back();
+    if (q.empty() || topN == 0) return {};
+    if (q.size() > 64) q.resize(64);
+    const int k = maxDistance(q.size());
+    const MyersPattern pattern(q);
+    bool pinyinQuery = true;
+    for (uint32_t c : q) if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))) { pinyinQuery = false; break; }
+    const uint64_t qsig = signature(q);
+    const uint64_t qhead = packHead(q);
+    const uint64_t headMask = q.size() >= 4 ? ~uint64_t(0) : (uint64_t(1) << (16 * q.size())) - 1;
+
+    // 排序键：距离、非前缀、名称长度、行号；用大顶堆保留最好的 topN 个
+    using Key = std::tuple<int, int, uint32_t, uint32_t, bool>;
+    std::priority_queue<Key> best;
+    for (uint32_t row = 0; row < entries.size(); ++row) {
+        int limit = k;
+        if (best.size() == topN) {
+            // 堆已满：距离不能更差。名称不比堆顶短的行（行号又更大）只能靠更小的距离，
+            // 或同距离下的前缀匹配挤进来；开头几个字符对不上的行不可能是前缀匹配，直接收紧允许距离
+            const Key &worst = best.top();
+            limit = std::get<0>(worst);
+            if (nameLength[row] >= std::get<2>(worst)) {
+                bool maybePrefix = std::get<1>(worst) != 0 && ((nameHead[row] & headMask) == qhead || (pinyinQuery && (initialHead[row] & headMask) == qhead));
+                if (maybePrefix) {
+                    const Entry &e = entries[row];
+                    maybePrefix = startsWith(e.codePoints, q) || (pinyinQuery && startsWith(e.initials, q));
+                }
+                if (!maybePrefix) --limit;
+            }
+            if (limit < 0) continue;
+        }
+        const bool nameCandidate = atMostBits(qsig & ~nameSig[row], limit);
+        const bool initialCandidate = pinyinQuery && atMostBits(qsig & ~initialSig[row], limit);
+        if (!nameCandidate && !initialCandidate) continue;
+        const Entry &e = entries[row];
+        int dist = limit + 1;
+        bool viaPinyin = false;
+        if (nameCandidate) dist = pattern.bestDistance(e.codePoints.begin(), e.codePoints.end());
+        if (initialCandidate && dist > 0) {
+            int d = pattern.bestDistance(e.initials.begin(), e.initials.end());
+            if (d < dist) { dist = d; viaPinyin = true; }
+        }
+        if (dist > limit) continue;
+        int notPrefix = viaPinyin ? !startsWith(e.initials, q) : !startsWith(e.codePoints, q);
+        Key key(dist, notPrefix, nameLength[row], row, viaPinyin);
+        if (best.size() < topN) best.push(key);
+        else if (key < best.top()) { best.pop(); best.push(key); }
+    }
+    std::vector<FuzzyHit> hits(best.size());
+    for (size_t i = hits.size(); i-- > 0; best.pop()) {
+        hits[i].row = std::get<3>(best.top());
+        hits[i].distance = std::get<0>(best.top());
+        hits[i].viaPinyin = std::get<4>(best.top());
+    }
+    return hits;
+}
@@ -0,0 +1,46 @@
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct FuzzyHit {
+    uint32_t row = 0;
+    int distance = 0;      // 编辑距离（关键字与名称中最接近的一段之间）
+    bool viaPinyin = false; // 由拼音首字母匹配得到
+};
+
+// 药品名称的容错检索索引，行号即药品在目录中的下标。
+// 距离按 Unicode 码点计算，采用 Myers 位并行算法（关键字作为模式，最多 64 个码点），
+// 名称中任意一段与关键字的编辑距离最小值作为得分，因此关键字可以只是名称的一部分。
+// 每行另存拼音首字母串（如 阿莫西林 -> amxl），纯字母数字的关键字同时与首字母串比较。
+// 每行预先计算 64 位字符签名：关键字中不在名称里出现的字符数超过允许距离的行直接跳过，
+// 大多数行只需一次与运算即可排除。
+class FuzzyNameIndex {
+public:
+    void clear();
+    // 写入或更新一行；row 等于当前行数时追加
+    void set(uint32_t row, const std::string &name);
+    size_t rows() const { return entries.size(); }
+    // 返回得分最好的至多 topN 行：先按距离，再优先前缀匹配，再按名称长度
+    std::vector<FuzzyHit> search(const std::string &query, size_t topN) const;
+    // 关键字长度对应的最大允许编辑距离
+    static int maxDistance(size_t queryLength);
+
+private:
+    struct Entry {
+        std::string name;
+        std::vector<uint32_t> codePoints; // ASCII 已转小写
+        std::string initials;             // 拼音首字母，无法识别的字符记为 '?'
+    };
+    std::vector<Entry> entries;
+    // 扫描时逐行要看的数据按列连续存放，只读本次查询用得到的列，绝大多数行不必访问 entries
+    std::vector<uint64_t> nameSig;
+    std::vector<uint64_t> initialSig;
+    std::vector<uint32_t> nameLength;  // 码点数
+    std::vector<uint64_t> nameHead;    // 前 4 个码点各取低 16 位拼成，用于快速排除非前缀
+    std::vector<uint64_t> initialHead; // 同上，取首字母串前 4 个字符
+};
+
+#endif // FUZZY_H
@@ -0,0 +1,276 @@
+#include "live_counters.h"
+#include <chrono>
+#include <cstring>
+#include <thread>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+size_t segmentBytes(size_t capacity) {
+    return sizeof(LiveHeader) + capacity * sizeof(LiveSlot);
+}
+
+// 复制名称，超长时退到 UTF-8 字符边界再截断
+void copyName(char *dst, const std::string &src) {
+    size_t n = src.size();
+    if (n > kLiveNameBytes - 1) {
+        n = kLiveNameBytes - 1;
+        while (n > 0 && (static_cast<unsigned char>(src[n]) & 0xC0) == 0x80) --n;
+    }
+    std::memcpy(dst, src.data(), n);
+    dst[n] = '\0';
+}
+
+bool sameName(const char *slotName, const std::string &name) {
+    return name.size() < kLiveNameBytes && std::strncmp(slotName, name.c_str(), kLiveNameBytes) == 0;
+}
+
+#ifndef _WIN32
+std::string errnoText(const char *what) {
+    return std::string(what) + "：" + std::strerror(errno);
+}
+#endif
+
+} // namespace
+
+LiveCounters::~LiveCounters() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool LiveCounters::open(const std::string &, size_t, std::string &error) {
+    error = "Windows 下不支持共享内存计数";
+    return false;
+}
+
+void LiveCounters::close() {}
+
+bool LiveCounters::mapCapacity(size_t) { return false; }
+
+#else
+
+bool LiveCounters::open(const std::string &segmentName, size_t capacity, std::string &error) {
+    close();
+    name = segmentName;
+    fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) { error = errnoText("shm_open 失败"); return false; }
+    // 同名段若仍有存活的写方则不接管，避免两个进程交替覆盖
+    struct stat st;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(LiveHeader)) {
+        // 接管旧段时不缩小对象，仍映射着旧段的读方不会越界
+        const size_t oldCapacity = (static_cast<size_t>(st.st_size) - sizeof(LiveHeader)) / sizeof(LiveSlot);
+        if (oldCapacity > capacity) capacity = oldCapacity;
+        void *p = mmap(nullptr, sizeof(LiveHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            const LiveHeader *old = static_cast<const LiveHeader *>(p);
+            const int64_t pid = old->magic == kLiveMagic ? old->writerPid : 0;
+            munmap(p, sizeof(LiveHeader));
+            if (pid > 0 && pid != static_cast<int64_t>(getpid()) && kill(static_cast<pid_t>(pid), 0) == 0) {
+                error = "进程 " + std::to_string(pid) + " 正在发布 " + name;
+                ::close(fd);
+                fd = -1;
+                return false;
+            }
+        }
+    }
+    if (!mapCapacity(capacity > 0 ? capacity : 1024)) {
+        error = errnoText("映射共享内存失败");
+        close();
+        return false;
+    }
+    WriteScope w(*this);
+    hdr->magic = kLiveMagic;
+    hdr->version = kLiveVersion;
+    hdr->count = 0;
+    hdr->writerPid = static_cast<int64_t>(getpid());
+    hdr->totals = LiveTotals();
+    return true;
+}
+
+void LiveCounters::close() {
+    if (base) munmap(base, mappedBytes);
+    if (fd >= 0) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+    }
+    base = nullptr;
+    hdr = nullptr;
+    slots = nullptr;
+    mappedBytes = 0;
+    fd = -1;
+    depth = 0;
+}
+
+// 扩大共享内存对象并重新映射；对象只增不减，读方旧映射在其长度内始终有效
+bool LiveCounters::mapCapacity(size_t capacity) {
+    const size_t bytes = segmentBytes(capacity);
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) return false;
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return false;
+    if (base) munmap(base, mappedBytes);
+    base = p;
+    mappedBytes = bytes;
+    hdr = static_cast<LiveHeader *>(base);
+    slots = reinterpret_cast<LiveSlot *>(static_cast<char *>(base) + sizeof(LiveHeader));
+    hdr->capacity = static_cast<uint32_t>(capacity);
+    return true;
+}
+
+#endif
+
+// seq 取奇数表示正在写；上次写方中途退出留下的奇数值同样可以直接沿用
+void LiveCounters::beginWrite() {
+    if (!hdr || depth++ > 0) return;
+    const uint64_t s = hdr->seq.load(std::memory_order_relaxed);
+    hdr->seq.store((s + 1) | 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void LiveCounters::endWrite() {
+    if (!hdr || --depth > 0) return;
+    hdr->totals.updatedAtMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    hdr->seq.store(hdr->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void LiveCounters::reset(size_t rows) {
+    if (!hdr) return;
+    WriteScope w(*this);
+    if (rows > hdr->capacity && !mapCapacity(rows + rows / 4 + 64)) return;
+    hdr->count = 0;
+    hdr->totals.totalStock = 0;
+    hdr->totals.totalSold = 0;
+}
+
+void LiveCounters::publish(uint32_t row, const std::string &drugName, int64_t stock, int64_t totalSold) {
+    if (!hdr) return;
+    WriteScope w(*this);
+    if (row >= hdr->capacity && !mapCapacity(static_cast<size_t>(row) * 2 + 64)) return;
+    // 新启用的槽位（含中间跳过的）按空槽计
+    while (hdr->count <= row) {
+        LiveSlot &s = slots[hdr->count++];
+        s.name[0] = '\0';
+        s.stock = 0;
+        s.totalSold = 0;
+    }
+    LiveSlot &s = slots[row];
+    hdr->totals.totalStock += stock - s.stock;
+    hdr->totals.totalSold += totalSold - s.totalSold;
+    s.stock = stock;
+    s.totalSold = totalSold;
+    if (!sameName(s.name, drugName)) copyName(s.name, drugName);
+}
+
+void LiveCounters::countEvent(LiveEvent event, int64_t qty) {
+    if (!hdr) return;
+    WriteScope w(*this);
+    LiveTotals &t = hdr->totals;
+    switch (event) {
+        case LiveEvent::Sale: t.saleCount++; t.saleQty += qty; break;
+        case LiveEvent::Return: t.returnCount++; t.returnQty += qty; break;
+        case LiveEvent::Wastage: t.wastageCount++; t.wastageQty += qty; break;
+    }
+}
+
+void LiveCounters::uncountEvent(LiveEvent event, int64_t qty) {
+    if (!hdr) return;
+    WriteScope w(*this);
+    LiveTotals &t = hdr->totals;
+    switch (event) {
+        case LiveEvent::Sale: t.saleCount--; t.saleQty -= qty; break;
+        case LiveEvent::Return: t.returnCount--; t.returnQty -= qty; break;
+        case LiveEvent::Wastage: t.wastageCount--; t.wastageQty -= qty; break;
+    }
+}
+
+LiveCountersReader::~LiveCountersReader() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool LiveCountersReader::open(const std::string &, std::string &error) {
+    error = "Windows 下不支持共享内存计数";
+    return false;
+}
+
+void LiveCountersReader::close() {}
+
+bool LiveCountersReader::remap(size_t) { return false; }
+
+#else
+
+bool LiveCountersReader::open(const std::string &segmentName, std::string &error) {
+    close();
+    name = segmentName;
+    fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) { error = errnoText(("无法打开 " + name).c_str()) + "（pharmacy_cli 是否在运行？）"; return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(LiveHeader) || !remap(static_cast<size_t>(st.st_size))) {
+        error = name + " 尚未初始化";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void LiveCountersReader::close() {
+    if (base) munmap(base, mappedBytes);
+    if (fd >= 0) ::close(fd);
+    base = nullptr;
+    mappedBytes = 0;
+    fd = -1;
+}
+
+bool LiveCountersReader::remap(size_t bytes) {
+    void *p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return false;
+    if (base) munmap(base, mappedBytes);
+    base = p;
+    mappedBytes = bytes;
+    return true;
+}
+
+#endif
+
+bool LiveCountersReader::snapshot(LiveSnapshot &out, std::string &error, int maxRetries) {
+    if (!base) { error = "未打开"; return false; }
+    out.retries = 0;
+    for (;;) {
+        const LiveHeader *hdr = static_cast<const LiveHeader *>(base);
+        const uint64_t s1 = hdr->seq.load(std::memory_order_acquire);
+        if (!(s1 & 1)) {
+            if (hdr->magic != kLiveMagic || hdr->version != kLiveVersion) { error = name + " 的格式不符"; return false; }
+            const uint32_t capacity = hdr->capacity;
+            const uint32_t count = hdr->count;
+            if (segmentBytes(capacity) > mappedBytes) {
+#ifndef _WIN32
+                // 写方扩容了：按对象当前长度重新映射后重读
+                struct stat st;
+                if (fstat(fd, &st) != 0 || !remap(static_cast<size_t>(st.st_size))) { error = "重新映射失败"; return false; }
+#endif
+                continue;
+            }
+            if (count <= capacity) {
+                out.capacity = capacity;
+                out.writerPid = hdr->writerPid;
+                std::memcpy(&out.totals, &hdr->totals, sizeof(LiveTotals));
+                out.slots.resize(count);
+                const LiveSlot *slots = reinterpret_cast<const LiveSlot *>(static_cast<const char *>(base) + sizeof(LiveHeader));
+                if (count > 0) std::memcpy(out.slots.data(), slots, count * sizeof(LiveSlot));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (hdr->seq.load(std::memory_order_relaxed) == s1) return true;
+            }
+        }
+        if (++out.retries > maxRetries) { error = "写入过于频繁，未能取得一致快照"; return false; }
+        if (out.retries % 16 == 0) std::this_thread::yield();
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef LIVE_COUNTERS_H
+#define LIVE_COUNTERS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 实时计数共享内存段（POSIX shm + mmap）：每个药品一个槽位（名称、库存、累计销量，槽位号与药品行号一致），
+// 外加全店总库存、总销量与各类交易的笔数/数量。外部看板以只读方式映射，不访问 SQLite。
+// 一致性用顺序锁（seqlock）：写方改数据前后各把 seq 加 1（改动期间为奇数），读方复制数据前后 seq 相同且为偶数
+// 即得到一致快照，否则重读。写方只做几次普通写与两次原子写，从不等待读方；多个写方之间由调用方串行
+// （Pharmacy 中为 drugsMutex）。Windows 下为空实现。
+const uint32_t kLiveMagic = 0x434C4850; // "PHLC"
+const uint32_t kLiveVersion = 1;
+const size_t kLiveNameBytes = 96;       // 含结尾 0，超长名称按 UTF-8 字符边界截断
+
+struct LiveTotals {
+    int64_t totalStock = 0;
+    int64_t totalSold = 0;
+    int64_t saleCount = 0;
+    int64_t saleQty = 0;
+    int64_t returnCount = 0;
+    int64_t returnQty = 0;
+    int64_t wastageCount = 0;
+    int64_t wastageQty = 0;
+    int64_t updatedAtMs = 0; // 最近一次写入的墙钟时间（毫秒）
+};
+
+struct LiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;   // 槽位数（段扩容时变大，读方据此重新映射）
+    uint32_t count;      // 已用槽位数
+    std::atomic<uint64_t> seq;
+    int64_t writerPid;
+    LiveTotals totals;
+};
+
+struct LiveSlot {
+    char name[kLiveNameBytes];
+    int64_t stock;
+    int64_t totalSold;
+};
+
+enum class LiveEvent { Sale, Return, Wastage };
+
+// 写方：由 pharmacy_cli 创建并独占写入，析构时删除共享内存段
+class LiveCounters {
+public:
+    static const char *defaultName() { return "/pharmacy_live"; }
+
+    LiveCounters() = default;
+    LiveCounters(const LiveCounters &) = delete;
+    LiveCounters &operator=(const LiveCounters &) = delete;
+    ~LiveCounters();
+
+    // 创建（或接管同名的旧段）并映射；失败时 error 给出原因，之后的更新均为空操作
+    bool open(const std::string &name, size_t capacity, std::string &error);
+    void close();
+    bool active() const { return hdr != nullptr; }
+
+    // 写区间：嵌套时只有最外层改动 seq，区间内的多处更新对读方表现为一次原子变化
+    class WriteScope {
+    public:
+        explicit WriteScope(LiveCounters &c) : c(c) { c.beginWrite(); }
+        ~WriteScope() { c.endWrite(); }
+        WriteScope(const WriteScope &) = delete;
+        WriteScope &operator=(const WriteScope &) = delete;
+    private:
+        LiveCounters &c;
+    };
+
+    // 清空槽位与库存/销量合计（交易笔数保留），并保证至少有 rows 个槽位
+    void reset(size_t rows);
+    // 写入第 row 个槽位，合计按新旧差值调整
+    void publish(uint32_t row, const std::string &name, int64_t stock, int64_t totalSold);
+    void countEvent(LiveEvent event, int64_t qty);
+    void uncountEvent(LiveEvent event, int64_t qty); // 撤销一次 countEvent（交易写库失败）
+
+private:
+    std::string name;
+    int fd = -1;
+    void *base = nullptr;
+    size_t mappedBytes = 0;
+    LiveHeader *hdr = nullptr;
+    LiveSlot *slots = nullptr;
+    int depth = 0;
+
+    bool mapCapacity(size_t capacity);
+    void beginWrite();
+    void endWrite();
+};
+
+struct LiveSnapshot {
+    uint32_t capacity = 0;
+    int64_t writerPid = 0;
+    LiveTotals totals;
+    std::vector<LiveSlot> slots;
+    int retries = 0; // 因写方并发改动而重读的次数
+};
+
+// 读方：只读映射，不加锁
+class LiveCountersReader {
+public:
+    LiveCountersReader() = default;
+    LiveCountersReader(const LiveCountersReader &) = delete;
+    LiveCountersReader &operator=(const LiveCountersReader &) = delete;
+    ~LiveCountersReader();
+
+    bool open(const std::string &name, std::string &error);
+    void close();
+    // 读取一致快照；段格式不符或写方持续改动超过 maxRetries 次时返回 false
+    bool snapshot(LiveSnapshot &out, std::string &error, int maxRetries = 1000);
+
+private:
+    std::string name;
+    int fd = -1;
+    void *base = nullptr;
+    size_t mappedBytes = 0;
+
+    bool remap(size_t bytes);
+};
+
+#endif // LIVE_COUNTERS_H
@@ -0,0 +1,120 @@
+// pharmacy_live：只读映射 pharmacy_cli 发布的实时计数共享内存段，输出全店合计与销量/库存排行。
+// 不访问 SQLite，也不与收银端争锁；每次读取为顺序锁保护下的一致快照。
+//
+// 用法：pharmacy_live [--name 段名] [--top K] [--drug 名称] [--watch 秒]
+#include "live_counters.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+
+namespace {
+
+struct ReaderConfig {
+    std::string name = LiveCounters::defaultName();
+    size_t top = 10;
+    std::string drug;
+    int watchSeconds = 0;
+};
+
+bool parseArgs(int argc, char **argv, ReaderConfig &cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&](std::string &out) { if (i + 1 >= argc) return false; out = argv[++i]; return true; };
+        std::string v;
+        try {
+            if (a == "--name" && next(v)) cfg.name = v;
+            else if (a == "--top" && next(v)) cfg.top = static_cast<size_t>(std::stoul(v));
+            else if (a == "--drug" && next(v)) cfg.drug = v;
+            else if (a == "--watch" && next(v)) cfg.watchSeconds = std::stoi(v);
+            else return false;
+        } catch (...) {
+            return false;
+        }
+    }
+    return cfg.watchSeconds >= 0;
+}
+
+std::string formatMs(int64_t ms) {
+    std::time_t t = static_cast<std::time_t>(ms / 1000);
+    std::tm tmv{};
+    localtime_r(&t, &tmv);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tmv);
+    return buf;
+}
+
+// 按 key 取前 k 个槽位（空槽跳过）
+template <typename Less>
+std::vector<const LiveSlot *> topSlots(const std::vector<LiveSlot> &slots, size_t k, Less less) {
+    std::vector<const LiveSlot *> list;
+    list.reserve(slots.size());
+    for (const auto &s : slots) if (s.name[0]) list.push_back(&s);
+    k = std::min(k, list.size());
+    std::partial_sort(list.begin(), list.begin() + static_cast<std::ptrdiff_t>(k), list.end(), less);
+    list.resize(k);
+    return list;
+}
+
+void print(const ReaderConfig &cfg, const LiveSnapshot &snap, const LiveSnapshot *prev, double elapsed) {
+    const LiveTotals &t = snap.totals;
+    std::cout << "\n=== 实时计数（" << cfg.name << "，写方进程 " << snap.writerPid << "，更新于 " << formatMs(t.updatedAtMs) << "）===\n";
+    std::cout << "药品种数：" << snap.slots.size() << "，总库存：" << t.totalStock << "，累计销量：" << t.totalSold << "\n";
+    std::cout << "发布以来：销售 " << t.saleCount << " 笔 / " << t.saleQty << " 件，退货 " << t.returnCount << " 笔 / " << t.returnQty
+              << " 件，报损 " << t.wastageCount << " 笔 / " << t.wastageQty << " 件\n";
+    if (prev && elapsed > 0) {
+        const int64_t tx = (t.saleCount + t.returnCount + t.wastageCount)
+                         - (prev->totals.saleCount + prev->totals.returnCount + prev->totals.wastageCount);
+        std::cout << "近 " << elapsed << " 秒：" << static_cast<double>(tx) / elapsed << " 笔/秒\n";
+    }
+    if (!cfg.drug.empty()) {
+        bool found = false;
+        for (const auto &s : snap.slots) {
+            if (cfg.drug != s.name) continue;
+            std::cout << s.name << "：库存 " << s.stock << "，累计销量 " << s.totalSold << "\n";
+            found = true;
+        }
+        if (!found) std::cout << "[查询] 未找到药品：" << cfg.drug << "\n";
+    } else if (cfg.top > 0) {
+        auto best = topSlots(snap.slots, cfg.top, [](const LiveSlot *a, const LiveSlot *b) { return a->totalSold > b->totalSold; });
+        std::cout << "--- 销量前 " << best.size() << " ---\n";
+        for (size_t i = 0; i < best.size(); ++i)
+            std::cout << (i + 1) << ". " << best[i]->name << " | 累计销量:" << best[i]->totalSold << " | 库存:" << best[i]->stock << "\n";
+        auto low = topSlots(snap.slots, cfg.top, [](const LiveSlot *a, const LiveSlot *b) { return a->stock < b->stock; });
+        std::cout << "--- 库存最低 " << low.size() << " ---\n";
+        for (size_t i = 0; i < low.size(); ++i)
+            std::cout << (i + 1) << ". " << low[i]->name << " | 库存:" << low[i]->stock << " | 累计销量:" << low[i]->totalSold << "\n";
+    }
+    if (snap.retries > 0) std::cout << "（写方并发更新，快照重读 " << snap.retries << " 次）\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ReaderConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::cerr << "用法：pharmacy_live [--name 段名] [--top K] [--drug 名称] [--watch 秒]\n";
+        return 2;
+    }
+    LiveCountersReader reader;
+    std::string error;
+    if (!reader.open(cfg.name, error)) { std::cerr << "[实时计数] " << error << "\n"; return 1; }
+    LiveSnapshot snap, prev;
+    bool havePrev = false;
+    auto last = std::chrono::steady_clock::now();
+    for (;;) {
+        if (!reader.snapshot(snap, error)) { std::cerr << "[实时计数] " << error << "\n"; return 1; }
+        auto now = std::chrono::steady_clock::now();
+        print(cfg, snap, havePrev ? &prev : nullptr, std::chrono::duration<double>(now - last).count());
+        if (cfg.watchSeconds == 0) return 0;
+        if (kill(static_cast<pid_t>(snap.writerPid), 0) != 0) { std::cout << "[实时计数] 写方已退出，数据不再更新。\n"; return 0; }
+        std::swap(prev, snap);
+        havePrev = true;
+        last = now;
+        std::this_thread::sleep_for(std::chrono::seconds(cfg.watchSeconds));
+    }
+}
@@ -0,0 +1,174 @@
+#include "lots.h"
+#include "drug.h"
+#include <algorithm>
+
+// 按状态放入堆或过期列表
+void LotBook::place(size_t idx, int today) {
+    Entry &e = entries[idx];
+    if (e.lot.quantity <= 0) { e.state = State::Empty; return; }
+    if (e.expiryDay < today) {
+        e.state = State::Expired;
+        expired.push_back(idx);
+        expiredQty += e.lot.quantity;
+    } else {
+        e.state = State::Active;
+        heap.emplace(e.expiryDay, idx);
+    }
+}
+
+void LotBook::addLot(const Lot &lot, int today) {
+    Entry e;
+    e.lot = lot;
+    if (!dateToDay(lot.expiryDate, e.expiryDay)) e.expiryDay = today - 1; // 到期日无法解析时按已过期处理，禁止销售
+    entries.push_back(e);
+    totalQty += lot.quantity > 0 ? lot.quantity : 0;
+    place(entries.size() - 1, today);
+}
+
+long long LotBook::mergeInto(const std::string &productionDate, int qty, int today, std::vector<LotDelta> &deltas) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry &e = entries[i];
+        if (e.lot.productionDate != productionDate) continue;
+        bool wasEmpty = e.state == State::Empty;
+        e.lot.quantity += qty;
+        totalQty += qty;
+        if (e.state == State::Expired) expiredQty += qty;
+        if (wasEmpty) place(i, today);
+        deltas.push_back(LotDelta{ e.lot.id, qty });
+        return e.lot.id;
+    }
+    return 0;
+}
+
+// 把已到期的堆顶移入过期列表，返回过期批次的总数量
+int LotBook::expiredQuantity(int today) {
+    while (!heap.empty()) {
+        size_t idx = heap.top().second;
+        Entry &e = entries[idx];
+        if (e.lot.quantity <= 0) { heap.pop(); e.state = State::Empty; continue; }
+        if (e.expiryDay >= today) break;
+        heap.pop();
+        e.state = State::Expired;
+        expired.push_back(idx);
+        expiredQty += e.lot.quantity;
+    }
+    return expiredQty;
+}
+
+int LotBook::take(size_t idx, int qty, std::vector<LotDelta> &deltas) {
+    Entry &e = entries[idx];
+    int n = qty < e.lot.quantity ? qty : e.lot.quantity;
+    if (n <= 0) return 0;
+    e.lot.quantity -= n;
+    totalQty -= n;
+    if (e.state == State::Expired) expiredQty -= n;
+    deltas.push_back(LotDelta{ e.lot.id, -n });
+    return n;
+}
+
+bool LotBook::allocate(int qty, int today, std::vector<LotDelta> &deltas) {
+    if (qty <= 0 || sellable(today) < qty) return false;
+    while (qty > 0 && !heap.empty()) {
+        size_t idx = heap.top().second;
+        qty -= take(idx, qty, deltas);
+        if (entries[idx].lot.quantity == 0) { heap.pop(); entries[idx].state = State::Empty; }
+    }
+    return qty == 0;
+}
+
+bool LotBook::writeOff(int qty, int today, std::vector<LotDelta> &deltas) {
+    if (qty <= 0 || totalQty < qty) return false;
+    expiredQuantity(today);
+    // 过期列表一般很短，按到期日先后扣减
+    std::sort(expired.begin(), expired.end(),
+              [this](size_t a, size_t b) { return entries[a].expiryDay < entries[b].expiryDay; });
+    size_t used = 0;
+    for (; used < expired.size() && qty > 0; ++used) {
+        size_t idx = expired[used];
+        qty -= take(idx, qty, deltas);
+        if (entries[idx].lot.quantity > 0) break;
+        entries[idx].state = State::Empty;
+    }
+    expired.erase(expired.begin(), expired.begin() + static_cast<long>(used));
+    return qty == 0 || allocate(qty, today, deltas);
+}
+
+int LotBook::writeOffExpired(int today, std::vector<LotDelta> &deltas) {
+    expiredQuantity(today);
+    int n = 0;
+    for (size_t idx : expired) {
+        n += take(idx, entries[idx].lot.quantity, deltas);
+        entries[idx].state = State::Empty;
+    }
+    expired.clear();
+    return n;
+}
+
+bool LotBook::restock(int qty, int today, std::vector<LotDelta> &deltas) {
+    if (qty <= 0) return false;
+    expiredQuantity(today);
+    if (heap.empty()) return false;
+    Entry &e = entries[heap.top().second];
+    e.lot.quantity += qty;
+    totalQty += qty;
+    deltas.push_back(LotDelta{ e.lot.id, qty });
+    return true;
+}
+
+void LotBook::revert(const std::vector<LotDelta> &deltas, int today) {
+    for (const auto &d : deltas) {
+        for (size_t i = 0; i < entries.size(); ++i) {
+            Entry &e = entries[i];
+            if (e.lot.id != d.lotId) continue;
+            e.lot.quantity -= d.delta;
+            totalQty -= d.delta;
+            // 扣空后已出堆的批次重新放回；仍在堆或过期列表中的批次只改数量（扣空的惰性出堆）
+            if (e.state == State::Empty) place(i, today);
+            else if (e.state == State::Expired) expiredQty -= d.delta;
+            break;
+        }
+    }
+}
+
+int LotBook::reExpire(int shelfLifeDays, int today, std::vector<Lot> &changed) {
+    int n = 0;
+    for (auto &e : entries) {
+        int prodDay;
+        if (e.lot.quantity <= 0 || !dateToDay(e.lot.productionDate, prodDay)) continue;
+        if (prodDay + shelfLifeDays == e.expiryDay) continue;
+        e.expiryDay = prodDay + shelfLifeDays;
+        e.lot.expiryDate = dayToDate(e.expiryDay);
+        changed.push_back(e.lot);
+        ++n;
+    }
+    if (n == 0) return 0;
+    heap = decltype(heap)();
+    expired.clear();
+    expiredQty = 0;
+    for (size_t i = 0; i < entries.size(); ++i) place(i, today);
+    return n;
+}
+
+bool LotBook::earliestExpiry(int &dayOut) const {
+    bool found = false;
+    for (const auto &e : entries) {
+        if (e.lot.quantity <= 0 || (found && e.expiryDay >= dayOut)) continue;
+        dayOut = e.expiryDay;
+        found = true;
+    }
+    return found;
+}
+
+std::vector<Lot> LotBook::activeLots() const {
+    std::vector<const Entry *> live;
+    for (const auto &e : entries) if (e.lot.quantity > 0) live.push_back(&e);
+    std::stable_sort(live.begin(), live.end(), [](const Entry *a, const Entry *b) { return a->expiryDay < b->expiryDay; });
+    std::vector<Lot> list;
+    list.reserve(live.size());
+    for (const Entry *e : live) list.push_back(e->lot);
+    return list;
+}
+
+void LotBook::rename(const std::string &name) {
+    for (auto &e : entries) e.lot.drugName = name;
+}
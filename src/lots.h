@@ -0,0 +1,63 @@
+#ifndef LOTS_H
+#define LOTS_H
+
+#include "database.h"
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 单个药品的批次账本：未过期批次放在按到期日排序的最小堆中，销售按先到期先出（FEFO）分配，
+// 每个被扣减的批次只需一次 O(log 批次数) 的堆操作。堆顶到期后移入过期列表（日期只会前进，过期不可逆），
+// 因此堆里始终是可销售批次；扣空的批次惰性出堆。调用方负责加锁。
+class LotBook {
+public:
+    // 加入批次（载入或入库），today 用于判定是否已过期
+    void addLot(const Lot &lot, int today);
+    // 同一生产日期的批次合并入库，返回批次 id；没有可合并的批次时返回 0，由调用方写库后 addLot
+    long long mergeInto(const std::string &productionDate, int qty, int today, std::vector<LotDelta> &deltas);
+
+    int total() const { return totalQty; }
+    int expiredQuantity(int today);
+    int sellable(int today) { return totalQty - expiredQuantity(today); }
+
+    // 销售：只从未过期批次按到期日先后扣减；可销售数量不足时不做修改并返回 false
+    bool allocate(int qty, int today, std::vector<LotDelta> &deltas);
+    // 报损（按数量）：先扣过期批次，再按 FEFO 扣未过期批次；总量不足时返回 false
+    bool writeOff(int qty, int today, std::vector<LotDelta> &deltas);
+    // 报损全部过期批次，返回报损数量
+    int writeOffExpired(int today, std::vector<LotDelta> &deltas);
+    // 退货：回补到最早到期的未过期批次；没有可用批次时返回 false
+    bool restock(int qty, int today, std::vector<LotDelta> &deltas);
+    // 撤销一组批次变化（写库失败时）：按批次 id 减去各自的增量，其间其他交易的变化不受影响
+    void revert(const std::vector<LotDelta> &deltas, int today);
+
+    // 保质期变化后按 生产日期 + shelfLifeDays 重算到期日，到期日变化的批次追加到 changed，返回其个数。
+    // 保质期可能变长，已过期批次也可能重新可售，因此有变化时按新到期日重排堆与过期列表
+    int reExpire(int shelfLifeDays, int today, std::vector<Lot> &changed);
+    // 数量 > 0 的批次中最早的到期日（含已过期批次）；没有库存时返回 false
+    bool earliestExpiry(int &dayOut) const;
+    // 数量 > 0 的批次（按到期日先后）
+    std::vector<Lot> activeLots() const;
+    void rename(const std::string &name);
+
+private:
+    enum class State { Active, Expired, Empty };
+    struct Entry {
+        Lot lot;
+        int expiryDay = 0;
+        State state = State::Empty;
+    };
+    using HeapItem = std::pair<int, size_t>; // (到期日序号, 下标)
+    std::vector<Entry> entries;
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap;
+    std::vector<size_t> expired;
+    int totalQty = 0;
+    int expiredQty = 0;
+
+    void place(size_t idx, int today);
+    int take(size_t idx, int qty, std::vector<LotDelta> &deltas);
+};
+
+#endif // LOTS_H
@@ -2,11 +2,17 @@
 #include "pharmacy.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
+#include <string>
 
-int main() {
+int main(int argc, char **argv) {
     system("chcp 65001>nul"); 
     std::string dataPath = "data/pharmacy.db";
     Pharmacy app(dataPath);
+    if (argc > 1) {
+        std::vector<std::string> args(argv + 1, argv + argc);
+        return app.runCommand(args);
+    }
     app.run();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "metrics.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// 最高有效位位置（v > 0），二分实现以兼容 MSVC/MinGW
+static int __msb64(uint64_t v) {
+    int r = 0;
+    if (v >> 32) { v >>= 32; r += 32; }
+    if (v >> 16) { v >>= 16; r += 16; }
+    if (v >> 8) { v >>= 8; r += 8; }
+    if (v >> 4) { v >>= 4; r += 4; }
+    if (v >> 2) { v >>= 2; r += 2; }
+    if (v >> 1) { r += 1; }
+    return r;
+}
+
+int LatencyHistogram::bucketOf(uint64_t ns) {
+    if (ns < static_cast<uint64_t>(kSubCount)) return static_cast<int>(ns);
+    int msb = __msb64(ns);
+    if (msb > kMaxExp) return kBuckets - 1;
+    int sub = static_cast<int>((ns >> (msb - kSubBits)) & (kSubCount - 1));
+    return (msb - kSubBits + 1) * kSubCount + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpper(int idx) {
+    if (idx < kSubCount) return static_cast<uint64_t>(idx);
+    int msb = idx / kSubCount + kSubBits - 1;
+    int sub = idx % kSubCount;
+    uint64_t width = 1ULL << (msb - kSubBits);
+    return (static_cast<uint64_t>(kSubCount + sub) << (msb - kSubBits)) + width - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sumNs.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t cur = minNs.load(std::memory_order_relaxed);
+    while (ns < cur && !minNs.compare_exchange_weak(cur, ns, std::memory_order_relaxed)) {}
+    cur = maxNs.load(std::memory_order_relaxed);
+    while (ns > cur && !maxNs.compare_exchange_weak(cur, ns, std::memory_order_relaxed)) {}
+}
+
+uint64_t LatencyHistogram::min() const {
+    uint64_t v = minNs.load(std::memory_order_relaxed);
+    return v == UINT64_MAX ? 0 : v;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    uint64_t n = count();
+    if (n == 0) return 0;
+    if (p < 0) p = 0;
+    if (p > 1) p = 1;
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(n) + 0.5);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t upper = bucketUpper(i);
+            uint64_t mx = max();
+            return upper < mx ? upper : mx;
+        }
+    }
+    return max();
+}
+
+Metrics &Metrics::instance() {
+    static Metrics m;
+    return m;
+}
+
+LatencyHistogram &Metrics::histogram(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto &slot = hists[name];
+    if (!slot) slot = std::make_unique<LatencyHistogram>();
+    return *slot;
+}
+
+// 纳秒转为易读字符串（自动选择 ns/us/ms/s）
+static std::string __fmt_ns(uint64_t ns) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1);
+    if (ns < 1000ULL) os << ns << "ns";
+    else if (ns < 1000000ULL) os << ns / 1e3 << "us";
+    else if (ns < 1000000000ULL) os << ns / 1e6 << "ms";
+    else os << ns / 1e9 << "s";
+    return os.str();
+}
+
+void Metrics::printTable(std::ostream &os) {
+    std::lock_guard<std::mutex> lock(mtx);
+    os << std::left << std::setw(32) << "指标" << std::right
+       << std::setw(10) << "次数" << std::setw(11) << "平均" << std::setw(11) << "p50"
+       << std::setw(11) << "p99" << std::setw(11) << "p999" << std::setw(11) << "最大" << "\n";
+    for (const auto &kv : hists) {
+        const LatencyHistogram &h = *kv.second;
+        uint64_t n = h.count();
+        if (n == 0) continue;
+        os << std::left << std::setw(30) << kv.first << std::right
+           << std::setw(10) << n
+           << std::setw(11) << __fmt_ns(h.sum() / n)
+           << std::setw(11) << __fmt_ns(h.percentile(0.50))
+           << std::setw(11) << __fmt_ns(h.percentile(0.99))
+           << std::setw(11) << __fmt_ns(h.percentile(0.999))
+           << std::setw(11) << __fmt_ns(h.max()) << "\n";
+    }
+}
+
+// JSON 字符串转义（名称可能包含 SQL 片段）
+static std::string __json_escape(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (c == '\n') out += "\\n";
+        else if (static_cast<unsigned char>(c) < 0x20) out += ' ';
+        else out += c;
+    }
+    return out;
+}
+
+void Metrics::writeJson(std::ostream &os) {
+    std::lock_guard<std::mutex> lock(mtx);
+    os << "{\n";
+    bool first = true;
+    for (const auto &kv : hists) {
+        const LatencyHistogram &h = *kv.second;
+        if (h.count() == 0) continue;
+        os << (first ? "" : ",\n") << "  \"" << __json_escape(kv.first) << "\": {"
+           << "\"count\": " << h.count() << ", \"sum_ns\": " << h.sum()
+           << ", \"min_ns\": " << h.min() << ", \"max_ns\": " << h.max()
+           << ", \"p50_ns\": " << h.percentile(0.50) << ", \"p90_ns\": " << h.percentile(0.90)
+           << ", \"p99_ns\": " << h.percentile(0.99) << ", \"p999_ns\": " << h.percentile(0.999) << "}";
+        first = false;
+    }
+    os << "\n}\n";
+}
+
+// Prometheus 文本格式：每个指标族输出为 summary（分位数 + _sum + _count），单位秒
+void Metrics::writePrometheus(std::ostream &os) {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::string lastFamily;
+    const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    os << std::setprecision(9);
+    for (const auto &kv : hists) {
+        const LatencyHistogram &h = *kv.second;
+        if (h.count() == 0) continue;
+        auto dot = kv.first.find('.');
+        std::string family = dot == std::string::npos ? std::string("misc") : kv.first.substr(0, dot);
+        std::string label = dot == std::string::npos ? kv.first : kv.first.substr(dot + 1);
+        std::string metric = "pharmacy_" + family + "_latency_seconds";
+        if (family != lastFamily) {
+            os << "# HELP " << metric << " Latency of pharmacy " << family << " calls.\n";
+            os << "# TYPE " << metric << " summary\n";
+            lastFamily = family;
+        }
+        std::string lbl = "name=\"" + __json_escape(label) + "\"";
+        for (double q : quantiles) {
+            os << metric << "{" << lbl << ",quantile=\"" << q << "\"} " << h.percentile(q) / 1e9 << "\n";
+        }
+        os << metric << "_sum{" << lbl << "} " << h.sum() / 1e9 << "\n";
+        os << metric << "_count{" << lbl << "} " << h.count() << "\n";
+    }
+}
+
+bool Metrics::dumpFiles(const std::string &basePath) {
+    std::ofstream js(basePath + ".json");
+    std::ofstream prom(basePath + ".prom");
+    if (!js || !prom) return false;
+    writeJson(js);
+    writePrometheus(prom);
+    return true;
+}
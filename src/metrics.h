@@ -0,0 +1,83 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+// 对数分桶延迟直方图（HDR 风格）：每个 2 的幂区间再均分 16 个子桶，相对误差 ≤ 1/16。
+// 记录只做几次 relaxed 原子加，可在生产环境常开。单位为纳秒。
+class LatencyHistogram {
+public:
+    static const int kSubBits = 4;
+    static const int kSubCount = 1 << kSubBits;
+    static const int kMaxExp = 47;   // 2^47 ns ≈ 39 小时，更大的值归入最后一个桶
+    static const int kBuckets = (kMaxExp - kSubBits + 1) * kSubCount + kSubCount;
+
+    void record(uint64_t ns);
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sumNs.load(std::memory_order_relaxed); }
+    uint64_t min() const;
+    uint64_t max() const { return maxNs.load(std::memory_order_relaxed); }
+    // p 取 0~1，返回所在桶的上界（纳秒）
+    uint64_t percentile(double p) const;
+
+    static int bucketOf(uint64_t ns);
+    static uint64_t bucketUpper(int idx);
+
+private:
+    std::atomic<uint64_t> buckets[kBuckets] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sumNs{0};
+    std::atomic<uint64_t> minNs{UINT64_MAX};
+    std::atomic<uint64_t> maxNs{0};
+};
+
+// 全局直方图注册表。名称形如 "op.loadDrugs"、"sql.drugs.insert"：
+// 点号前为指标族（op/sql/report），点号后为标签值。
+class Metrics {
+public:
+    static Metrics &instance();
+    // 返回的引用在进程生命周期内有效，调用方可缓存
+    LatencyHistogram &histogram(const std::string &name);
+
+    void printTable(std::ostream &os);
+    void writeJson(std::ostream &os);
+    void writePrometheus(std::ostream &os);
+    // 写出 <basePath>.json 与 <basePath>.prom
+    bool dumpFiles(const std::string &basePath);
+
+private:
+    std::mutex mtx;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> hists;
+};
+
+// RAII 计时：析构时把经过的单调时钟时间记入直方图
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram &h) : hist(h), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        hist.record(static_cast<uint64_t>(ns < 0 ? 0 : ns));
+    }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    LatencyHistogram &hist;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define METRICS_CONCAT_INNER(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_INNER(a, b)
+// 计时当前作用域；直方图查找只在首次执行时发生（函数内静态引用）
+#define METRICS_SCOPE(name) \
+    static LatencyHistogram &METRICS_CONCAT(__metrics_hist_, __LINE__) = Metrics::instance().histogram(name); \
+    ScopedTimer METRICS_CONCAT(__metrics_timer_, __LINE__)(METRICS_CONCAT(__metrics_hist_, __LINE__))
+
+#endif // METRICS_H
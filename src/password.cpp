@@ -0,0 +1,359 @@
+#include "password.h"
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// ---- SHA-256（FIPS 180-4） ----
+
+const uint32_t kK[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+inline uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+class Sha256 {
+public:
+    Sha256() {
+        static const uint32_t init[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                          0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+        std::memcpy(h, init, sizeof(h));
+    }
+
+    void update(const uint8_t *data, size_t len) {
+        total += len;
+        if (used > 0) {
+            size_t n = len < 64 - used ? len : 64 - used;
+            std::memcpy(buf + used, data, n);
+            used += n; data += n; len -= n;
+            if (used < 64) return;
+            block(buf);
+            used = 0;
+        }
+        for (; len >= 64; data += 64, len -= 64) block(data);
+        std::memcpy(buf, data, len);
+        used = len;
+    }
+
+    void finish(uint8_t out[32]) {
+        const uint64_t bits = total * 8;
+        const uint8_t pad = 0x80;
+        update(&pad, 1);
+        const uint8_t zero = 0;
+        while (used != 56) update(&zero, 1);
+        uint8_t lenBytes[8];
+        for (int i = 0; i < 8; ++i) lenBytes[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+        update(lenBytes, 8);
+        for (int i = 0; i < 8; ++i)
+            for (int b = 0; b < 4; ++b) out[i * 4 + b] = static_cast<uint8_t>(h[i] >> (24 - 8 * b));
+    }
+
+private:
+    uint32_t h[8];
+    uint8_t buf[64];
+    size_t used = 0;
+    uint64_t total = 0;
+
+    void block(const uint8_t *p) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i)
+            w[i] = (uint32_t(p[4 * i]) << 24) | (uint32_t(p[4 * i + 1]) << 16) | (uint32_t(p[4 * i + 2]) << 8) | p[4 * i + 3];
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + kK[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            hh = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+    }
+};
+
+// HMAC 的内外两层状态只依赖密钥，PBKDF2 每个输出块复用同一份
+class Hmac {
+public:
+    Hmac(const uint8_t *key, size_t keyLen) {
+        uint8_t k[64] = {0};
+        if (keyLen > 64) sha256(key, keyLen, k);
+        else std::memcpy(k, key, keyLen);
+        uint8_t pad[64];
+        for (int i = 0; i < 64; ++i) pad[i] = k[i] ^ 0x36;
+        inner.update(pad, 64);
+        for (int i = 0; i < 64; ++i) pad[i] = k[i] ^ 0x5c;
+        outer.update(pad, 64);
+    }
+    void mac(const uint8_t *a, size_t aLen, const uint8_t *b, size_t bLen, uint8_t out[32]) const {
+        Sha256 in = inner;
+        in.update(a, aLen);
+        if (bLen) in.update(b, bLen);
+        uint8_t digest[32];
+        in.finish(digest);
+        Sha256 out2 = outer;
+        out2.update(digest, 32);
+        out2.finish(out);
+    }
+
+private:
+    Sha256 inner, outer;
+};
+
+// ---- scrypt ----
+
+void salsa208(uint32_t b[16]) {
+    uint32_t x[16];
+    std::memcpy(x, b, sizeof(x));
+    for (int i = 0; i < 8; i += 2) {
+        x[4] ^= rotl(x[0] + x[12], 7);   x[8] ^= rotl(x[4] + x[0], 9);
+        x[12] ^= rotl(x[8] + x[4], 13);  x[0] ^= rotl(x[12] + x[8], 18);
+        x[9] ^= rotl(x[5] + x[1], 7);    x[13] ^= rotl(x[9] + x[5], 9);
+        x[1] ^= rotl(x[13] + x[9], 13);  x[5] ^= rotl(x[1] + x[13], 18);
+        x[14] ^= rotl(x[10] + x[6], 7);  x[2] ^= rotl(x[14] + x[10], 9);
+        x[6] ^= rotl(x[2] + x[14], 13);  x[10] ^= rotl(x[6] + x[2], 18);
+        x[3] ^= rotl(x[15] + x[11], 7);  x[7] ^= rotl(x[3] + x[15], 9);
+        x[11] ^= rotl(x[7] + x[3], 13);  x[15] ^= rotl(x[11] + x[7], 18);
+        x[1] ^= rotl(x[0] + x[3], 7);    x[2] ^= rotl(x[1] + x[0], 9);
+        x[3] ^= rotl(x[2] + x[1], 13);   x[0] ^= rotl(x[3] + x[2], 18);
+        x[6] ^= rotl(x[5] + x[4], 7);    x[7] ^= rotl(x[6] + x[5], 9);
+        x[4] ^= rotl(x[7] + x[6], 13);   x[5] ^= rotl(x[4] + x[7], 18);
+        x[11] ^= rotl(x[10] + x[9], 7);  x[8] ^= rotl(x[11] + x[10], 9);
+        x[9] ^= rotl(x[8] + x[11], 13);  x[10] ^= rotl(x[9] + x[8], 18);
+        x[12] ^= rotl(x[15] + x[14], 7); x[13] ^= rotl(x[12] + x[15], 9);
+        x[14] ^= rotl(x[13] + x[12], 13); x[15] ^= rotl(x[14] + x[13], 18);
+    }
+    for (int i = 0; i < 16; ++i) b[i] += x[i];
+}
+
+// BlockMix：in 为 2r 个 64 字节块（按 32 位字），结果按“偶数块在前、奇数块在后”写入 out
+void blockMix(const uint32_t *in, uint32_t *out, int r) {
+    uint32_t x[16];
+    std::memcpy(x, in + (2 * r - 1) * 16, sizeof(x));
+    for (int i = 0; i < 2 * r; ++i) {
+        for (int k = 0; k < 16; ++k) x[k] ^= in[i * 16 + k];
+        salsa208(x);
+        std::memcpy(out + ((i & 1) * r + i / 2) * 16, x, sizeof(x));
+    }
+}
+
+void roMix(uint8_t *block, int r, uint64_t n, std::vector<uint32_t> &v) {
+    const size_t words = static_cast<size_t>(32 * r);
+    std::vector<uint32_t> x(words), y(words);
+    for (size_t k = 0; k < words; ++k)
+        x[k] = uint32_t(block[4 * k]) | (uint32_t(block[4 * k + 1]) << 8) | (uint32_t(block[4 * k + 2]) << 16) | (uint32_t(block[4 * k + 3]) << 24);
+    for (uint64_t i = 0; i < n; ++i) {
+        std::memcpy(&v[i * words], x.data(), words * 4);
+        blockMix(x.data(), y.data(), r);
+        x.swap(y);
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+        const uint64_t j = x[(2 * r - 1) * 16] & (n - 1); // Integerify：最后一块的首个字（N 为 2 的幂）
+        const uint32_t *vj = &v[j * words];
+        for (size_t k = 0; k < words; ++k) x[k] ^= vj[k];
+        blockMix(x.data(), y.data(), r);
+        x.swap(y);
+    }
+    for (size_t k = 0; k < words; ++k)
+        for (int b = 0; b < 4; ++b) block[4 * k + b] = static_cast<uint8_t>(x[k] >> (8 * b));
+}
+
+const char *kHex = "0123456789abcdef";
+
+std::string toHex(const uint8_t *p, size_t n) {
+    std::string s(n * 2, '0');
+    for (size_t i = 0; i < n; ++i) { s[2 * i] = kHex[p[i] >> 4]; s[2 * i + 1] = kHex[p[i] & 15]; }
+    return s;
+}
+
+bool fromHex(const std::string &s, std::vector<uint8_t> &out) {
+    if (s.size() % 2) return false;
+    out.resize(s.size() / 2);
+    for (size_t i = 0; i < out.size(); ++i) {
+        int v = 0;
+        for (int k = 0; k < 2; ++k) {
+            char c = s[2 * i + k];
+            int d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+            if (d < 0) return false;
+            v = v * 16 + d;
+        }
+        out[i] = static_cast<uint8_t>(v);
+    }
+    return true;
+}
+
+bool constantTimeEqual(const uint8_t *a, const uint8_t *b, size_t n) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < n; ++i) diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+// r、p 先各自按预算封顶，乘积不会溢出
+bool withinBudget(const ScryptParams &params) {
+    if (params.log2N < 1 || params.log2N > kScryptMaxLog2N || params.r < 1 || params.p < 1) return false;
+    const uint64_t cap = kScryptMaxBytes / 128;
+    if (static_cast<uint64_t>(params.r) > cap || static_cast<uint64_t>(params.p) > cap) return false;
+    const uint64_t memory = (uint64_t(128) * static_cast<uint64_t>(params.r)) << params.log2N;
+    return memory <= kScryptMaxBytes && memory * static_cast<uint64_t>(params.p) <= kScryptMaxBytes;
+}
+
+bool splitHash(const std::string &stored, ScryptParams &params, std::vector<uint8_t> &salt, std::vector<uint8_t> &hash) {
+    if (!isPasswordHash(stored)) return false;
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (true) {
+        size_t pos = stored.find('$', start);
+        parts.push_back(stored.substr(start, pos == std::string::npos ? std::string::npos : pos - start));
+        if (pos == std::string::npos) break;
+        start = pos + 1;
+    }
+    if (parts.size() != 6) return false;
+    try {
+        params.log2N = std::stoi(parts[1]);
+        params.r = std::stoi(parts[2]);
+        params.p = std::stoi(parts[3]);
+    } catch (...) {
+        return false;
+    }
+    if (!withinBudget(params)) return false;
+    return fromHex(parts[4], salt) && fromHex(parts[5], hash) && !hash.empty();
+}
+
+} // namespace
+
+void sha256(const uint8_t *data, size_t len, uint8_t out[32]) {
+    Sha256 s;
+    s.update(data, len);
+    s.finish(out);
+}
+
+void hmacSha256(const uint8_t *key, size_t keyLen, const uint8_t *data, size_t len, uint8_t out[32]) {
+    Hmac(key, keyLen).mac(data, len, nullptr, 0, out);
+}
+
+void pbkdf2Sha256(const uint8_t *password, size_t passwordLen, const uint8_t *salt, size_t saltLen,
+                  uint32_t iterations, uint8_t *out, size_t outLen) {
+    const Hmac prf(password, passwordLen);
+    for (uint32_t blockNo = 1; outLen > 0; ++blockNo) {
+        const uint8_t counter[4] = { uint8_t(blockNo >> 24), uint8_t(blockNo >> 16), uint8_t(blockNo >> 8), uint8_t(blockNo) };
+        uint8_t u[32], t[32];
+        prf.mac(salt, saltLen, counter, 4, u);
+        std::memcpy(t, u, 32);
+        for (uint32_t it = 1; it < iterations; ++it) {
+            prf.mac(u, 32, nullptr, 0, u);
+            for (int k = 0; k < 32; ++k) t[k] ^= u[k];
+        }
+        size_t n = outLen < 32 ? outLen : 32;
+        std::memcpy(out, t, n);
+        out += n;
+        outLen -= n;
+    }
+}
+
+bool scrypt(const uint8_t *password, size_t passwordLen, const uint8_t *salt, size_t saltLen,
+            const ScryptParams &params, uint8_t *out, size_t outLen) {
+    if (!withinBudget(params)) return false;
+    const uint64_t n = uint64_t(1) << params.log2N;
+    const size_t blockBytes = static_cast<size_t>(128 * params.r);
+    std::vector<uint8_t> b(blockBytes * static_cast<size_t>(params.p));
+    pbkdf2Sha256(password, passwordLen, salt, saltLen, 1, b.data(), b.size());
+    std::vector<uint32_t> v(static_cast<size_t>(n) * blockBytes / 4);
+    for (int i = 0; i < params.p; ++i) roMix(&b[static_cast<size_t>(i) * blockBytes], params.r, n, v);
+    pbkdf2Sha256(password, passwordLen, b.data(), b.size(), 1, out, outLen);
+    return true;
+}
+
+bool isPasswordHash(const std::string &stored) {
+    return stored.compare(0, 7, "scrypt$") == 0;
+}
+
+bool passwordHashParams(const std::string &stored, ScryptParams &out) {
+    std::vector<uint8_t> salt, hash;
+    return splitHash(stored, out, salt, hash);
+}
+
+std::string hashPassword(const std::string &password, const ScryptParams &params) {
+    uint8_t salt[16];
+    std::random_device rd;
+    for (size_t i = 0; i < sizeof(salt); i += 4) {
+        uint32_t w = rd();
+        for (int k = 0; k < 4; ++k) salt[i + k] = static_cast<uint8_t>(w >> (8 * k));
+    }
+    uint8_t dk[32];
+    if (!scrypt(reinterpret_cast<const uint8_t *>(password.data()), password.size(), salt, sizeof(salt), params, dk, sizeof(dk)))
+        return std::string();
+    return "scrypt$" + std::to_string(params.log2N) + "$" + std::to_string(params.r) + "$" + std::to_string(params.p) + "$"
+         + toHex(salt, sizeof(salt)) + "$" + toHex(dk, sizeof(dk));
+}
+
+bool verifyPassword(const std::string &password, const std::string &stored) {
+    if (!isPasswordHash(stored)) {
+        // 旧版明文：先比长度无妨（长度不是秘密的主要部分），内容常量时间比较
+        return password.size() == stored.size()
+            && constantTimeEqual(reinterpret_cast<const uint8_t *>(password.data()), reinterpret_cast<const uint8_t *>(stored.data()), stored.size());
+    }
+    ScryptParams params;
+    std::vector<uint8_t> salt, expected;
+    if (!splitHash(stored, params, salt, expected)) return false;
+    std::vector<uint8_t> dk(expected.size());
+    if (!scrypt(reinterpret_cast<const uint8_t *>(password.data()), password.size(), salt.data(), salt.size(), params, dk.data(), dk.size()))
+        return false;
+    return constantTimeEqual(dk.data(), expected.data(), dk.size());
+}
+
+AuthCache::AuthCache(std::chrono::seconds ttlSeconds) : ttl(ttlSeconds) {
+    std::random_device rd;
+    for (size_t i = 0; i < key.size(); i += 4) {
+        uint32_t w = rd();
+        for (int k = 0; k < 4; ++k) key[i + k] = static_cast<uint8_t>(w >> (8 * k));
+    }
+}
+
+AuthCache::Tag AuthCache::tagOf(const std::string &username, const std::string &password) const {
+    std::string msg = username;
+    msg.push_back('\0');
+    msg += password;
+    Tag t;
+    hmacSha256(key.data(), key.size(), reinterpret_cast<const uint8_t *>(msg.data()), msg.size(), t.data());
+    return t;
+}
+
+bool AuthCache::check(const std::string &username, const std::string &stored, const std::string &password) {
+    const Tag t = tagOf(username, password);
+    std::lock_guard<std::mutex> lock(mu);
+    auto it = entries.find(username);
+    bool ok = it != entries.end() && it->second.stored == stored && std::chrono::steady_clock::now() < it->second.expires
+           && constantTimeEqual(it->second.tag.data(), t.data(), t.size());
+    if (!ok && it != entries.end() && it->second.stored != stored) entries.erase(it); // 已改密，旧条目作废
+    (ok ? hitCount : missCount)++;
+    return ok;
+}
+
+void AuthCache::remember(const std::string &username, const std::string &stored, const std::string &password) {
+    Entry e;
+    e.stored = stored;
+    e.tag = tagOf(username, password);
+    e.expires = std::chrono::steady_clock::now() + ttl;
+    std::lock_guard<std::mutex> lock(mu);
+    entries[username] = e;
+}
+
+void AuthCache::forget(const std::string &username) {
+    std::lock_guard<std::mutex> lock(mu);
+    entries.erase(username);
+}
+
+void AuthCache::clear() {
+    std::lock_guard<std::mutex> lock(mu);
+    entries.clear();
+}
@@ -0,0 +1,73 @@
+#ifndef PASSWORD_H
+#define PASSWORD_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 口令哈希：scrypt（RFC 7914），SHA-256 / HMAC / PBKDF2 均为自带实现，不依赖外部库。
+// 存储格式：scrypt$<log2N>$<r>$<p>$<盐 hex>$<派生值 hex>
+// scrypt 每次计算需要 128·r·N 字节内存（默认 N=2^14、r=8 即 16 MB），使暴力破解无法靠大规模并行摊薄成本。
+struct ScryptParams {
+    int log2N = 14;
+    int r = 8;
+    int p = 1;
+};
+
+const int kScryptMinLog2N = 10;
+const int kScryptMaxLog2N = 18; // 2^18 × 1 KB = 256 MB
+// 单次计算的上限：内存 128·r·N 与计算量 128·r·N·p 均不超过默认 r=8、p=1 时最大强度的 256 MB，
+// 库中哈希串的参数超出时按校验失败处理（防止篡改参数拖垮进程）
+const uint64_t kScryptMaxBytes = uint64_t(128) * 8 << kScryptMaxLog2N;
+
+void sha256(const uint8_t *data, size_t len, uint8_t out[32]);
+void hmacSha256(const uint8_t *key, size_t keyLen, const uint8_t *data, size_t len, uint8_t out[32]);
+void pbkdf2Sha256(const uint8_t *password, size_t passwordLen, const uint8_t *salt, size_t saltLen,
+                  uint32_t iterations, uint8_t *out, size_t outLen);
+bool scrypt(const uint8_t *password, size_t passwordLen, const uint8_t *salt, size_t saltLen,
+            const ScryptParams &params, uint8_t *out, size_t outLen);
+
+// 生成随机盐并计算存储串
+std::string hashPassword(const std::string &password, const ScryptParams &params);
+// 是否为本模块生成的哈希串（否则视为旧版明文）
+bool isPasswordHash(const std::string &stored);
+bool passwordHashParams(const std::string &stored, ScryptParams &out);
+// 校验口令；stored 为旧版明文时按明文比较（常量时间）
+bool verifyPassword(const std::string &password, const std::string &stored);
+
+// 进程内已验证会话缓存：首次校验通过后记下 HMAC(进程随机密钥, 用户名 + 口令)，
+// 之后同一用户的认证只需一次 HMAC 比对，不再重付 scrypt 的代价。条目与库中的哈希串绑定，
+// 改密（哈希串变化）后旧条目自然失效；条目在 ttl 后过期。可被多个线程并发调用。
+class AuthCache {
+public:
+    explicit AuthCache(std::chrono::seconds ttl = std::chrono::seconds(600));
+    bool check(const std::string &username, const std::string &stored, const std::string &password);
+    void remember(const std::string &username, const std::string &stored, const std::string &password);
+    void forget(const std::string &username);
+    void clear();
+    long long hits() const { return hitCount.load(); }
+    long long misses() const { return missCount.load(); }
+
+private:
+    using Tag = std::array<uint8_t, 32>;
+    struct Entry {
+        std::string stored;
+        Tag tag{};
+        std::chrono::steady_clock::time_point expires;
+    };
+    std::chrono::seconds ttl;
+    std::array<uint8_t, 32> key{};
+    std::mutex mu;
+    std::unordered_map<std::string, Entry> entries;
+    std::atomic<long long> hitCount{0};
+    std::atomic<long long> missCount{0};
+
+    Tag tagOf(const std::string &username, const std::string &password) const;
+};
+
+#endif // PASSWORD_H
@@ -1,4 +1,6 @@
 #include "pharmacy.h"
+#include "metrics.h"
+#include "federation.h"
 #include <iostream>
 #include <fstream>
 #include <iomanip>
@@ -6,6 +8,13 @@
 #include <map>
 // #include <algorithm> // 由于MSVC头文件冲突，改用自实现Top5逻辑避免依赖
 #include <ctime>
+#include <cmath>
+#include <chrono>
+#include <sstream>
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+#include <filesystem>
 #ifdef _WIN32
 #include <conio.h>
 #else
@@ -55,27 +64,445 @@ static std::string __pad_left_display(const std::string &s, int width) {
     int w = __utf8_display_width(s); int pad = width - w; if (pad <= 0) return s; return std::string(pad, ' ') + s;
 }
 
+// 按 strftime 格式输出当前本地时间
+static std::string __format_now(const char *fmt) {
+    std::time_t now = std::time(nullptr);
+    std::tm tmNow{};
+#ifdef _WIN32
+    localtime_s(&tmNow, &now);
+#else
+    localtime_r(&now, &tmNow);
+#endif
+    char buf[32];
+    std::strftime(buf, sizeof(buf), fmt, &tmNow);
+    return std::string(buf);
+}
+
 Pharmacy::Pharmacy(const std::string &dataFile)
     : dataFilePath(dataFile) {
     dataDir = __dir_from_path(dataFilePath);
     if (dataDir.empty() || dataDir == ".") dataDir = "data";
     std::string dbPath = dataDir + "/pharmacy.db";
-    db = std::make_unique<SqliteDatabase>(dbPath);
+    configPath = __dir_from_path(dataDir) + "/config.txt";
+    auto sqlite = std::make_unique<SqliteDatabase>(dbPath);
+    sqliteDb = sqlite.get();
+    db = std::move(sqlite);
+}
+
+Pharmacy::~Pharmacy() {
+    stopScheduledBackup();
+    {
+        std::lock_guard<std::mutex> lock(drugsMutex);
+        flushDemand();
+    }
+    // 退出时导出各操作延迟直方图，供外部采集（JSON 与 Prometheus 文本两种格式）
+    Metrics::instance().dumpFiles(dataDir + "/metrics");
 }
 
 void Pharmacy::run() {
     if (!db->init()) { std::cout << "[错误] SQLite 初始化失败。\n"; return; }
+    preloadConfig();
+    migratePasswords();
     if (!login()) { std::cout << "[登录] 失败，程序退出。\n"; return; }
+    alertsEnabled = true;
     loadData();
+    // 环境变量 PHARMACY_LIVE 可指定共享内存段名，设为 off 则不发布
+    const char *liveName = std::getenv("PHARMACY_LIVE");
+    if (!liveName || std::string(liveName) != "off") {
+        std::string error;
+        if (!publishLiveCounters(liveName && *liveName ? liveName : LiveCounters::defaultName(), error))
+            std::cout << "[实时计数] 未发布：" << error << "\n";
+    }
     menuLoop();
 }
 
 void Pharmacy::loadData() {
+    archiveLoaded = false;
+    if (alertsEnabled) beginAlerts();
     drugs = db->loadDrugs();
+    loadConfig();
+    if (alertsEnabled) finishAlerts();
+    loadDemand();
+    warmTrending();
     std::cout << "[数据] 载入药品记录数：" << drugs.size() << "\n";
 }
 
+// 读取配置并载入批次。库中记录了上次生效的保质期配置（app_meta.shelf_config），
+// 与本次读到的比较后只重算差异涉及的药品；没有记录（首次启用配置）时全部核对一遍
+void Pharmacy::loadConfig() {
+    ConfigChange change;
+    std::vector<std::string> warnings;
+    std::string applied;
+    const bool known = sqliteDb->loadMeta("shelf_config", applied);
+    if (known) config.parse(applied, change, warnings);
+    change = ConfigChange(); // 文件读取失败时沿用记录的配置，没有差异
+    warnings.clear();
+    if (!config.loadFile(configPath, change, warnings)) std::cout << "[配置] 未找到 " << configPath << "，沿用" << (known ? "上次的" : "默认") << "配置。\n";
+    for (const auto &w : warnings) std::cout << "[配置] " << w << "\n";
+    alerts.setLowStockThreshold(config.lowStockThreshold());
+    loadLotBooks();
+    int changedDrugs = 0;
+    int changedLots = applyShelfLifeChange(change, !known, changedDrugs);
+    if (changedLots > 0) std::cout << "[配置] 保质期配置已变化，" << changedDrugs << " 种药品的 " << changedLots << " 个批次到期日已更新。\n";
+    if (!known || change.any()) sqliteDb->saveMeta("shelf_config", config.canonical());
+    configWatcher.start(configPath);
+}
+
+// 只读命令（filter/search/reorder）的配置载入：不迁移批次、不改写到期日与 shelf_config，也不监视配置文件。
+// 配置与上次应用的不同时只在内存中按当前配置重算到期日
+void Pharmacy::loadConfigReadOnly() {
+    preloadConfig();
+    loadLotBooks(false);
+    std::string applied;
+    if (sqliteDb->loadMeta("shelf_config", applied) && applied == config.canonical()) return;
+    const int today = todayDay();
+    std::vector<Lot> changed;
+    for (auto &d : drugs) reExpireDrug(d, today, changed);
+}
+
+// 菜单每轮调用：配置文件有变化时重新载入，只重算受影响药品
+void Pharmacy::checkConfigReload() {
+    if (!configWatcher.changed()) return;
+    auto t0 = std::chrono::steady_clock::now();
+    ConfigChange change;
+    std::vector<std::string> warnings;
+    std::lock_guard<std::mutex> lock(drugsMutex);
+    if (!config.loadFile(configPath, change, warnings)) { std::cout << "[配置] 无法读取 " << configPath << "，沿用当前配置。\n"; return; }
+    for (const auto &w : warnings) std::cout << "[配置] " << w << "\n";
+    if (!change.any()) return;
+    int changedDrugs = 0;
+    int changedLots = applyShelfLifeChange(change, false, changedDrugs);
+    alerts.setLowStockThreshold(config.lowStockThreshold());
+    if (change.nearExpiryThreshold) {
+        // 默认临期阈值只影响未自设阈值的药品，逐个更新其预警定时器
+        LiveCounters::WriteScope live(liveCounters);
+        for (const auto &d : drugs) if (d.nearExpiryThresholdDays <= 0) indexDrug(d);
+    }
+    sqliteDb->saveMeta("shelf_config", config.canonical());
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[配置] 已重新载入 " << configPath << "：默认保质期 " << config.defaultShelfLifeDays()
+              << " 天，默认临期阈值 " << config.nearExpiryThresholdDays() << " 天，低库存阈值 " << config.lowStockThreshold() << " 件；"
+              << changedDrugs << " 种药品的 " << changedLots << " 个批次到期日已更新（" << std::fixed << std::setprecision(1) << ms << " ms）。\n" << std::defaultfloat;
+}
+
+// 按当前配置重算一种药品的批次到期日，有变化时同步补货堆与组合查询索引。调用方持有 drugsMutex 或处于单线程菜单
+bool Pharmacy::reExpireDrug(Drug &d, int today, std::vector<Lot> &changed) {
+    auto it = lotBooks.find(d.name);
+    if (it != lotBooks.end() && it->second.reExpire(config.shelfLifeFor(d), today, changed) == 0) return false;
+    // 没有批次的药品按 生产日期 + 保质期 参与到期条件，同样重新索引
+    if (it != lotBooks.end()) noteDemand(d.name, 0);
+    indexDrug(d);
+    return it != lotBooks.end();
+}
+
+// 按配置差异重算批次到期日并写库：分类保质期变化的分类经位图索引直接取行；默认保质期变化时
+// 只涉及未配置分类、自身也未设保质期的药品；all 为 true 时核对全部药品。返回到期日有变化的批次数
+int Pharmacy::applyShelfLifeChange(const ConfigChange &change, bool all, int &drugsChanged) {
+    METRICS_SCOPE("op.applyShelfLifeChange");
+    drugsChanged = 0;
+    RoaringBitmap rows;
+    if (all) {
+        rows = RoaringBitmap::range(0, static_cast<uint32_t>(drugs.size()));
+    } else {
+        std::vector<const RoaringBitmap *> parts;
+        for (uint32_t id : change.categories)
+            if (const RoaringBitmap *b = filterIndex.categoryRows(config.categoryName(id))) parts.push_back(b);
+        rows = RoaringBitmap::unionAll(parts);
+        if (change.defaultShelfLife) {
+            for (size_t i = 0; i < drugs.size(); ++i)
+                if (drugs[i].shelfLifeDays <= 0 && config.categoryShelfLife(drugs[i].category) == 0) rows.add(static_cast<uint32_t>(i));
+        }
+    }
+    const int today = todayDay();
+    std::vector<Lot> changed;
+    rows.forEach([&](uint32_t row) {
+        if (row < drugs.size() && reExpireDrug(drugs[row], today, changed)) ++drugsChanged;
+    });
+    if (!changed.empty() && !sqliteDb->updateLotExpiry(changed)) std::cout << "[配置] 批次到期日写库失败。\n";
+    return static_cast<int>(changed.size());
+}
+
+// 用近一周的销售流水重建热销窗口（按时间戳索引分页读取，不扫全表）
+void Pharmacy::warmTrending() {
+    trending.clear();
+    std::unordered_map<std::string, std::string> categoryOf;
+    for (const auto &d : drugs) categoryOf[d.name] = d.category;
+    SalesQuery q;
+    q.fromDate = dayToDate(todayDay() - 7);
+    q.type = "SALE";
+    q.newestFirst = false;
+    q.limit = 5000;
+    while (true) {
+        auto page = querySalesAll(q);
+        for (const auto &rec : page) {
+            long long t;
+            if (!trendParseTimestamp(rec.timestamp, t)) continue;
+            auto it = categoryOf.find(rec.drugName);
+            trending.record(rec.drugName, it == categoryOf.end() ? "未知" : it->second, rec.quantity, t);
+        }
+        if (static_cast<int>(page.size()) < q.limit) break;
+        q.afterTimestamp = page.back().timestamp;
+        q.afterId = page.back().id;
+    }
+}
+
+// 载入批次并据此重算库存；没有批次的药品（旧数据或外部导入）按自身生产日期与库存迁移为单一批次（migrate 为 false 时不迁移）
+void Pharmacy::loadLotBooks(bool migrate) {
+    lotBooks.clear();
+    const int today = todayDay();
+    for (const auto &l : sqliteDb->loadLots()) lotBooks[l.drugName].addLot(l, today);
+    std::vector<Lot> pending;
+    for (auto &d : drugs) {
+        auto it = lotBooks.find(d.name);
+        if (it != lotBooks.end()) { d.stock = it->second.total(); continue; }
+        int prodDay;
+        if (!migrate || d.stock <= 0 || !dateToDay(d.productionDate, prodDay)) continue; // 日期错误的药品保留原库存，销售时提示
+        Lot l;
+        l.drugName = d.name;
+        l.productionDate = d.productionDate;
+        l.expiryDate = dayToDate(prodDay + config.shelfLifeFor(d));
+        l.quantity = d.stock;
+        pending.push_back(l);
+    }
+    if (!pending.empty() && sqliteDb->insertLots(pending)) {
+        for (const auto &l : pending) lotBooks[l.drugName].addLot(l, today);
+        std::cout << "[批次] 已将 " << pending.size() << " 种药品的现有库存迁移为单一批次。\n";
+    }
+    rebuildDrugIndexes();
+}
+
+// 重建组合查询与名称检索索引（载入与删除药品后；删除会使后续药品的行号整体前移）
+void Pharmacy::rebuildDrugIndexes() {
+    METRICS_SCOPE("op.rebuildDrugIndexes");
+    LiveCounters::WriteScope live(liveCounters);
+    filterIndex.clear();
+    nameIndex.clear();
+    liveCounters.reset(drugs.size());
+    for (const auto &d : drugs) indexDrug(d);
+}
+
+bool Pharmacy::publishLiveCounters(const std::string &name, std::string &error) {
+    std::lock_guard<std::mutex> lock(drugsMutex);
+    if (!liveCounters.open(name, drugs.size() + drugs.size() / 4 + 64, error)) return false;
+    LiveCounters::WriteScope live(liveCounters);
+    for (const auto &d : drugs) liveCounters.publish(static_cast<uint32_t>(&d - drugs.data()), d.name, d.stock, d.totalSold);
+    return true;
+}
+
+// 更新一种药品在组合查询索引中的分类、厂家、库存与最早到期日，以及名称检索索引。调用方持有 drugsMutex 或处于单线程菜单
+void Pharmacy::indexDrug(const Drug &d) {
+    int expiry = DrugFilterIndex::kNoExpiry;
+    auto it = lotBooks.find(d.name);
+    int prodDay;
+    if (it != lotBooks.end()) {
+        if (!it->second.earliestExpiry(expiry)) expiry = DrugFilterIndex::kNoExpiry;
+    } else if (d.stock > 0 && dateToDay(d.productionDate, prodDay)) {
+        expiry = prodDay + config.shelfLifeFor(d);
+    }
+    const uint32_t row = static_cast<uint32_t>(&d - drugs.data());
+    filterIndex.set(row, d.category, d.manufacturer, d.stock, expiry);
+    nameIndex.set(row, d.name);
+    liveCounters.publish(row, d.name, d.stock, d.totalSold);
+    alerts.update(d.name, d.stock, expiry == DrugFilterIndex::kNoExpiry ? AlertEngine::kNoExpiry : expiry, config.nearExpiryFor(d));
+}
+
+// 入库一个批次：与同一生产日期的批次合并，否则新建（到期日 = 生产日期 + 保质期）。调用方持有 drugsMutex 或处于单线程菜单
+bool Pharmacy::addStockLot(Drug &d, const std::string &productionDate, int qty) {
+    std::vector<LotDelta> deltas;
+    std::vector<Lot> fresh;
+    if (!stageStockLot(d, productionDate, qty, deltas, fresh) || !commitDrugLots(d, "", deltas, fresh, std::vector<Lot>())) return false;
+    indexDrug(d);
+    return true;
+}
+
+// 在内存中合并入库（批次变化追加到 deltas），需要新建的批次追加到 fresh，由 commitDrugLots 写库后登记
+bool Pharmacy::stageStockLot(Drug &d, const std::string &productionDate, int qty, std::vector<LotDelta> &deltas, std::vector<Lot> &fresh) {
+    int prodDay;
+    if (qty <= 0 || !dateToDay(productionDate, prodDay)) return false;
+    LotBook &book = lotBooks[d.name];
+    if (book.mergeInto(productionDate, qty, todayDay(), deltas)) return true;
+    Lot l;
+    l.drugName = d.name;
+    l.productionDate = productionDate;
+    l.expiryDate = dayToDate(prodDay + config.shelfLifeFor(d));
+    l.quantity = qty;
+    fresh.push_back(l);
+    return true;
+}
+
+// 药品行与批次变化在同一事务中写库（oldName 为改名前的名称），成功后登记新批次并按批次合计更新库存。
+// 库存只随批次变化：写库失败时新批次不登记
+bool Pharmacy::commitDrugLots(Drug &d, const std::string &oldName, const std::vector<LotDelta> &deltas, std::vector<Lot> &fresh,
+                              const std::vector<Lot> &expiryChanged) {
+    auto book = lotBooks.find(d.name);
+    Drug row = d;
+    if (book != lotBooks.end()) {
+        row.stock = book->second.total();
+        for (const auto &l : fresh) row.stock += l.quantity;
+    }
+    const bool ok = sqliteDb->saveDrugLots(row, oldName, deltas, fresh, expiryChanged);
+    if (book != lotBooks.end()) {
+        // 写库失败时撤回已在内存中合并或扣减的批次数量
+        if (ok) for (const auto &l : fresh) book->second.addLot(l, todayDay());
+        else book->second.revert(deltas, todayDay());
+        d.stock = book->second.total();
+    }
+    noteDemand(d.name, 0);
+    return ok;
+}
+
+// 药品改名时批次、需求状态、补货堆与预警改键，旧名称的需求状态从库中删除（写库由调用方在药品行中完成）
+void Pharmacy::renameDrugState(const std::string &from, const std::string &to) {
+    auto node = lotBooks.extract(from);
+    if (!node.empty()) {
+        node.key() = to;
+        node.mapped().rename(to);
+        lotBooks.insert(std::move(node));
+    }
+    auto dn = demand.extract(from);
+    if (!dn.empty()) {
+        dn.key() = to;
+        demand.insert(std::move(dn));
+        demandDirty.erase(from);
+        demandRemoved.insert(from);
+        demandDirty.insert(to);
+        demandRemoved.erase(to);
+        reorderHeap.rename(from, to);
+    }
+    alerts.rename(from, to);
+}
+
+// 载入需求状态，并补算上次保存之后的流水（首次运行即用全部历史建立状态，先归档段后 sales 表），随后重建补货堆。
+// 只计 SALE 与 RETURN（退货数量为负），报损不算需求；已删除药品的流水忽略。persist 为 false（命令行只读报表）时补算结果不写库
+void Pharmacy::loadDemand(bool persist) {
+    METRICS_SCOPE("op.loadDemand");
+    long long watermark = 0;
+    demand = sqliteDb->loadDemandStates(watermark);
+    demandDirty.clear();
+    demandRemoved.clear();
+    std::unordered_set<std::string> names;
+    for (const auto &d : drugs) names.insert(d.name);
+    long long archived = watermark;
+    const bool replayed = salesArchive().forEachRow(watermark, [&](const SaleRecord &rec) {
+        observeDemandRow(rec, names);
+        if (rec.id > archived) archived = rec.id;
+    });
+    if (!replayed || archiveBroken) {
+        // 归档段读取失败：丢弃已补算的部分，沿用上次保存的状态与 watermark，本次运行不补算也不写库，
+        // 以免 watermark 越过未计入的归档流水
+        std::cout << "[预测] 归档流水读取失败，补货建议沿用上次保存的需求状态。\n";
+        demand = sqliteDb->loadDemandStates(watermark);
+        demandDirty.clear();
+        reorderHeap.clear();
+        const int today = todayDay();
+        for (const auto &kv : demand) reorderHeap.update(kv.first, coverDays(kv.first, today), today);
+        demandLoaded = false;
+        return;
+    }
+    watermark = archived;
+    const int pageSize = 5000;
+    while (true) {
+        auto page = sqliteDb->loadSalesAfter(watermark, pageSize);
+        for (const auto &rec : page) {
+            watermark = rec.id;
+            observeDemandRow(rec, names);
+        }
+        if (static_cast<int>(page.size()) < pageSize) break;
+    }
+    reorderHeap.clear();
+    const int today = todayDay();
+    for (const auto &kv : demand) reorderHeap.update(kv.first, coverDays(kv.first, today), today);
+    {
+        std::lock_guard<std::mutex> ids(demandIdsMutex);
+        demandWatermark = watermark;
+        demandOwnIds.clear();
+        demandInFlight = 0;
+    }
+    demandLoaded = true;
+    if (persist && !demandDirty.empty()) flushDemand();
+}
+
+// 按流水日期计入一笔 SALE/RETURN（报损不算需求，目录外药品忽略）
+void Pharmacy::observeDemandRow(const SaleRecord &rec, const std::unordered_set<std::string> &names) {
+    if ((rec.type != "SALE" && rec.type != "RETURN") || !names.count(rec.drugName)) return;
+    int day;
+    if (rec.timestamp.size() < 10 || !dateToDay(rec.timestamp.substr(0, 10), day)) return;
+    forecaster.observe(demand[rec.drugName], day, rec.quantity);
+    demandDirty.insert(rec.drugName);
+}
+
+// 推进 watermark：本进程已计入的流水直接跳过，其他进程写入的流水在此计入。
+// 有尚未登记流水号的本进程交易时，遇到不认识的流水即停止（可能正是那一笔），留待下次写库
+void Pharmacy::catchUpDemand() {
+    std::lock_guard<std::mutex> ids(demandIdsMutex);
+    std::unordered_set<std::string> names;
+    const int pageSize = 5000;
+    while (true) {
+        auto page = sqliteDb->loadSalesAfter(demandWatermark, pageSize);
+        for (const auto &rec : page) {
+            if (!demandOwnIds.erase(rec.id)) {
+                if (demandInFlight > 0) return;
+                if (names.empty()) for (const auto &d : drugs) names.insert(d.name);
+                observeDemandRow(rec, names);
+            }
+            demandWatermark = rec.id;
+        }
+        if (static_cast<int>(page.size()) < pageSize) break;
+    }
+}
+
+// 交易写库后登记流水号（saleId 为 0 表示写库失败），与 noteDemand 的计入一一对应
+void Pharmacy::noteDemandWritten(long long saleId) {
+    if (!demandLoaded) return;
+    std::lock_guard<std::mutex> ids(demandIdsMutex);
+    if (demandInFlight > 0) --demandInFlight;
+    if (saleId > demandWatermark) demandOwnIds.insert(saleId);
+}
+
+// 把变化过的需求状态写库，watermark 只推进到确已计入的流水（见 catchUpDemand）。调用方持有 drugsMutex 或处于单线程阶段
+bool Pharmacy::flushDemand() {
+    if (!demandLoaded || (demandDirty.empty() && demandRemoved.empty())) return true;
+    catchUpDemand();
+    std::vector<std::pair<std::string, DemandState>> states;
+    states.reserve(demandDirty.size());
+    for (const auto &name : demandDirty) {
+        auto it = demand.find(name);
+        if (it != demand.end()) states.emplace_back(name, it->second);
+    }
+    std::vector<std::string> removed(demandRemoved.begin(), demandRemoved.end());
+    if (!sqliteDb->saveDemandStates(states, removed, demandWatermark)) return false;
+    demandDirty.clear();
+    demandRemoved.clear();
+    return true;
+}
+
+// 计入一笔净销量（0 表示只有库存变化）并更新补货堆。调用方持有 drugsMutex 或处于单线程菜单
+void Pharmacy::noteDemand(const std::string &name, long long netQty) {
+    if (!demandLoaded) return;
+    const int today = todayDay();
+    if (netQty != 0) {
+        forecaster.observe(demand[name], today, netQty);
+        demandDirty.insert(name);
+        demandRemoved.erase(name);
+        std::lock_guard<std::mutex> ids(demandIdsMutex);
+        ++demandInFlight;
+    }
+    reorderHeap.update(name, coverDays(name, today), today);
+}
+
+// 可售天数 = 可售库存（不含过期批次）÷ 预测日需求；没有需求时返回 -1（不进入补货堆）
+double Pharmacy::coverDays(const std::string &name, int today) {
+    auto it = demand.find(name);
+    if (it == demand.end()) return -1;
+    double f = forecaster.forecast(it->second, today);
+    if (f < 0.01) return -1; // 不足百日一件的需求不做补货建议
+    auto book = lotBooks.find(name);
+    int sellable = book == lotBooks.end() ? 0 : book->second.sellable(today);
+    return sellable / f;
+}
+
 void Pharmacy::saveData() {
+    if (!flushDemand()) std::cout << "[预测] 需求状态保存失败。\n";
     if (db->saveDrugs(drugs)) {
         std::cout << "[数据] 保存成功，共 " << drugs.size() << " 条记录。\n";
     } else {
@@ -85,8 +512,13 @@ void Pharmacy::saveData() {
 
 void Pharmacy::menuLoop() {
     while (true) {
+        checkConfigReload();
+        pollAlerts();
         std::cout << "\n===== 药房销售系统（命令行） =====\n";
         std::cout << "登录用户：" << currentUser.username << " (" << currentUser.role << ")\n";
+        if (alerts.lowCount() + alerts.nearCount() + alerts.expiredCount() > 0)
+            std::cout << "[预警] 低库存 " << alerts.lowCount() << " 种，临期 " << alerts.nearCount() << " 种，过期 "
+                      << alerts.expiredCount() << " 种（库存与保质期 → 预警列表）\n";
         std::cout << "1. 药品管理\n";
         std::cout << "2. 库存与保质期\n";
         std::cout << "3. 销售操作\n";
@@ -109,6 +541,8 @@ void Pharmacy::menuLoop() {
 
 void Pharmacy::menuDrugs() {
     while (true) {
+        checkConfigReload();
+        pollAlerts();
         std::cout << "\n--- 药品管理 ---\n";
         std::cout << "1. 新增药品\n";
         std::cout << "2. 查询药品（按名称）\n";
@@ -116,6 +550,8 @@ void Pharmacy::menuDrugs() {
         std::cout << "4. 展示所有药品\n";
         std::cout << "5. 修改药品\n";
         std::cout << "6. 删除药品\n";
+        std::cout << "7. 组合条件查询\n";
+        std::cout << "8. 模糊查询（容错/拼音首字母）\n";
         std::cout << "0. 返回上一级\n";
         std::cout << "请选择：";
         int ch; if (!(std::cin >> ch)) return; std::cin.ignore(1024, '\n');
@@ -126,6 +562,8 @@ void Pharmacy::menuDrugs() {
             case 4: showAllDrugs(); break;
             case 5: if (currentUser.role == "admin") modifyDrug(); else std::cout << "[权限] 仅管理员可修改。\n"; break;
             case 6: if (currentUser.role == "admin") deleteDrug(); else std::cout << "[权限] 仅管理员可删除。\n"; break;
+            case 7: filterQuery(); break;
+            case 8: fuzzyQuery(); break;
             case 0: return;
             default: std::cout << "无效选择，请重试。\n"; break;
         }
@@ -134,15 +572,25 @@ void Pharmacy::menuDrugs() {
 
 void Pharmacy::menuInventory() {
     while (true) {
+        checkConfigReload();
+        pollAlerts();
         std::cout << "\n--- 库存与保质期 ---\n";
         std::cout << "1. 显示临期药品\n";
         std::cout << "2. 显示过期药品数量\n";
+        std::cout << "3. 入库（新增批次）\n";
+        std::cout << "4. 查看药品批次\n";
+        std::cout << "5. 补货建议\n";
+        std::cout << "6. 预警列表\n";
         std::cout << "0. 返回上一级\n";
         std::cout << "请选择：";
         int ch; if (!(std::cin >> ch)) return; std::cin.ignore(1024, '\n');
         switch (ch) {
             case 1: showNearExpiry(); break;
             case 2: showExpiredCount(); break;
+            case 3: receiveStock(); break;
+            case 4: showDrugLots(); break;
+            case 5: showReorder(); break;
+            case 6: showAlerts(); break;
             case 0: return;
             default: std::cout << "无效选择，请重试。\n"; break;
         }
@@ -151,6 +599,8 @@ void Pharmacy::menuInventory() {
 
 void Pharmacy::menuSales() {
     while (true) {
+        checkConfigReload();
+        pollAlerts();
         std::cout << "\n--- 销售操作 ---\n";
         std::cout << "1. 模拟销售\n";
         std::cout << "2. 退货处理\n";
@@ -170,10 +620,13 @@ void Pharmacy::menuSales() {
 
 void Pharmacy::menuStats() {
     while (true) {
+        checkConfigReload();
+        pollAlerts();
         std::cout << "\n--- 销售统计与分析 ---\n";
         std::cout << "1. 销售统计报表\n";
         std::cout << "2. 畅销/滞销分析\n";
         std::cout << "3. 品类销售趋势\n";
+        std::cout << "4. 实时热销（近1小时/1天/1周）\n";
         std::cout << "0. 返回上一级\n";
         std::cout << "请选择：";
         int ch; if (!(std::cin >> ch)) return; std::cin.ignore(1024, '\n');
@@ -181,6 +634,7 @@ void Pharmacy::menuStats() {
             case 1: salesReport(); break;
             case 2: analyzeTopBottom(); break;
             case 3: categorySalesTrend(); break;
+            case 4: showTrending(); break;
             case 0: return;
             default: std::cout << "无效选择，请重试。\n"; break;
         }
@@ -189,10 +643,18 @@ void Pharmacy::menuStats() {
 
 void Pharmacy::menuSystem() {
     while (true) {
+        checkConfigReload();
+        pollAlerts();
         std::cout << "\n--- 系统与数据 ---\n";
         std::cout << "1. 查看销售记录\n";
         std::cout << "2. 保存数据\n";
         std::cout << "3. 重新载入数据\n";
+        std::cout << "4. 在线备份数据库\n";
+        std::cout << "5. 定时备份（" << (backupRunning ? "已开启" : "未开启") << "）\n";
+        std::cout << "6. 性能指标\n";
+        std::cout << "7. 慢查询追踪设置\n";
+        std::cout << "8. 归档历史流水\n";
+        std::cout << "9. 账实核对\n";
         std::cout << "0. 返回上一级\n";
         std::cout << "请选择：";
         int ch; if (!(std::cin >> ch)) return; std::cin.ignore(1024, '\n');
@@ -200,6 +662,12 @@ void Pharmacy::menuSystem() {
             case 1: viewSales(); break;
             case 2: saveData(); break;
             case 3: drugs.clear(); loadData(); break;
+            case 4: if (currentUser.role == "admin") backupNow(); else std::cout << "[权限] 仅管理员可备份。\n"; break;
+            case 5: if (currentUser.role == "admin") toggleScheduledBackup(); else std::cout << "[权限] 仅管理员可设置定时备份。\n"; break;
+            case 6: showMetrics(); break;
+            case 7: if (currentUser.role == "admin") configureSlowQuery(); else std::cout << "[权限] 仅管理员可设置。\n"; break;
+            case 8: if (currentUser.role == "admin") archiveNow(); else std::cout << "[权限] 仅管理员可归档。\n"; break;
+            case 9: if (currentUser.role == "admin") reconcileNow(); else std::cout << "[权限] 仅管理员可核对账面。\n"; break;
             case 0: return;
             default: std::cout << "无效选择，请重试。\n"; break;
         }
@@ -229,10 +697,20 @@ void Pharmacy::addDrug() {
         }
     }
     std::cout << "库存量："; std::cin >> d.stock; std::cin.ignore(1024, '\n');
-    std::cout << "保质期天数："; int sh; if (std::cin >> sh) { if (sh > 0) d.shelfLifeDays = sh; } else { std::cin.clear(); } std::cin.ignore(1024, '\n');
-    std::cout << "临期阈值天数："; int th; if (std::cin >> th) { if (th > 0) d.nearExpiryThresholdDays = th; } else { std::cin.clear(); } std::cin.ignore(1024, '\n');
+    std::cout << "保质期天数(0 表示按配置)："; int sh; if (std::cin >> sh) { if (sh > 0) d.shelfLifeDays = sh; } else { std::cin.clear(); } std::cin.ignore(1024, '\n');
+    std::cout << "临期阈值天数(0 表示按配置)："; int th; if (std::cin >> th) { if (th > 0) d.nearExpiryThresholdDays = th; } else { std::cin.clear(); } std::cin.ignore(1024, '\n');
     d.totalSold = 0;
+    int initialStock = d.stock;
+    d.stock = 0;
     drugs.push_back(d);
+    // 初始库存作为第一个批次，与药品行一起写库
+    Drug &nd = drugs.back();
+    std::vector<LotDelta> deltas;
+    std::vector<Lot> fresh;
+    if (initialStock > 0) stageStockLot(nd, nd.productionDate, initialStock, deltas, fresh);
+    const bool stored = commitDrugLots(nd, "", deltas, fresh, std::vector<Lot>());
+    indexDrug(nd);
+    if (!stored) std::cout << "[新增] 写库失败，初始库存未入库（药品在保存数据时写入）。\n";
     std::cout << "[新增] 成功。当前总记录数：" << drugs.size() << "\n";
 }
 
@@ -244,7 +722,46 @@ void Pharmacy::queryByName() {
             printDrug(d); count++;
         }
     }
-    if (count == 0) std::cout << "[查询] 未找到匹配项。\n";
+    if (count == 0) {
+        std::cout << "[查询] 未找到匹配项。\n";
+        auto hits = nameIndex.search(name, 5);
+        if (!hits.empty()) {
+            std::cout << "您是否要找：";
+            for (size_t i = 0; i < hits.size(); ++i) std::cout << (i ? "、" : "") << drugs[hits[i].row].name;
+            std::cout << "\n";
+        }
+    }
+}
+
+// 模糊查询：按编辑距离（码点）与拼音首字母排序，输出最接近的 topN 个
+void Pharmacy::printFuzzy(const std::string &query, size_t topN) {
+    METRICS_SCOPE("report.fuzzyQuery");
+    std::lock_guard<std::mutex> lock(drugsMutex);
+    auto hits = nameIndex.search(query, topN);
+    if (hits.empty()) {
+        std::cout << "[查询] 未找到相近的药品。\n";
+        return;
+    }
+    const int W_IDX = 4, W_NAME = 20, W_CAT = 10, W_ST = 8;
+    std::cout << __pad_right_display("序号", W_IDX) << " | "
+              << __pad_right_display("名称", W_NAME) << " | "
+              << __pad_right_display("分类", W_CAT) << " | "
+              << __pad_right_display("库存", W_ST) << " | 匹配\n";
+    std::cout << std::string(W_IDX + W_NAME + W_CAT + W_ST + 3 * 4 + 12, '-') << "\n";
+    for (size_t i = 0; i < hits.size(); ++i) {
+        const Drug &d = drugs[hits[i].row];
+        std::string how = hits[i].distance == 0 ? "精确" : "差异 " + std::to_string(hits[i].distance);
+        if (hits[i].viaPinyin) how += "（拼音首字母）";
+        std::cout << __pad_left_display(std::to_string(i + 1), W_IDX) << " | "
+                  << __pad_right_display(d.name, W_NAME) << " | "
+                  << __pad_right_display(d.category, W_CAT) << " | "
+                  << __pad_left_display(std::to_string(d.stock), W_ST) << " | " << how << "\n";
+    }
+}
+
+void Pharmacy::fuzzyQuery() {
+    std::cout << "输入名称、部分名称或拼音首字母（如 amxl）："; std::string q; std::getline(std::cin, q);
+    printFuzzy(q, 10);
 }
 
 void Pharmacy::queryByCategory() {
@@ -256,7 +773,52 @@ void Pharmacy::queryByCategory() {
     if (count == 0) std::cout << "[查询] 未找到该分类的药品。\n";
 }
 
+// 组合条件查询：表达式在位图索引上求值，结果按目录顺序输出前 limit 条
+bool Pharmacy::printFilter(const std::string &expr, size_t limit) {
+    METRICS_SCOPE("report.filterQuery");
+    std::lock_guard<std::mutex> lock(drugsMutex);
+    RoaringBitmap hits;
+    std::string error;
+    if (!filterIndex.query(expr, todayDay(), hits, error)) { std::cout << "[查询] 表达式错误：" << error << "\n"; return false; }
+    const uint64_t total = hits.cardinality();
+    if (total == 0) { std::cout << "[查询] 未找到匹配项。\n"; return true; }
+    std::cout << "\n=== 组合查询：" << expr << " ===\n";
+    std::cout << "共 " << total << " 种药品" << (total > limit ? "，显示前 " + std::to_string(limit) + " 种" : std::string()) << "：\n";
+    const int W_IDX = 4, W_NAME = 16, W_CAT = 10, W_MFR = 14, W_ST = 8, W_DATE = 12;
+    std::cout << __pad_right_display("序号", W_IDX) << " | "
+              << __pad_right_display("名称", W_NAME) << " | "
+              << __pad_right_display("分类", W_CAT) << " | "
+              << __pad_right_display("厂家", W_MFR) << " | "
+              << __pad_right_display("库存", W_ST) << " | "
+              << __pad_right_display("最早到期", W_DATE) << "\n";
+    std::cout << std::string(W_IDX + W_NAME + W_CAT + W_MFR + W_ST + W_DATE + 3 * 5, '-') << "\n";
+    size_t shown = 0;
+    hits.forEach([&](uint32_t row) {
+        if (shown >= limit || row >= drugs.size()) return;
+        const Drug &d = drugs[row];
+        std::string expiry = "-";
+        auto it = lotBooks.find(d.name);
+        int day;
+        if (it != lotBooks.end() && it->second.earliestExpiry(day)) expiry = dayToDate(day);
+        std::cout << __pad_left_display(std::to_string(++shown), W_IDX) << " | "
+                  << __pad_right_display(d.name, W_NAME) << " | "
+                  << __pad_right_display(d.category, W_CAT) << " | "
+                  << __pad_right_display(d.manufacturer, W_MFR) << " | "
+                  << __pad_left_display(std::to_string(d.stock), W_ST) << " | "
+                  << __pad_right_display(expiry, W_DATE) << "\n";
+    });
+    return true;
+}
+
+void Pharmacy::filterQuery() {
+    std::cout << "条件示例：分类=抗生素 AND 厂家=华北制药 AND 库存<50 AND 到期<=60\n";
+    std::cout << "  字段：分类、厂家、库存、到期（距今天数）；运算：= != < <= > >=；AND/OR 与括号组合\n";
+    std::cout << "输入条件："; std::string expr; std::getline(std::cin, expr);
+    printFilter(expr, 50);
+}
+
 void Pharmacy::showAllDrugs() {
+    METRICS_SCOPE("report.showAllDrugs");
     if (drugs.empty()) {
         std::cout << "[展示] 暂无药品记录。\n";
         return;
@@ -294,144 +856,382 @@ void Pharmacy::modifyDrug() {
     while (it != drugs.end() && it->name != name) ++it;
     if (it == drugs.end()) { std::cout << "[修改] 未找到。\n"; return; }
     Drug &d = *it;
-    std::cout << "新名称(留空不改)："; std::string nv; std::getline(std::cin, nv); if (!nv.empty()) d.name = nv;
-    std::cout << "新分类(留空不改)："; std::string cv; std::getline(std::cin, cv); if (!cv.empty()) d.category = cv;
+    const Drug before = d;
+    const std::string oldName = d.name;
+    std::cout << "新名称(留空不改)："; std::string nv; std::getline(std::cin, nv);
+    if (!nv.empty() && nv != d.name) {
+        // 改成已有药品的名称会覆盖对方的药品行与批次，改动前拒绝
+        if (findDrug(nv)) { std::cout << "[修改] 名称已存在：" << nv << "，未修改。\n"; return; }
+        // 批次、需求状态与预警随药品改名（与药品行一起在最后写库）
+        renameDrugState(d.name, nv);
+        d.name = nv;
+    }
+    std::cout << "新分类(留空不改)："; std::string cv; std::getline(std::cin, cv);
+    const bool categoryChanged = !cv.empty() && cv != d.category;
+    if (!cv.empty()) d.category = cv;
     std::cout << "新生产厂家(留空不改)："; std::string mv; std::getline(std::cin, mv); if (!mv.empty()) d.manufacturer = mv;
     std::cout << "新药品规格(留空不改)："; std::string sv; std::getline(std::cin, sv); if (!sv.empty()) d.specification = sv;
     std::cout << "新生产日期(留空不改)："; std::string pv; std::getline(std::cin, pv); if (!pv.empty()) d.productionDate = pv;
-    std::cout << "新库存量(-1不改)："; int stv; std::cin >> stv; std::cin.ignore(1024, '\n'); if (stv >= 0) d.stock = stv;
+    std::cout << "新库存量(-1不改)："; int stv; std::cin >> stv; std::cin.ignore(1024, '\n');
+    std::vector<LotDelta> deltas;
+    std::vector<Lot> fresh;
+    if (stv >= 0 && stv != d.stock) {
+        // 盘盈按药品生产日期入库，盘亏按先到期先出扣减批次；无批次（日期错误）的药品直接改数
+        auto it = lotBooks.find(d.name);
+        if (stv > d.stock) {
+            const bool staged = stageStockLot(d, d.productionDate, stv - d.stock, deltas, fresh);
+            if (!staged && it == lotBooks.end()) d.stock = stv;
+            else if (!staged) std::cout << "[修改] 生产日期格式错误，批次库存未改。\n";
+        } else if (it != lotBooks.end()) {
+            if (!it->second.writeOff(d.stock - stv, todayDay(), deltas)) std::cout << "[修改] 批次库存不足，库存未改。\n";
+        } else {
+            d.stock = stv;
+        }
+    }
     std::cout << "新累计销量(-1不改)："; int tv; std::cin >> tv; std::cin.ignore(1024, '\n'); if (tv >= 0) d.totalSold = tv;
+    // 分类保质期可能不同，重算该药品的批次到期日
+    std::vector<Lot> changed;
+    if (categoryChanged) reExpireDrug(d, todayDay(), changed);
+    // 药品行、改名、批次增减与到期日在同一事务中写库
+    const bool stored = commitDrugLots(d, oldName, deltas, fresh, changed);
+    if (!stored) {
+        // 批次数量已由 commitDrugLots 撤回；改名、各字段与按新分类重算的到期日一并恢复
+        if (d.name != oldName) renameDrugState(d.name, oldName);
+        d = before;
+        std::vector<Lot> restored;
+        if (categoryChanged) reExpireDrug(d, todayDay(), restored);
+        noteDemand(d.name, 0);
+        indexDrug(d);
+        std::cout << "[修改] 写库失败，未修改。\n";
+        return;
+    }
+    indexDrug(d);
     std::cout << "[修改] 完成。\n";
 }
 
 void Pharmacy::deleteDrug() {
     std::string name; std::cout << "输入要删除的药品名称："; std::getline(std::cin, name);
+    if (!findDrug(name)) { std::cout << "[删除] 未找到。\n"; return; }
+    // 药品行与批次一起删除（立即写库），写库成功后再删内存
+    if (!sqliteDb->deleteDrugLots(name)) { std::cout << "[删除] 写库失败，未删除。\n"; return; }
     auto oldSize = drugs.size();
     for (auto it = drugs.begin(); it != drugs.end(); ) {
         if (it->name == name) it = drugs.erase(it);
         else ++it;
     }
+    if (drugs.size() != oldSize) lotBooks.erase(name);
+    if (drugs.size() != oldSize) alerts.remove(name);
+    if (drugs.size() != oldSize && demand.erase(name)) {
+        demandDirty.erase(name);
+        demandRemoved.insert(name);
+        reorderHeap.remove(name);
+    }
+    if (drugs.size() != oldSize) rebuildDrugIndexes();
     if (drugs.size() == oldSize) std::cout << "[删除] 未找到。\n"; else std::cout << "[删除] 已删除。\n";
 }
 
+// 临期/过期按批次统计：同一药品的不同批次分别判断
 void Pharmacy::showNearExpiry() {
-    std::vector<std::pair<Drug,int>> items;
+    METRICS_SCOPE("report.showNearExpiry");
+    struct Item { const Drug *drug; Lot lot; int remain; };
+    std::vector<Item> items;
+    const int today = todayDay();
     for (const auto &d : drugs) {
-        std::tm tmProd{};
-        if (!parseDate(d.productionDate, tmProd)) { std::cout << "[警告] 日期格式错误：" << d.productionDate << "\n"; continue; }
-        std::time_t prod = toTimeT(tmProd);
-        int shelf = d.shelfLifeDays;
-        std::time_t expiry = addDays(prod, shelf);
-        int remain = daysUntil(expiry);
-        if (remain <= d.nearExpiryThresholdDays) {
-            items.emplace_back(d, remain);
+        auto it = lotBooks.find(d.name);
+        if (it == lotBooks.end()) {
+            std::tm tmProd{};
+            if (d.stock > 0 && !parseDate(d.productionDate, tmProd)) std::cout << "[警告] 日期格式错误：" << d.productionDate << "\n";
+            continue;
+        }
+        for (const auto &lot : it->second.activeLots()) {
+            int expiryDay;
+            if (!dateToDay(lot.expiryDate, expiryDay)) { std::cout << "[警告] 批次到期日格式错误：" << lot.expiryDate << "\n"; continue; }
+            int remain = expiryDay - today;
+            if (remain <= config.nearExpiryFor(d)) items.push_back(Item{ &d, lot, remain });
         }
     }
 
     if (items.empty()) {
-        std::cout << "[临期] 当前无临期药品。\n";
+        std::cout << "[临期] 当前无临期批次。\n";
         return;
     }
 
-    std::cout << "\n=== 临期药品 ===\n";
-    std::cout << "共 " << items.size() << " 条：\n";
-    const int W_IDX = 4, W_NAME = 12, W_CAT = 8, W_MFR = 10, W_SPEC = 10, W_DATE = 10, W_ST = 6, W_SOLD = 6, W_REM = 6, W_TH = 6, W_STATUS = 6;
+    std::cout << "\n=== 临期批次 ===\n";
+    std::cout << "共 " << items.size() << " 批：\n";
+    const int W_IDX = 4, W_NAME = 12, W_CAT = 8, W_LOT = 6, W_DATE = 10, W_ST = 6, W_REM = 6, W_TH = 6, W_STATUS = 6;
     std::cout << __pad_right_display("序号", W_IDX) << " | "
               << __pad_right_display("名称", W_NAME) << " | "
               << __pad_right_display("分类", W_CAT) << " | "
-              << __pad_right_display("厂家", W_MFR) << " | "
-              << __pad_right_display("规格", W_SPEC) << " | "
+              << __pad_right_display("批次", W_LOT) << " | "
               << __pad_right_display("生产日期", W_DATE) << " | "
-              << __pad_left_display("库存", W_ST) << " | "
-              << __pad_left_display("销量", W_SOLD) << " | "
+              << __pad_right_display("到期日", W_DATE) << " | "
+              << __pad_left_display("数量", W_ST) << " | "
               << __pad_left_display("剩余(天)", W_REM) << " | "
               << __pad_left_display("阈值(天)", W_TH) << " | "
               << __pad_right_display("状态", W_STATUS) << "\n";
 
     for (size_t i = 0; i < items.size(); ++i) {
-        const Drug &d = items[i].first; int remain = items[i].second;
+        const Drug &d = *items[i].drug; const Lot &lot = items[i].lot; int remain = items[i].remain;
         std::string status = (remain < 0) ? "已过期" : "临期";
         std::cout << __pad_left_display(std::to_string(static_cast<int>(i + 1)), W_IDX) << " | "
                   << __pad_right_display(d.name, W_NAME) << " | "
                   << __pad_right_display(d.category, W_CAT) << " | "
-                  << __pad_right_display(d.manufacturer, W_MFR) << " | "
-                  << __pad_right_display(d.specification, W_SPEC) << " | "
-                  << __pad_right_display(d.productionDate, W_DATE) << " | "
-                  << __pad_left_display(std::to_string(d.stock), W_ST) << " | "
-                  << __pad_left_display(std::to_string(d.totalSold), W_SOLD) << " | "
+                  << __pad_left_display(std::to_string(lot.id), W_LOT) << " | "
+                  << __pad_right_display(lot.productionDate, W_DATE) << " | "
+                  << __pad_right_display(lot.expiryDate, W_DATE) << " | "
+                  << __pad_left_display(std::to_string(lot.quantity), W_ST) << " | "
                   << __pad_left_display(std::to_string(remain), W_REM) << " | "
-                  << __pad_left_display(std::to_string(d.nearExpiryThresholdDays), W_TH) << " | "
+                  << __pad_left_display(std::to_string(config.nearExpiryFor(d)), W_TH) << " | "
                   << __pad_right_display(status, W_STATUS) << "\n";
     }
 }
 
 void Pharmacy::showExpiredCount() {
-    int expiredCount = 0;
+    METRICS_SCOPE("report.showExpiredCount");
+    int expiredDrugs = 0, expiredLots = 0, expiredQty = 0;
+    const int today = todayDay();
     for (const auto &d : drugs) {
-        std::tm tmProd{};
-        if (!parseDate(d.productionDate, tmProd)) { 
-            std::cout << "[警告] 日期格式错误：" << d.productionDate << "\n"; 
-            continue; 
-        }
-        std::time_t prod = toTimeT(tmProd);
-        int shelf = d.shelfLifeDays;
-        std::time_t expiry = addDays(prod, shelf);
-        int remain = daysUntil(expiry);
-        if (remain < 0) {
-            expiredCount++;
+        auto it = lotBooks.find(d.name);
+        if (it == lotBooks.end()) continue;
+        int lotsOfDrug = 0;
+        for (const auto &lot : it->second.activeLots()) {
+            int expiryDay;
+            if (dateToDay(lot.expiryDate, expiryDay) && expiryDay < today) { lotsOfDrug++; expiredQty += lot.quantity; }
         }
+        if (lotsOfDrug > 0) { expiredDrugs++; expiredLots += lotsOfDrug; }
     }
     std::cout << "\n=== 过期药品统计 ===\n";
-    std::cout << "过期药品总数：" << expiredCount << " 种\n";
-    if (expiredCount > 0) {
-        std::cout << "建议及时处理过期药品！\n";
+    std::cout << "过期批次：" << expiredLots << " 批，涉及 " << expiredDrugs << " 种药品，共 " << expiredQty << " 件\n";
+    if (expiredLots > 0) {
+        std::cout << "建议及时处理过期药品！（销售操作 → 报损处理 → 全部过期批次）\n";
     } else {
         std::cout << "当前无过期药品。\n";
     }
     std::cout << "===================\n\n";
 }
 
+static std::string __alert_text(const Alert &a, int today) {
+    switch (a.kind) {
+        case AlertKind::LowStock:
+            return "[低库存] " + a.name + " 库存 " + std::to_string(a.value) + "（阈值 " + std::to_string(a.threshold) + "）";
+        case AlertKind::NearExpiry:
+            return "[临期] " + a.name + " 最早批次 " + dayToDate(a.value) + " 到期（剩 " + std::to_string(a.value - today)
+                 + " 天，阈值 " + std::to_string(a.threshold) + " 天）";
+        default:
+            return "[过期] " + a.name + " 有批次已于 " + dayToDate(a.value) + " 到期，请报损处理";
+    }
+}
+
+// 载入前：从 app_meta 取回已报告到的日期与低库存名单（没有记录时从头报告一次）
+void Pharmacy::beginAlerts() {
+    std::string state;
+    int day = 0;
+    std::vector<std::string> low;
+    if (sqliteDb->loadMeta("alert_state", state)) {
+        std::istringstream in(state);
+        std::string line;
+        if (std::getline(in, line)) {
+            try { day = std::stoi(line); } catch (...) { day = 0; }
+        }
+        while (std::getline(in, line)) if (!line.empty()) low.push_back(line);
+    }
+    alerts.reset(day, low);
+    alertSavedDay = day;
+}
+
+// 载入后（目录已经由 indexDrug 逐个建立预警状态）：推进到今天，得出上次报告以来新到期的预警
+void Pharmacy::finishAlerts() {
+    alerts.finishSeed();
+    alerts.advance(todayDay());
+}
+
+void Pharmacy::saveAlertState() {
+    std::string state = std::to_string(alerts.day()) + "\n";
+    for (const auto &name : alerts.lowReported()) state += name + "\n";
+    if (sqliteDb->saveMeta("alert_state", state)) alertSavedDay = alerts.day();
+}
+
+// 菜单每轮调用：跨日时推进时间轮，把新预警显示出来并追加到 alerts.log
+void Pharmacy::pollAlerts() {
+    if (!alertsEnabled) return;
+    std::vector<Alert> fresh;
+    const int today = todayDay();
+    {
+        std::lock_guard<std::mutex> lock(drugsMutex);
+        alerts.advance(today);
+        fresh = alerts.takePending();
+        if (fresh.empty() && alerts.day() == alertSavedDay) return;
+        saveAlertState();
+    }
+    if (fresh.empty()) return;
+    const std::string logPath = dataDir + "/alerts.log";
+    std::ofstream log(logPath, std::ios::app);
+    const std::string now = __format_now("%Y-%m-%dT%H:%M:%S");
+    const size_t shown = 20;
+    std::cout << "\n[预警] 新增 " << fresh.size() << " 条：\n";
+    for (size_t i = 0; i < fresh.size(); ++i) {
+        const std::string text = __alert_text(fresh[i], today);
+        if (log) log << now << " " << text << "\n";
+        if (i < shown) std::cout << "  " << text << "\n";
+    }
+    if (fresh.size() > shown) std::cout << "  ……其余 " << fresh.size() - shown << " 条见 " << logPath << "\n";
+}
+
+void Pharmacy::showAlerts() {
+    const size_t limit = 30;
+    std::lock_guard<std::mutex> lock(drugsMutex);
+    const int today = todayDay();
+    auto low = alerts.lowest(limit);
+    std::cout << "\n=== 预警列表 ===\n";
+    std::cout << "低库存（库存 < " << alerts.lowStockThreshold() << "）：" << alerts.lowCount() << " 种\n";
+    for (const auto &p : low) std::cout << "  " << p.first << "  库存 " << p.second << "\n";
+    if (alerts.lowCount() > low.size()) std::cout << "  ……\n";
+    auto near = alerts.nearList();
+    std::cout << "临期：" << near.size() << " 种\n";
+    for (size_t i = 0; i < near.size() && i < limit; ++i)
+        std::cout << "  " << near[i].first << "  " << dayToDate(near[i].second) << " 到期（剩 " << near[i].second - today << " 天）\n";
+    if (near.size() > limit) std::cout << "  ……\n";
+    auto expired = alerts.expiredList();
+    std::cout << "过期：" << expired.size() << " 种\n";
+    for (size_t i = 0; i < expired.size() && i < limit; ++i)
+        std::cout << "  " << expired[i].first << "  " << dayToDate(expired[i].second) << " 到期\n";
+    if (expired.size() > limit) std::cout << "  ……\n";
+    std::cout << "新预警同时记录在 " << dataDir << "/alerts.log\n";
+}
+
+// 入库：为已有药品登记一个新批次
+void Pharmacy::receiveStock() {
+    std::string name; std::cout << "入库药品名称："; std::getline(std::cin, name);
+    Drug *d = findDrug(name);
+    if (!d) { std::cout << "[入库] 未找到。\n"; return; }
+    std::string prod; std::cout << "批次生产日期(YYYY-MM-DD)："; std::getline(std::cin, prod);
+    int prodDay;
+    if (!dateToDay(prod, prodDay)) { std::cout << "[错误] 日期格式不正确，请按 YYYY-MM-DD，例如 2024-10-31。\n"; return; }
+    int qty; std::cout << "入库数量："; std::cin >> qty; std::cin.ignore(1024, '\n');
+    if (qty <= 0) { std::cout << "[入库] 数量需为正。\n"; return; }
+    std::lock_guard<std::mutex> lock(drugsMutex);
+    if (!addStockLot(*d, prod, qty)) { std::cout << "[入库] 失败。\n"; return; }
+    std::cout << "[入库] 成功。批次到期日：" << dayToDate(prodDay + config.shelfLifeFor(*d)) << "，当前库存：" << d->stock << "\n";
+}
+
+void Pharmacy::showDrugLots() {
+    std::string name; std::cout << "药品名称："; std::getline(std::cin, name);
+    auto it = lotBooks.find(name);
+    if (!findDrug(name) || it == lotBooks.end()) { std::cout << "[批次] 未找到该药品的批次。\n"; return; }
+    const int today = todayDay();
+    auto lots = it->second.activeLots();
+    std::cout << "\n=== " << name << " 的批次（先到期先出） ===\n";
+    const int W_LOT = 6, W_DATE = 10, W_ST = 6, W_REM = 8, W_STATUS = 6;
+    std::cout << __pad_right_display("批次", W_LOT) << " | "
+              << __pad_right_display("生产日期", W_DATE) << " | "
+              << __pad_right_display("到期日", W_DATE) << " | "
+              << __pad_left_display("数量", W_ST) << " | "
+              << __pad_left_display("剩余(天)", W_REM) << " | "
+              << __pad_right_display("状态", W_STATUS) << "\n";
+    for (const auto &lot : lots) {
+        int expiryDay = today;
+        bool ok = dateToDay(lot.expiryDate, expiryDay);
+        int remain = expiryDay - today;
+        std::cout << __pad_left_display(std::to_string(lot.id), W_LOT) << " | "
+                  << __pad_right_display(lot.productionDate, W_DATE) << " | "
+                  << __pad_right_display(lot.expiryDate, W_DATE) << " | "
+                  << __pad_left_display(std::to_string(lot.quantity), W_ST) << " | "
+                  << __pad_left_display(ok ? std::to_string(remain) : "?", W_REM) << " | "
+                  << __pad_right_display(!ok || remain < 0 ? "已过期" : "可售", W_STATUS) << "\n";
+    }
+    std::cout << "合计库存：" << it->second.total() << "，可售：" << it->second.sellable(today) << "\n";
+}
+
 void Pharmacy::simulateSale() {
     std::string name; std::cout << "销售药品名称："; std::getline(std::cin, name);
     int qty; std::cout << "销售数量："; std::cin >> qty; std::cin.ignore(1024, '\n');
-    if (qty <= 0) { std::cout << "[销售] 数量需为正。\n"; return; }
-    auto it = drugs.begin();
-    while (it != drugs.end() && it->name != name) ++it;
-    if (it == drugs.end()) { std::cout << "[销售] 未找到。\n"; return; }
-    Drug &d = *it;
-    // 过期检查：不允许对已过期药品进行销售
+    TxResult r = sellDrug(name, qty, currentUser.username);
+    switch (r.status) {
+        case TxStatus::InvalidQuantity: std::cout << "[销售] 数量需为正。\n"; break;
+        case TxStatus::NotFound: std::cout << "[销售] 未找到。\n"; break;
+        case TxStatus::BadDate: std::cout << "[销售] 日期格式错误：" << r.detail << "，禁止销售。\n"; break;
+        case TxStatus::Expired: std::cout << "[销售] 该药品已过期，禁止销售。\n"; break;
+        case TxStatus::InsufficientStock: std::cout << "[销售] 库存不足，当前可售库存（不含过期批次）：" << r.stock << "\n"; break;
+        case TxStatus::Ok: std::cout << "[销售] 成功。剩余库存：" << r.stock << ", 累计销量：" << r.totalSold << "\n"; break;
+        case TxStatus::WriteFailed: std::cout << "[销售] 写入数据库失败，已撤销。库存：" << r.stock << "\n"; break;
+        default: break;
+    }
+}
+
+// 按名称查找药品（调用方需持有 drugsMutex）
+Drug *Pharmacy::findDrug(const std::string &name) {
+    for (auto &d : drugs) if (d.name == name) return &d;
+    return nullptr;
+}
+
+// 销售核心逻辑：过期与库存检查、扣减库存、累计销量，并记录到 sales（type=SALE）
+TxResult Pharmacy::sellDrug(const std::string &name, int qty, const std::string &operatorName) {
+    METRICS_SCOPE("op.sellDrug");
+    TxResult res;
+    if (qty <= 0) { res.status = TxStatus::InvalidQuantity; return res; }
+    SaleRecord rec;
+    std::vector<LotDelta> deltas;
+    std::string category;
     {
-        std::tm tmProd{};
-        if (!parseDate(d.productionDate, tmProd)) {
-            std::cout << "[销售] 日期格式错误：" << d.productionDate << "，禁止销售。\n"; 
-            return;
-        }
-        std::time_t prod = toTimeT(tmProd);
-        std::time_t expiry = addDays(prod, d.shelfLifeDays);
-        int remain = daysUntil(expiry);
-        if (remain < 0) {
-            std::cout << "[销售] 该药品已过期，禁止销售。\n";
-            return;
-        }
-    }
-    if (d.stock < qty) { std::cout << "[销售] 库存不足，当前库存：" << d.stock << "\n"; return; }
-    d.stock -= qty; d.totalSold += qty;
-    std::cout << "[销售] 成功。剩余库存：" << d.stock << ", 累计销量：" << d.totalSold << "\n";
-    // 记录销售到数据库
-    std::time_t now = std::time(nullptr);
-    std::tm tmNow{};
-#ifdef _WIN32
-    localtime_s(&tmNow, &now);
-#else
-    tmNow = *std::localtime(&now);
-#endif
-    char buf[32];
-    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tmNow);
-    SaleRecord rec{ d.name, qty, std::string(buf), currentUser.username };
-    db->appendSale(rec);
+        std::lock_guard<std::mutex> lock(drugsMutex);
+        Drug *d = findDrug(name);
+        if (!d) { res.status = TxStatus::NotFound; return res; }
+        auto it = lotBooks.find(d->name);
+        if (it == lotBooks.end()) {
+            // 没有批次：生产日期格式错误的药品无法迁移，保持原有提示
+            std::tm tmProd{};
+            if (!parseDate(d->productionDate, tmProd)) { res.status = TxStatus::BadDate; res.detail = d->productionDate; return res; }
+            res.status = TxStatus::InsufficientStock; res.stock = 0; return res;
+        }
+        // 过期批次不可销售：按先到期先出从未过期批次中分配
+        LotBook &book = it->second;
+        const int today = todayDay();
+        int sellable = book.sellable(today);
+        if (sellable < qty) {
+            res.status = (sellable == 0 && book.total() > 0) ? TxStatus::Expired : TxStatus::InsufficientStock;
+            res.stock = sellable;
+            return res;
+        }
+        book.allocate(qty, today, deltas);
+        d->stock = book.total(); d->totalSold += qty;
+        res.stock = d->stock; res.totalSold = d->totalSold;
+        rec = SaleRecord{ d->name, qty, __format_now("%Y-%m-%dT%H:%M:%S"), operatorName, "SALE" };
+        category = d->category;
+        noteDemand(d->name, qty);
+        LiveCounters::WriteScope live(liveCounters);
+        indexDrug(*d);
+        liveCounters.countEvent(LiveEvent::Sale, qty);
+    }
+    long long saleId = 0;
+    const bool stored = sqliteDb->recordTransaction(rec, deltas, nullptr, &saleId);
+    noteDemandWritten(saleId);
+    if (!stored) { undoTransaction(rec.drugName, deltas, 0, qty, qty, LiveEvent::Sale, qty, res); return res; }
+    trending.record(rec.drugName, category, qty, trendClockNow());
+    return res;
+}
+
+// 交易写库失败：在内存中撤销该笔交易（批次按增量反向回滚，库存、销量按变化量回退，其间其他交易的变化保留），
+// 重新索引并撤销实时计数，res 改为 WriteFailed 并带回撤销后的账面
+void Pharmacy::undoTransaction(const std::string &name, const std::vector<LotDelta> &deltas, int stockChange, int soldChange,
+                               long long demandQty, LiveEvent event, int eventQty, TxResult &res) {
+    res.status = TxStatus::WriteFailed;
+    std::lock_guard<std::mutex> lock(drugsMutex);
+    Drug *d = findDrug(name);
+    if (!d) return;
+    auto it = lotBooks.find(d->name);
+    if (it != lotBooks.end() && !deltas.empty()) { it->second.revert(deltas, todayDay()); d->stock = it->second.total(); }
+    else d->stock -= stockChange;
+    d->totalSold -= soldChange;
+    res.stock = d->stock; res.totalSold = d->totalSold;
+    noteDemand(d->name, -demandQty);
+    if (demandQty != 0) noteDemandWritten(0);
+    LiveCounters::WriteScope live(liveCounters);
+    indexDrug(*d);
+    liveCounters.uncountEvent(event, eventQty);
 }
 
 void Pharmacy::salesReport() {
+    METRICS_SCOPE("report.salesReport");
     if (drugs.empty()) {
         std::cout << "\n=== 销售统计报表 ===\n";
         std::cout << "暂无药品数据。\n";
@@ -531,28 +1331,65 @@ std::string Pharmacy::getHiddenPassword() {
 }
 
 bool Pharmacy::login() {
-    auto users = db->loadUsers();
-    if (users.empty()) { std::cout << "[登录] 无用户记录。\n"; return false; }
     for (int attempt = 0; attempt < 3; ++attempt) {
         std::string u, p; 
         std::cout << "用户名："; 
         std::getline(std::cin, u); 
         std::cout << "密码："; 
         p = getHiddenPassword();
-        for (const auto &user : users) {
-            if (user.username == u && user.password == p) {
-                currentUser = user; loggedIn = true; std::cout << "[登录] 成功。\n"; return true;
-            }
+        User user;
+        if (authenticate(u, p, user)) {
+            currentUser = user; loggedIn = true; std::cout << "[登录] 成功。\n"; return true;
         }
         std::cout << "[登录] 账号或密码错误。\n";
     }
     return false;
 }
 
-void Pharmacy::viewSales() {
-    auto list = db->loadSales();
-    if (list.empty()) { std::cout << "[销售] 暂无记录。\n"; return; }
-    std::cout << "\n=== 销售记录（最新在后） ===\n";
+// 口令哈希强度在登录前就要用到：先静默读一遍配置文件，保质期等设置的比对与告警仍在 loadConfig 中进行
+void Pharmacy::preloadConfig() {
+    ConfigChange change;
+    std::vector<std::string> warnings;
+    config.loadFile(configPath, change, warnings);
+}
+
+ScryptParams Pharmacy::passwordParams() const {
+    ScryptParams params;
+    params.log2N = config.passwordCostLog2();
+    return params;
+}
+
+// 会话缓存命中时只做一次 HMAC 比对；否则按库中的哈希计算 scrypt，通过后记入缓存。
+// 旧版明文口令或哈希强度与当前配置不同时，校验通过后立即用当前强度重算并写库
+bool Pharmacy::authenticate(const std::string &username, const std::string &password, User &out) {
+    METRICS_SCOPE("op.authenticate");
+    User user;
+    if (!sqliteDb->findUser(username, user)) return false;
+    if (!authCache.check(username, user.password, password)) {
+        if (!verifyPassword(password, user.password)) return false;
+        const ScryptParams want = passwordParams();
+        ScryptParams have;
+        if (!passwordHashParams(user.password, have) || have.log2N != want.log2N || have.r != want.r || have.p != want.p) {
+            User updated = user;
+            updated.password = hashPassword(password, want);
+            if (!updated.password.empty() && sqliteDb->updateUserPasswords({ updated })) user.password = updated.password;
+        }
+        authCache.remember(username, user.password, password);
+    }
+    out = user;
+    return true;
+}
+
+// 把旧库中的明文口令改存为 scrypt 哈希（一次事务）；没有明文行时只是一次空查询
+void Pharmacy::migratePasswords() {
+    auto users = sqliteDb->loadUnhashedUsers();
+    if (users.empty()) return;
+    for (auto &u : users) u.password = hashPassword(u.password, passwordParams());
+    if (sqliteDb->updateUserPasswords(users)) std::cout << "[登录] 已将 " << users.size() << " 个账号的明文口令迁移为 scrypt 哈希。\n";
+    else std::cout << "[登录] 明文口令迁移失败，将在各账号下次登录时重试。\n";
+}
+
+static void __print_sales_page(const std::vector<SaleRecord> &list) {
     const int W_TIME = 19, W_NAME = 16, W_TYPE = 10, W_QTY = 8, W_OP = 12;
     std::cout << __pad_right_display("时间戳", W_TIME) << " | "
               << __pad_right_display("药品名称", W_NAME) << " | "
@@ -561,7 +1398,7 @@ void Pharmacy::viewSales() {
               << __pad_right_display("操作员", W_OP) << "\n";
     std::cout << std::string(W_TIME + W_NAME + W_TYPE + W_QTY + W_OP + 4*3, '-') << "\n";
     for (const auto &rec : list) {
-        std::string typeLabel = rec.quantity >= 0 ? "SALE" : "ADJ"; // 无type字段时用数量符号近似
+        const std::string &typeLabel = rec.type;
         std::cout << __pad_right_display(rec.timestamp, W_TIME) << " | "
                   << __pad_right_display(rec.drugName, W_NAME) << " | "
                   << __pad_right_display(typeLabel, W_TYPE) << " | "
@@ -570,65 +1407,209 @@ void Pharmacy::viewSales() {
     }
 }
 
+// 查看销售记录：先输入筛选条件，再按页浏览（最新在前），翻页从上一页最后一条继续读取
+void Pharmacy::viewSales() {
+    SalesQuery q;
+    std::cout << "筛选条件（留空不限）\n";
+    std::tm tmDate{};
+    std::cout << "起始日期(YYYY-MM-DD)："; std::getline(std::cin, q.fromDate);
+    if (!q.fromDate.empty() && !parseDate(q.fromDate, tmDate)) { std::cout << "[错误] 日期格式不正确。\n"; return; }
+    std::cout << "截止日期(YYYY-MM-DD)："; std::getline(std::cin, q.toDate);
+    if (!q.toDate.empty() && !parseDate(q.toDate, tmDate)) { std::cout << "[错误] 日期格式不正确。\n"; return; }
+    std::cout << "药品名称："; std::getline(std::cin, q.drugName);
+    std::cout << "操作员："; std::getline(std::cin, q.operatorName);
+    std::cout << "类型(SALE/RETURN/WASTAGE/ADJ)："; std::getline(std::cin, q.type);
+    for (auto &ch : q.type) ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+
+    for (int pageNo = 1; ; ++pageNo) {
+        std::vector<SaleRecord> page;
+        {
+            // 每页单独计时（查询与输出），不含等待输入的时间
+            METRICS_SCOPE("report.viewSales");
+            page = querySalesAll(q);
+            if (!page.empty()) {
+                std::cout << "\n=== 销售记录（最新在前，第 " << pageNo << " 页） ===\n";
+                __print_sales_page(page);
+            }
+        }
+        if (page.empty()) { std::cout << (pageNo == 1 ? "[销售] 暂无记录。\n" : "[销售] 没有更多记录。\n"); return; }
+        if (static_cast<int>(page.size()) < q.limit) { std::cout << "（已到末页）\n"; return; }
+        std::cout << "回车查看下一页，q 返回："; std::string cmd; std::getline(std::cin, cmd);
+        if (cmd == "q" || cmd == "Q" || !std::cin) return;
+        q.afterTimestamp = page.back().timestamp;
+        q.afterId = page.back().id;
+    }
+}
+
 // 删除销售记录的交互功能已移除，按用户要求改为直接命令行SQL处理
 
 // 退货处理：库存回滚、销量扣减，记录到sales（type=RETURN，数量为负值）
 void Pharmacy::processReturn() {
     std::string name; std::cout << "退货药品名称："; std::getline(std::cin, name);
     int qty; std::cout << "退货数量："; std::cin >> qty; std::cin.ignore(1024, '\n');
-    if (qty <= 0) { std::cout << "[退货] 数量需为正。\n"; return; }
-    auto it = drugs.begin();
-    while (it != drugs.end() && it->name != name) ++it;
-    if (it == drugs.end()) { std::cout << "[退货] 未找到。\n"; return; }
-    Drug &d = *it;
-    // 退货回滚销量、增加库存
-    d.stock += qty;
-    if (d.totalSold < qty) d.totalSold = 0; else d.totalSold -= qty;
-    std::cout << "[退货] 成功。库存：" << d.stock << ", 累计销量：" << d.totalSold << "\n";
+    TxResult r = returnDrug(name, qty, currentUser.username);
+    switch (r.status) {
+        case TxStatus::InvalidQuantity: std::cout << "[退货] 数量需为正。\n"; break;
+        case TxStatus::NotFound: std::cout << "[退货] 未找到。\n"; break;
+        case TxStatus::BadDate: std::cout << "[退货] 生产日期格式错误：" << r.detail << "，无法入库。\n"; break;
+        case TxStatus::WriteFailed: std::cout << "[退货] 写入数据库失败，已撤销。库存：" << r.stock << "\n"; break;
+        case TxStatus::Ok: std::cout << "[退货] 成功。库存：" << r.stock << ", 累计销量：" << r.totalSold << "\n"; break;
+        default: break;
+    }
+}
 
-    // 记录到sales（负数量）
-    std::time_t now = std::time(nullptr);
-    std::tm tmNow{};
-#ifdef _WIN32
-    localtime_s(&tmNow, &now);
-#else
-    tmNow = *std::localtime(&now);
-#endif
-    char buf[32];
-    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tmNow);
-    SaleRecord rec{ d.name, -qty, std::string(buf), currentUser.username };
-    db->appendSale(rec);
+TxResult Pharmacy::returnDrug(const std::string &name, int qty, const std::string &operatorName) {
+    METRICS_SCOPE("op.returnDrug");
+    TxResult res;
+    if (qty <= 0) { res.status = TxStatus::InvalidQuantity; return res; }
+    SaleRecord rec;
+    std::vector<LotDelta> deltas;
+    bool written = false;
+    long long saleId = 0;
+    int soldChange = 0;
+    {
+        std::lock_guard<std::mutex> lock(drugsMutex);
+        Drug *d = findDrug(name);
+        if (!d) { res.status = TxStatus::NotFound; return res; }
+        rec = SaleRecord{ d->name, -qty, __format_now("%Y-%m-%dT%H:%M:%S"), operatorName, "RETURN" };
+        // 退货回滚销量、增加库存：回补到最早到期的未过期批次，没有时按药品生产日期入库。
+        // 批次变化与退货记录在同一事务中写入，库存只随批次变化
+        const int today = todayDay();
+        LotBook &book = lotBooks[d->name];
+        if (!book.restock(qty, today, deltas)) {
+            int prodDay;
+            if (!dateToDay(d->productionDate, prodDay)) { res.status = TxStatus::BadDate; res.detail = d->productionDate; res.stock = d->stock; return res; }
+            if (!book.mergeInto(d->productionDate, qty, today, deltas)) {
+                // 需要新建批次：id 由写库回填，因此在持锁时提交（少见路径），失败时内存不变
+                Lot l;
+                l.drugName = d->name;
+                l.productionDate = d->productionDate;
+                l.expiryDate = dayToDate(prodDay + config.shelfLifeFor(*d));
+                l.quantity = qty;
+                std::vector<Lot> fresh{ l };
+                if (!sqliteDb->recordTransaction(rec, deltas, &fresh, &saleId)) { res.status = TxStatus::WriteFailed; res.stock = d->stock; return res; }
+                book.addLot(fresh[0], today);
+                written = true;
+            }
+        }
+        d->stock = book.total();
+        soldChange = d->totalSold < qty ? -d->totalSold : -qty;
+        d->totalSold += soldChange;
+        res.stock = d->stock; res.totalSold = d->totalSold;
+        noteDemand(d->name, -qty);
+        LiveCounters::WriteScope live(liveCounters);
+        indexDrug(*d);
+        liveCounters.countEvent(LiveEvent::Return, qty);
+    }
+    const bool stored = written || sqliteDb->recordTransaction(rec, deltas, nullptr, &saleId);
+    noteDemandWritten(saleId);
+    if (!stored) undoTransaction(rec.drugName, deltas, 0, soldChange, -qty, LiveEvent::Return, qty, res);
+    return res;
 }
 
 // 报损处理：扣减库存，不影响累计销量，记录到sales（type=WASTAGE，负数量）
 void Pharmacy::processWastage() {
     std::string name; std::cout << "报损药品名称："; std::getline(std::cin, name);
-    int qty; std::cout << "报损数量："; std::cin >> qty; std::cin.ignore(1024, '\n');
-    if (qty <= 0) { std::cout << "[报损] 数量需为正。\n"; return; }
-    auto it = drugs.begin();
-    while (it != drugs.end() && it->name != name) ++it;
-    if (it == drugs.end()) { std::cout << "[报损] 未找到。\n"; return; }
-    Drug &d = *it;
-    if (d.stock < qty) { std::cout << "[报损] 库存不足，当前库存：" << d.stock << "\n"; return; }
-    d.stock -= qty;
-    std::cout << "[报损] 成功。剩余库存：" << d.stock << ", 累计销量：" << d.totalSold << "\n";
+    std::cout << "报损方式（1. 按数量，先到期先出 2. 全部过期批次）："; int mode; std::cin >> mode; std::cin.ignore(1024, '\n');
+    TxResult r;
+    if (mode == 2) {
+        r = wasteExpiredLots(name, currentUser.username);
+        if (r.status == TxStatus::Ok && r.quantity == 0) { std::cout << "[报损] 该药品没有过期批次。\n"; return; }
+    } else {
+        int qty; std::cout << "报损数量："; std::cin >> qty; std::cin.ignore(1024, '\n');
+        r = wasteDrug(name, qty, currentUser.username);
+    }
+    switch (r.status) {
+        case TxStatus::InvalidQuantity: std::cout << "[报损] 数量需为正。\n"; break;
+        case TxStatus::NotFound: std::cout << "[报损] 未找到。\n"; break;
+        case TxStatus::InsufficientStock: std::cout << "[报损] 库存不足，当前库存：" << r.stock << "\n"; break;
+        case TxStatus::WriteFailed: std::cout << "[报损] 写入数据库失败，已撤销。库存：" << r.stock << "\n"; break;
+        case TxStatus::Ok:
+            if (mode == 2) std::cout << "[报损] 已报损过期批次 " << r.quantity << " 件。";
+            else std::cout << "[报损] 成功。";
+            std::cout << "剩余库存：" << r.stock << ", 累计销量：" << r.totalSold << "\n";
+            break;
+        default: break;
+    }
+}
 
-    // 记录到sales（负数量）
-    std::time_t now = std::time(nullptr);
-    std::tm tmNow{};
-#ifdef _WIN32
-    localtime_s(&tmNow, &now);
-#else
-    tmNow = *std::localtime(&now);
-#endif
-    char buf[32];
-    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tmNow);
-    SaleRecord rec{ d.name, -qty, std::string(buf), currentUser.username };
-    db->appendSale(rec);
+TxResult Pharmacy::wasteDrug(const std::string &name, int qty, const std::string &operatorName) {
+    METRICS_SCOPE("op.wasteDrug");
+    TxResult res;
+    if (qty <= 0) { res.status = TxStatus::InvalidQuantity; return res; }
+    SaleRecord rec;
+    std::vector<LotDelta> deltas;
+    int stockChange = 0;
+    {
+        std::lock_guard<std::mutex> lock(drugsMutex);
+        Drug *d = findDrug(name);
+        if (!d) { res.status = TxStatus::NotFound; return res; }
+        if (d->stock < qty) { res.status = TxStatus::InsufficientStock; res.stock = d->stock; return res; }
+        // 先扣过期批次，再按先到期先出扣减
+        auto it = lotBooks.find(d->name);
+        const int before = d->stock;
+        if (it != lotBooks.end()) {
+            if (!it->second.writeOff(qty, todayDay(), deltas)) { res.status = TxStatus::InsufficientStock; res.stock = it->second.total(); return res; }
+            d->stock = it->second.total();
+        } else {
+            d->stock -= qty;
+        }
+        stockChange = d->stock - before;
+        res.stock = d->stock; res.totalSold = d->totalSold; res.quantity = qty;
+        rec = SaleRecord{ d->name, -qty, __format_now("%Y-%m-%dT%H:%M:%S"), operatorName, "WASTAGE" };
+        noteDemand(d->name, 0);
+        LiveCounters::WriteScope live(liveCounters);
+        indexDrug(*d);
+        liveCounters.countEvent(LiveEvent::Wastage, qty);
+    }
+    if (!sqliteDb->recordTransaction(rec, deltas)) undoTransaction(rec.drugName, deltas, stockChange, 0, 0, LiveEvent::Wastage, qty, res);
+    return res;
+}
+
+// 报损某药品的全部过期批次，记一条 WASTAGE 流水；没有过期批次时 quantity 为 0 且不记流水
+TxResult Pharmacy::wasteExpiredLots(const std::string &name, const std::string &operatorName) {
+    METRICS_SCOPE("op.wasteExpiredLots");
+    TxResult res;
+    SaleRecord rec;
+    std::vector<LotDelta> deltas;
+    {
+        std::lock_guard<std::mutex> lock(drugsMutex);
+        Drug *d = findDrug(name);
+        if (!d) { res.status = TxStatus::NotFound; return res; }
+        auto it = lotBooks.find(d->name);
+        int n = it == lotBooks.end() ? 0 : it->second.writeOffExpired(todayDay(), deltas);
+        if (n > 0) d->stock = it->second.total();
+        res.stock = d->stock; res.totalSold = d->totalSold; res.quantity = n;
+        if (n == 0) return res;
+        rec = SaleRecord{ d->name, -n, __format_now("%Y-%m-%dT%H:%M:%S"), operatorName, "WASTAGE" };
+        noteDemand(d->name, 0);
+        LiveCounters::WriteScope live(liveCounters);
+        indexDrug(*d);
+        liveCounters.countEvent(LiveEvent::Wastage, n);
+    }
+    if (!sqliteDb->recordTransaction(rec, deltas)) undoTransaction(rec.drugName, deltas, 0, 0, 0, LiveEvent::Wastage, res.quantity, res);
+    return res;
+}
+
+bool Pharmacy::open() {
+    if (!db->init()) return false;
+    std::lock_guard<std::mutex> lock(drugsMutex);
+    drugs = db->loadDrugs();
+    loadConfig();
+    migratePasswords();
+    loadDemand();
+    warmTrending();
+    return true;
+}
+
+std::vector<Drug> Pharmacy::snapshotDrugs() {
+    std::lock_guard<std::mutex> lock(drugsMutex);
+    return drugs;
 }
 
 // 畅销/滞销分析：输出前10畅销与后10滞销（按累计销量）
 void Pharmacy::analyzeTopBottom() {
+    METRICS_SCOPE("report.analyzeTopBottom");
     if (drugs.empty()) { std::cout << "[分析] 暂无药品数据。\n"; return; }
     std::vector<Drug> list = drugs;
     // 冒泡排序按销量从高到低
@@ -655,23 +1636,85 @@ void Pharmacy::analyzeTopBottom() {
     }
 }
 
-// 品类销售趋势：按月汇总每个分类的净销售量（SALE-RETURN），忽略报损
-void Pharmacy::categorySalesTrend() {
-    auto sales = db->loadSales();
-    if (sales.empty()) { std::cout << "[趋势] 暂无销售记录。\n"; return; }
-    // 名称->分类映射
-    std::unordered_map<std::string, std::string> nameToCat;
-    for (const auto &d : drugs) nameToCat[d.name] = d.category;
-
-    // 分类 -> (YYYY-MM -> 数量)
-    std::map<std::string, std::map<std::string, int>> catMonth;
-    for (const auto &r : sales) {
-        if (r.timestamp.size() < 7) continue;
-        std::string ym = r.timestamp.substr(0, 7); // YYYY-MM
-        std::string cat = nameToCat.count(r.drugName) ? nameToCat[r.drugName] : std::string("未知");
-        // 无type字段时，所有负数都视为净销售的负向调整
-        catMonth[cat][ym] += r.quantity; // 负数包含退货与报损
+// 实时热销：category 为空显示全部药品，为 "*" 时按分类分别显示
+void Pharmacy::printTrending(const std::vector<TrendWindow> &windows, const std::string &category, size_t k) {
+    const long long now = trendClockNow();
+    std::vector<std::string> cats;
+    if (category == "*") cats = trending.categories();
+    else cats.push_back(category);
+    for (TrendWindow w : windows) {
+        std::cout << "\n=== 实时热销（" << TrendTracker::windowLabel(w) << "） ===\n";
+        for (const auto &cat : cats) {
+            auto list = trending.top(w, cat, k, now);
+            if (cats.size() > 1 && list.empty()) continue;
+            std::cout << "[" << (cat.empty() ? "全部药品" : cat) << "]\n";
+            if (list.empty()) { std::cout << "  暂无销售。\n"; continue; }
+            for (size_t i = 0; i < list.size(); ++i) {
+                std::cout << std::setw(3) << (i + 1) << ". " << list[i].key << " | 销量:" << list[i].count;
+                if (list[i].error > 0) std::cout << "（估计，误差≤" << list[i].error << "）";
+                std::cout << "\n";
+            }
+        }
     }
+}
+
+void Pharmacy::showTrending() {
+    METRICS_SCOPE("report.trending");
+    std::cout << "分类（留空为全部药品，输入 * 按分类分别显示）："; std::string cat; std::getline(std::cin, cat);
+    printTrending({ TrendWindow::Hour, TrendWindow::Day, TrendWindow::Week }, cat, 10);
+}
+
+// 补货建议：从补货堆取可售天数低于 maxCover 的前 k 项，建议量补足 30 天的预测需求
+void Pharmacy::printReorder(double maxCover, size_t k) {
+    METRICS_SCOPE("report.reorder");
+    const int targetDays = 30;
+    std::lock_guard<std::mutex> lock(drugsMutex);
+    const int today = todayDay();
+    auto list = reorderHeap.lowest(maxCover, k, today, [&](const std::string &name) { return coverDays(name, today); });
+    if (list.empty()) { std::cout << "[补货] 没有可售天数低于 " << maxCover << " 天的药品。\n"; return; }
+    std::cout << "\n=== 补货建议（可售天数 < " << maxCover << " 天，按 " << targetDays << " 天需求备货） ===\n";
+    const int W_IDX = 4, W_NAME = 16, W_NUM = 10;
+    std::cout << __pad_right_display("序号", W_IDX) << " | "
+              << __pad_right_display("名称", W_NAME) << " | "
+              << __pad_right_display("可售库存", W_NUM) << " | "
+              << __pad_right_display("日需求预测", W_NUM) << " | "
+              << __pad_right_display("可售天数", W_NUM) << " | "
+              << __pad_right_display("建议补货", W_NUM) << "\n";
+    std::cout << std::string(W_IDX + W_NAME + W_NUM * 4 + 3 * 5, '-') << "\n";
+    for (size_t i = 0; i < list.size(); ++i) {
+        const std::string &name = list[i].first;
+        double f = forecaster.forecast(demand[name], today);
+        auto book = lotBooks.find(name);
+        int sellable = book == lotBooks.end() ? 0 : book->second.sellable(today);
+        long long suggest = static_cast<long long>(std::ceil(f * targetDays)) - sellable;
+        std::ostringstream fs, cs;
+        fs << std::fixed << std::setprecision(2) << f;
+        cs << std::fixed << std::setprecision(1) << list[i].second;
+        std::cout << __pad_left_display(std::to_string(i + 1), W_IDX) << " | "
+                  << __pad_right_display(name, W_NAME) << " | "
+                  << __pad_left_display(std::to_string(sellable), W_NUM) << " | "
+                  << __pad_left_display(fs.str(), W_NUM) << " | "
+                  << __pad_left_display(cs.str(), W_NUM) << " | "
+                  << __pad_left_display(std::to_string(suggest > 0 ? suggest : 0), W_NUM) << "\n";
+    }
+}
+
+void Pharmacy::showReorder() {
+    std::cout << "可售天数阈值（留空默认 14）："; std::string line; std::getline(std::cin, line);
+    double days = 14;
+    if (!line.empty()) {
+        try { days = std::stod(line); } catch (...) { std::cout << "[补货] 请输入数字。\n"; return; }
+    }
+    printReorder(days, 50);
+}
+
+// 品类销售趋势：按月汇总每个分类的净销售量（SALE-RETURN），忽略报损；sales 表按 rowid 分片并行扫描，已归档月份用段头合计
+void Pharmacy::categorySalesTrend() {
+    METRICS_SCOPE("report.categorySalesTrend");
+    ScanStats stats;
+    CategoryMonthTotals catMonth = aggregateCategoryMonthly(salesScanner(), drugs, stats, &salesArchive());
+    if (stats.failed) { std::cout << "[趋势] 扫描销售记录失败，未输出。\n"; return; }
+    if (stats.rows == 0 && stats.archivedRows == 0) { std::cout << "[趋势] 暂无销售记录。\n"; return; }
 
     std::cout << "\n=== 品类销售趋势（按月） ===\n";
     for (const auto &catEntry : catMonth) {
@@ -681,4 +1724,658 @@ void Pharmacy::categorySalesTrend() {
         }
     }
     std::cout << "==========================\n";
-}
\ No newline at end of file
+    std::cout << "（扫描 " << stats.rows << " 条，" << stats.threads << " 线程 / " << stats.chunks << " 分片，耗时 "
+              << std::fixed << std::setprecision(3) << stats.seconds * 1000 << " ms）\n" << std::defaultfloat;
+    if (stats.segments > 0) std::cout << "（另含归档 " << stats.segments << " 段 / " << stats.archivedRows << " 条，按段头合计）\n";
+}
+
+// 连锁汇总：各门店库为一个分片并行聚合后合并，输出各分片耗时、全连锁合计、销量排行与品类月趋势；任一分片失败返回 false
+bool Pharmacy::printFederation(const std::vector<std::string> &dbPaths, size_t topK, int threads) {
+    METRICS_SCOPE("report.federation");
+    FederatedReport rep = runFederatedReports(dbPaths, topK, threads);
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "\n=== 连锁汇总（" << dbPaths.size() << " 家门店） ===\n";
+    const int W_DB = 28, W_N = 8, W_SOLD = 10, W_ST = 10, W_ROWS = 10, W_MS = 9;
+    std::cout << __pad_right_display("门店数据库", W_DB) << " | " << __pad_right_display("药品", W_N) << " | "
+              << __pad_right_display("总销量", W_SOLD) << " | " << __pad_right_display("总库存", W_ST) << " | "
+              << __pad_right_display("流水", W_ROWS) << " | " << __pad_right_display("读药品ms", W_MS) << " | "
+              << __pad_right_display("扫描ms", W_MS) << " | " << __pad_right_display("合计ms", W_MS) << "\n";
+    std::cout << std::string(W_DB + W_N + W_SOLD + W_ST + W_ROWS + W_MS * 3 + 7 * 3, '-') << "\n";
+    double shardSum = 0;
+    int failed = 0;
+    for (const auto &r : rep.shards) {
+        shardSum += r.seconds;
+        if (!r.ok) {
+            failed++;
+            std::cout << __pad_right_display(r.path, W_DB) << " | [失败] " << r.error << "\n";
+            continue;
+        }
+        std::ostringstream load, scan, total;
+        load << std::fixed << std::setprecision(1) << r.loadSeconds * 1000;
+        scan << std::fixed << std::setprecision(1) << r.scan.seconds * 1000;
+        total << std::fixed << std::setprecision(1) << r.seconds * 1000;
+        std::cout << __pad_right_display(r.path, W_DB) << " | " << __pad_left_display(std::to_string(r.drugs), W_N) << " | "
+                  << __pad_left_display(std::to_string(r.totalSold), W_SOLD) << " | " << __pad_left_display(std::to_string(r.totalStock), W_ST) << " | "
+                  << __pad_left_display(std::to_string(r.scan.rows + r.scan.archivedRows), W_ROWS) << " | " << __pad_left_display(load.str(), W_MS) << " | "
+                  << __pad_left_display(scan.str(), W_MS) << " | " << __pad_left_display(total.str(), W_MS) << "\n";
+    }
+    std::cout << "\n全连锁：药品 " << rep.distinctDrugs << " 种（按名称去重），总销量 " << rep.totalSold << "，总库存 " << rep.totalStock << "\n";
+
+    std::cout << "\n销量排行 TOP" << rep.top.size() << "（各门店按药品名称合并）：\n";
+    const int W_IDX = 4, W_NAME = 16, W_CAT = 10, W_STORES = 6;
+    std::cout << __pad_right_display("序号", W_IDX) << " | " << __pad_right_display("药品名称", W_NAME) << " | "
+              << __pad_right_display("分类", W_CAT) << " | " << __pad_right_display("销量", W_SOLD) << " | "
+              << __pad_right_display("库存", W_ST) << " | " << __pad_right_display("门店数", W_STORES) << "\n";
+    for (size_t i = 0; i < rep.top.size(); ++i) {
+        const FederatedDrug &f = rep.top[i].second;
+        std::cout << __pad_left_display(std::to_string(i + 1), W_IDX) << " | " << __pad_right_display(rep.top[i].first, W_NAME) << " | "
+                  << __pad_right_display(f.category, W_CAT) << " | " << __pad_left_display(std::to_string(f.totalSold), W_SOLD) << " | "
+                  << __pad_left_display(std::to_string(f.stock), W_ST) << " | " << __pad_left_display(std::to_string(f.stores), W_STORES) << "\n";
+    }
+
+    std::cout << "\n品类销售趋势（按月，全连锁）：\n";
+    for (const auto &catEntry : rep.catMonth) {
+        std::cout << "[" << catEntry.first << "]\n";
+        for (const auto &mEntry : catEntry.second) std::cout << "  " << mEntry.first << " : " << mEntry.second << "\n";
+    }
+    std::cout << "==========================\n";
+    std::cout << "（" << rep.threads << " 个分片并行、每分片 " << rep.scanThreads << " 个扫描线程；墙钟 " << rep.wallSeconds * 1000
+              << " ms，各分片耗时之和 " << shardSum * 1000 << " ms，并行度 " << (rep.wallSeconds > 0 ? shardSum / rep.wallSeconds : 0)
+              << "，合并 " << rep.mergeSeconds * 1000 << " ms）\n" << std::defaultfloat;
+    if (failed > 0) std::cout << "[汇总] " << failed << " 个门店库读取失败，以上合计不含这些门店。\n";
+    return failed == 0;
+}
+
+SalesScanEngine &Pharmacy::salesScanner() {
+    if (!scanEngine) {
+        int n = reportThreads > 0 ? reportThreads : static_cast<int>(std::thread::hardware_concurrency());
+        scanEngine = std::make_unique<SalesScanEngine>(sqliteDb->dbPath(), n > 0 ? n : 4);
+    }
+    return *scanEngine;
+}
+std::string Pharmacy::archiveDir() const {
+    return __dir_from_path(sqliteDb->dbPath()) + "/archive";
+}
+
+SalesArchive &Pharmacy::salesArchive() {
+    if (!archiveLoaded) {
+        std::string manifest, error;
+        sqliteDb->loadMeta(SalesArchive::manifestKey(), manifest);
+        archiveBroken = !archive.open(archiveDir(), manifest, error);
+        if (archiveBroken) std::cout << "[归档] " << error << "，归档流水暂不参与查询与报表。\n";
+        archiveLoaded = true;
+    }
+    return archive;
+}
+
+// sales 表与归档段各按相同条件、顺序和游标取一页，两页都已有序，归并出前 limit 条
+std::vector<SaleRecord> Pharmacy::querySalesAll(const SalesQuery &q) {
+    auto hot = sqliteDb->querySales(q);
+    const SalesArchive &cold = salesArchive();
+    if (cold.segments().empty()) return hot;
+    auto old = cold.query(q);
+    if (old.empty()) return hot;
+    const size_t limit = static_cast<size_t>(q.limit > 0 ? q.limit : 20);
+    auto first = [&q](const SaleRecord &a, const SaleRecord &b) {
+        int c = a.timestamp.compare(b.timestamp);
+        if (c == 0) return q.newestFirst ? a.id > b.id : a.id < b.id;
+        return q.newestFirst ? c > 0 : c < 0;
+    };
+    std::vector<SaleRecord> page;
+    page.reserve(limit);
+    size_t i = 0, j = 0;
+    while (page.size() < limit && (i < hot.size() || j < old.size())) {
+        if (j >= old.size() || (i < hot.size() && first(hot[i], old[j]))) page.push_back(std::move(hot[i++]));
+        else page.push_back(std::move(old[j++]));
+    }
+    return page;
+}
+
+// 把本月起往前 keepMonths 个月之外的流水按月写成段文件，每段写好后在一个事务内删除对应行并追加清单。
+// 时间戳不是 YYYY-MM-DDTHH:MM:SS 的记录留在 sales 表；中途失败时已完成的月份保留，其余不变
+bool Pharmacy::archiveSales(int keepMonths, bool vacuum, std::string &summary) {
+    METRICS_SCOPE("op.archiveSales");
+    if (keepMonths < 1) { summary = "保留月数至少为 1（本月不归档）"; return false; }
+    archiveLoaded = false;
+    const std::string ym = __format_now("%Y-%m");
+    const int cutIdx = std::stoi(ym.substr(0, 4)) * 12 + std::stoi(ym.substr(5, 2)) - 1 - (keepMonths - 1);
+    char cutoff[32];
+    std::snprintf(cutoff, sizeof(cutoff), "%04d-%02d-01", cutIdx / 12, cutIdx % 12 + 1);
+
+    std::string manifest;
+    sqliteDb->loadMeta(SalesArchive::manifestKey(), manifest);
+    // 记下归档目录的绝对路径，连锁汇总读取备份快照时按此找到段文件
+    std::error_code ec;
+    const std::string absDir = std::filesystem::absolute(archiveDir(), ec).lexically_normal().string();
+    if (ec || !sqliteDb->saveMeta(SalesArchive::dirKey(), absDir)) { summary = "归档目录写入 app_meta 失败"; return false; }
+    long long moved = 0, textBytes = 0, segBytes = 0, kept = 0;
+    int segments = 0;
+    for (const auto &month : sqliteDb->salesMonthsBefore(cutoff)) {
+        int y = 0, m = 0;
+        if (month.size() != 7 || month[4] != '-' || std::sscanf(month.c_str(), "%4d-%2d", &y, &m) != 2 || m < 1 || m > 12) continue;
+        char to[32];
+        std::snprintf(to, sizeof(to), "%04d-%02d-01", (y * 12 + m) / 12, (y * 12 + m) % 12 + 1);
+        auto rows = sqliteDb->loadSalesBetween(month + "-01", to);
+        std::vector<SaleRecord> segRows;
+        std::vector<long long> ids;
+        long long minId = 0;
+        for (auto &r : rows) {
+            if (!SalesArchive::isArchivable(r.timestamp)) { ++kept; continue; }
+            if (ids.empty() || r.id < minId) minId = r.id;
+            ids.push_back(r.id);
+            textBytes += static_cast<long long>(r.drugName.size() + r.timestamp.size() + r.operatorName.size() + r.type.size()) + 16;
+            segRows.push_back(std::move(r));
+        }
+        if (segRows.empty()) continue;
+        const std::string file = "sales-" + month + "-" + std::to_string(minId) + ".seg";
+        const std::string path = archiveDir() + "/" + file;
+        SalesArchive::SegmentInfo info;
+        std::string error;
+        if (!SalesArchive::writeSegment(path, segRows, info, error)) { summary = error; return false; }
+        const std::string next = manifest.empty() ? file : manifest + "\n" + file;
+        if (!sqliteDb->deleteArchivedSales(ids, SalesArchive::manifestKey(), next)) {
+            std::remove(path.c_str());
+            summary = month + " 的流水删除失败，已撤销该段";
+            return false;
+        }
+        manifest = next;
+        moved += info.rows;
+        segBytes += info.bytes;
+        ++segments;
+    }
+    std::ostringstream os;
+    os << "截止 " << cutoff << " 之前，新写入 " << segments << " 段 / " << moved << " 条";
+    if (segments > 0) os << "，" << segBytes << " 字节（约为文本的 " << std::fixed << std::setprecision(1) << 100.0 * segBytes / textBytes << "%）";
+    if (kept > 0) os << "，" << kept << " 条时间戳格式不规范，留在 sales 表";
+    if (vacuum && segments > 0) {
+        if (!sqliteDb->vacuum()) { summary = os.str() + "；VACUUM 失败"; return false; }
+        os << "，已 VACUUM";
+    }
+    summary = os.str();
+    return true;
+}
+
+void Pharmacy::printArchiveStatus() {
+    const SalesArchive &cold = salesArchive();
+    std::cout << "[归档] 目录 " << cold.directory() << "：" << cold.segments().size() << " 段，" << cold.rows() << " 条，"
+              << cold.bytes() << " 字节\n";
+    for (const auto &s : cold.segments())
+        std::cout << "  " << s.month << "  " << s.file << "  " << s.rows << " 条  " << s.bytes << " 字节  流水号 "
+                  << s.minId << "-" << s.maxId << "\n";
+}
+
+void Pharmacy::archiveNow() {
+    std::cout << "保留最近几个月（含本月，默认 3）："; std::string v; std::getline(std::cin, v);
+    int keep = 3;
+    try { if (!v.empty()) keep = std::stoi(v); } catch (...) { std::cout << "[归档] 月数格式错误。\n"; return; }
+    std::string summary;
+    bool ok = archiveSales(keep, false, summary);
+    std::cout << (ok ? "[归档] 完成：" : "[归档] 失败：") << summary << "\n";
+    printArchiveStatus();
+}
+
+// lots 为各药品的批次数量合计，不在其中的药品不核对库存
+ReconcileReport Pharmacy::runReconcile(const std::vector<Drug> &catalog, const std::unordered_map<std::string, long long> &lots) {
+    METRICS_SCOPE("report.reconcile");
+    auto lotStock = [&](const std::string &name) {
+        auto it = lots.find(name);
+        return it == lots.end() ? -1LL : it->second;
+    };
+    return reconcileSales(salesScanner(), catalog, lotStock, &salesArchive());
+}
+
+void Pharmacy::printReconcile(const ReconcileReport &rep, size_t limit) {
+    std::cout << std::fixed << std::setprecision(1)
+              << "\n=== 账实核对（流水 " << rep.scan.rows << " 条";
+    if (rep.scan.segments > 0) std::cout << " + 归档 " << rep.scan.segments << " 段 / " << rep.scan.archivedRows << " 条";
+    std::cout << "，" << rep.scan.threads << " 线程 " << rep.scan.chunks << " 分片，" << rep.scan.seconds * 1000 << " ms） ===\n"
+              << std::defaultfloat;
+    std::cout << "全部流水：销售 " << rep.total.sold << "，退货 " << -rep.total.returned << "，报损 " << -rep.total.wasted
+              << "，净销量 " << rep.total.net() << "；旧版调整 " << rep.total.adjustedRows << " 条 / " << rep.total.adjusted << "（不计入净销量）\n";
+    if (!rep.mismatches.empty()) {
+        const int W_NAME = 16, W_NUM = 10;
+        std::cout << __pad_right_display("名称", W_NAME) << " | "
+                  << __pad_right_display("销售", W_NUM) << " | "
+                  << __pad_right_display("退货", W_NUM) << " | "
+                  << __pad_right_display("报损", W_NUM) << " | "
+                  << __pad_right_display("净销量", W_NUM) << " | "
+                  << __pad_right_display("账面销量", W_NUM) << " | "
+                  << __pad_right_display("批次库存", W_NUM) << " | "
+                  << __pad_right_display("账面库存", W_NUM) << "\n";
+        std::cout << std::string(W_NAME + W_NUM * 7 + 3 * 7, '-') << "\n";
+        size_t shown = 0;
+        for (const auto &m : rep.mismatches) {
+            if (shown++ == limit) { std::cout << "……（另有 " << rep.mismatches.size() - limit << " 种未列出）\n"; break; }
+            std::cout << __pad_right_display(m.name, W_NAME) << " | "
+                      << __pad_left_display(std::to_string(m.tally.sold), W_NUM) << " | "
+                      << __pad_left_display(std::to_string(-m.tally.returned), W_NUM) << " | "
+                      << __pad_left_display(std::to_string(-m.tally.wasted), W_NUM) << " | "
+                      << __pad_left_display(std::to_string(m.tally.net()), W_NUM) << " | "
+                      << __pad_left_display(std::to_string(m.catalogSold) + (m.soldMismatch ? "*" : ""), W_NUM) << " | "
+                      << __pad_left_display(m.lotStock < 0 ? std::string("-") : std::to_string(m.lotStock), W_NUM) << " | "
+                      << __pad_left_display(std::to_string(m.catalogStock) + (m.stockMismatch ? "*" : ""), W_NUM) << "\n";
+        }
+    }
+    long long soldBad = 0, stockBad = 0;
+    for (const auto &m : rep.mismatches) { if (m.soldMismatch) soldBad++; if (m.stockMismatch) stockBad++; }
+    std::cout << "[核对] 目录 " << rep.drugs << " 种：销量不符 " << soldBad << " 种，库存不符 " << stockBad << " 种";
+    if (rep.negativeNet > 0) std::cout << "，净销量为负 " << rep.negativeNet << " 种（按 0 计）";
+    if (rep.noLots > 0) std::cout << "，无批次 " << rep.noLots << " 种（未核对库存）";
+    std::cout << "。\n";
+    if (!rep.unknown.empty()) {
+        std::cout << "[核对] 流水中有 " << rep.unknown.size() << " 种目录外药品（无法修复）：";
+        for (size_t i = 0; i < rep.unknown.size() && i < limit; ++i)
+            std::cout << (i ? "、" : "") << rep.unknown[i].first << "（" << rep.unknown[i].second.rows << " 条）";
+        if (rep.unknown.size() > limit) std::cout << " ……";
+        std::cout << "\n";
+    }
+    if (!rep.unresolved.empty()) {
+        std::cout << "[核对] " << rep.unresolved.size() << " 种药品有旧版调整流水（ADJ，无法区分退货与报损），销量无法核对，未列入修复计划：";
+        for (size_t i = 0; i < rep.unresolved.size() && i < limit; ++i) {
+            const ReconcileItem &u = rep.unresolved[i];
+            std::cout << (i ? "、" : "") << u.name << "（调整 " << u.tally.adjustedRows << " 条 / " << u.tally.adjusted
+                      << (u.stockMismatch ? "，库存不符" : "") << "）";
+        }
+        if (rep.unresolved.size() > limit) std::cout << " ……";
+        std::cout << "\n";
+    }
+}
+
+// 菜单：核对内存中的目录；扫描时不持有 drugsMutex，修复时逐项确认账面未再变化
+void Pharmacy::reconcileNow() {
+    std::vector<Drug> catalog;
+    std::unordered_map<std::string, long long> lots;
+    {
+        std::lock_guard<std::mutex> lock(drugsMutex);
+        catalog = drugs;
+        for (const auto &kv : lotBooks) lots[kv.first] = kv.second.total();
+    }
+    ReconcileReport rep = runReconcile(catalog, lots);
+    if (!rep.complete) { std::cout << "[核对] 读取销售流水失败。\n"; return; }
+    printReconcile(rep, 30);
+    if (rep.plan.empty()) { std::cout << "[核对] 账实相符，无需修复。\n"; return; }
+    std::cout << "按流水修复以上 " << rep.plan.size() << " 种药品的账面？(y/n)："; std::string yn; std::getline(std::cin, yn);
+    if (yn != "y" && yn != "Y") return;
+    std::vector<DrugRepair> applied;
+    {
+        std::lock_guard<std::mutex> lock(drugsMutex);
+        LiveCounters::WriteScope live(liveCounters);
+        for (const auto &r : rep.plan) {
+            Drug *d = findDrug(r.name);
+            if (!d || d->totalSold != r.oldSold || d->stock != r.oldStock) continue; // 核对后又有交易，留待下次核对
+            d->totalSold = r.newSold;
+            d->stock = r.newStock;
+            indexDrug(*d);
+            applied.push_back(r);
+        }
+    }
+    bool ok = sqliteDb->applyDrugRepairs(applied, false);
+    std::cout << "[核对] 已修复 " << applied.size() << " 种";
+    if (applied.size() < rep.plan.size()) std::cout << "，" << rep.plan.size() - applied.size() << " 种核对后发生变化，已跳过";
+    std::cout << (ok ? "。\n" : "，但写入数据库失败，请稍后保存数据。\n");
+}
+
+// 执行一次在线备份，summary 返回一行结果摘要（含吞吐与校验结论）
+bool Pharmacy::runBackup(const std::string &destPath, int pagesPerStep, bool showProgress, std::string &summary) {
+    BackupResult res;
+    auto progress = [&](int copied, int total) {
+        if (!showProgress || total <= 0) return;
+        std::cout << "\r[备份] 已复制 " << copied << "/" << total << " 页 ("
+                  << (copied * 100 / total) << "%)" << std::flush;
+    };
+    bool ok = sqliteDb->backupTo(destPath, pagesPerStep, 5, progress, res);
+    if (showProgress && res.totalPages > 0) std::cout << "\n";
+    std::ostringstream os;
+    if (res.seconds > 0.0 && res.copiedPages > 0) {
+        double pagesPerSec = res.copiedPages / res.seconds;
+        double mbPerSec = pagesPerSec * res.pageSize / (1024.0 * 1024.0);
+        os << std::fixed << std::setprecision(3)
+           << destPath << " | " << res.copiedPages << " 页 x " << res.pageSize << " B, "
+           << res.steps << " 步, 耗时 " << res.seconds << " s, "
+           << std::setprecision(1) << pagesPerSec << " 页/s, " << std::setprecision(2) << mbPerSec << " MB/s";
+    } else {
+        os << destPath;
+    }
+    os << " | " << (ok ? "校验通过" : "失败") << "：" << res.message;
+    summary = os.str();
+    return ok;
+}
+
+void Pharmacy::backupNow() {
+    std::string def = dataDir + "/backup/pharmacy-" + __format_now("%Y%m%d-%H%M%S") + ".db";
+    std::cout << "备份文件路径(留空使用 " << def << ")："; std::string dest; std::getline(std::cin, dest);
+    if (dest.empty()) dest = def;
+    std::cout << "每步复制页数(默认64)："; std::string pv; std::getline(std::cin, pv);
+    int pages = 64;
+    try { if (!pv.empty()) pages = std::stoi(pv); } catch (...) { pages = 64; }
+    std::string summary;
+    bool ok = runBackup(dest, pages, true, summary);
+    std::cout << (ok ? "[备份] 完成：" : "[备份] 失败：") << summary << "\n";
+}
+
+void Pharmacy::toggleScheduledBackup() {
+    if (backupRunning) {
+        stopScheduledBackup();
+        std::cout << "[备份] 定时备份已关闭。\n";
+        if (!lastBackupSummary.empty()) std::cout << "最近一次：" << lastBackupSummary << "\n";
+        return;
+    }
+    std::cout << "备份目录(留空为 " << dataDir << "/backup)："; std::string dir; std::getline(std::cin, dir);
+    if (dir.empty()) dir = dataDir + "/backup";
+    std::cout << "间隔分钟数："; int minutes; if (!(std::cin >> minutes)) { std::cin.clear(); minutes = 0; } std::cin.ignore(1024, '\n');
+    if (minutes <= 0) { std::cout << "[备份] 间隔需为正。\n"; return; }
+    startScheduledBackup(dir, minutes * 60);
+    std::cout << "[备份] 已开启，每 " << minutes << " 分钟备份到 " << dir << "，结果记录在 " << dir << "/backup.log\n";
+}
+
+// 后台线程按间隔执行备份，前台菜单与销售不受阻塞；结果追加到备份目录下的 backup.log
+void Pharmacy::startScheduledBackup(const std::string &dir, int intervalSec) {
+    stopScheduledBackup();
+    backupDir = dir;
+    backupIntervalSec = intervalSec;
+    backupRunning = true;
+    backupThread = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(backupMutex);
+        while (backupRunning) {
+            if (backupCv.wait_for(lock, std::chrono::seconds(backupIntervalSec), [this]() { return !backupRunning; })) break;
+            std::string dest = backupDir + "/pharmacy-" + __format_now("%Y%m%d-%H%M%S") + ".db";
+            lock.unlock();
+            std::string summary;
+            bool ok = runBackup(dest, 64, false, summary);
+            std::ofstream log(backupDir + "/backup.log", std::ios::app);
+            if (log) log << __format_now("%Y-%m-%dT%H:%M:%S") << " " << (ok ? "OK " : "ERR ") << summary << "\n";
+            lock.lock();
+            lastBackupSummary = summary;
+        }
+    });
+}
+
+void Pharmacy::stopScheduledBackup() {
+    {
+        std::lock_guard<std::mutex> lock(backupMutex);
+        backupRunning = false;
+    }
+    backupCv.notify_all();
+    if (backupThread.joinable()) backupThread.join();
+}
+
+int Pharmacy::runCommand(const std::vector<std::string> &rawArgs) {
+    auto usage = []() {
+        std::cout << "用法：\n"
+                  << "  pharmacy_cli                               进入交互菜单\n"
+                  << "  pharmacy_cli backup <目标文件> [每步页数]    在线备份数据库并校验\n"
+                  << "  pharmacy_cli backup-schedule <目录> <间隔秒> [次数]  定时备份（次数缺省为不限）\n"
+                  << "  pharmacy_cli explain                       输出各报表查询的 EXPLAIN QUERY PLAN\n"
+                  << "  pharmacy_cli sales [--from 日期] [--to 日期] [--drug 名称] [--operator 用户] [--type 类型]\n"
+                  << "                     [--limit N] [--asc] [--after 时间戳,流水号]  分页查询销售流水\n"
+                  << "  pharmacy_cli trending [--window hour|day|week] [--category 分类|*] [--top K]  实时热销榜\n"
+                  << "  pharmacy_cli filter <条件> [--limit N]       组合条件查询，如 \"分类=抗生素 AND 库存<50 AND 到期<=60\"\n"
+                  << "  pharmacy_cli search <关键字> [--top N]       模糊查询药品名称（容错、拼音首字母）\n"
+                  << "  pharmacy_cli reorder [--days N] [--top K]  补货建议（可售天数低于 N 天，默认 14）\n"
+                  << "  pharmacy_cli federate <门店库>... [--top K] [--threads T]  多门店并行汇总（销量、排行、品类月趋势）\n"
+                  << "  pharmacy_cli archive [--keep-months N] [--vacuum]  把 N 个月之前的流水移入压缩归档段（默认 3，含本月；需管理员 --user）\n"
+                  << "  pharmacy_cli reconcile [--threads T] [--limit N] [--sql 文件] [--apply]  按销售流水核对目录中的累计销量与库存（--apply 需管理员 --user）\n"
+                  << "全局选项：--slow-ms <毫秒>  慢查询阈值（写入 data/slow_query.log，-1 关闭）\n"
+                  << "          --user <用户名> [--password <口令>]  先校验账号再执行命令（口令也可经环境变量 PHARMACY_PASSWORD 传入）\n";
+    };
+    // 先剥离全局选项，剩余部分为命令及其参数
+    std::vector<std::string> args;
+    double slowMs = sqliteDb->slowQueryThresholdMs();
+    std::string username, password;
+    bool hasUser = false, hasPassword = false;
+    for (size_t i = 0; i < rawArgs.size(); ++i) {
+        if (rawArgs[i] == "--slow-ms" && i + 1 < rawArgs.size()) {
+            try { slowMs = std::stod(rawArgs[++i]); } catch (...) { std::cout << "[命令] --slow-ms 需为数字。\n"; return 2; }
+        } else if (rawArgs[i] == "--user" && i + 1 < rawArgs.size()) {
+            username = rawArgs[++i];
+            hasUser = true;
+        } else if (rawArgs[i] == "--password" && i + 1 < rawArgs.size()) {
+            password = rawArgs[++i];
+            hasPassword = true;
+        } else {
+            args.push_back(rawArgs[i]);
+        }
+    }
+    if (args.empty() || args[0] == "help" || args[0] == "--help") { usage(); return args.empty() ? 2 : 0; }
+    // 连锁汇总只读各门店库，除非要先校验账号，否则不打开本地库
+    if (args[0] != "federate" || hasUser) {
+        if (!db->init()) { std::cout << "[错误] SQLite 初始化失败。\n"; return 1; }
+        sqliteDb->setSlowQueryThresholdMs(slowMs);
+    }
+    if (hasUser) {
+        if (!hasPassword) {
+            const char *env = std::getenv("PHARMACY_PASSWORD");
+            if (env) password = env;
+        }
+        preloadConfig();
+        migratePasswords();
+        User user;
+        if (!authenticate(username, password, user)) { std::cout << "[登录] 账号或密码错误。\n"; return 3; }
+        currentUser = user;
+        loggedIn = true;
+    }
+    // 改写数据的命令须以 --user 校验过的管理员身份执行
+    auto requireAdmin = [this](const char *tag) {
+        if (!loggedIn) { std::cout << "[" << tag << "] 需用 --user 指定管理员账号。\n"; return false; }
+        if (currentUser.role != "admin") { std::cout << "[权限] 仅管理员可执行此命令。\n"; return false; }
+        return true;
+    };
+    const std::string &cmd = args[0];
+    try {
+        if (cmd == "backup" && args.size() >= 2) {
+            int pages = args.size() >= 3 ? std::stoi(args[2]) : 64;
+            std::string summary;
+            bool ok = runBackup(args[1], pages, true, summary);
+            std::cout << (ok ? "[备份] 完成：" : "[备份] 失败：") << summary << "\n";
+            return ok ? 0 : 1;
+        }
+        if (cmd == "backup-schedule" && args.size() >= 3) {
+            int interval = std::stoi(args[2]);
+            int times = args.size() >= 4 ? std::stoi(args[3]) : 0;
+            if (interval <= 0) { std::cout << "[备份] 间隔需为正。\n"; return 2; }
+            int failures = 0;
+            for (int i = 0; times == 0 || i < times; ++i) {
+                if (i > 0) std::this_thread::sleep_for(std::chrono::seconds(interval));
+                std::string dest = args[1] + "/pharmacy-" + __format_now("%Y%m%d-%H%M%S") + ".db";
+                std::string summary;
+                bool ok = runBackup(dest, 64, false, summary);
+                if (!ok) failures++;
+                std::cout << __format_now("%Y-%m-%dT%H:%M:%S") << " " << (ok ? "OK " : "ERR ") << summary << std::endl;
+            }
+            return failures == 0 ? 0 : 1;
+        }
+        if (cmd == "explain") {
+            for (const auto &kv : sqliteDb->explainReportQueries()) std::cout << kv.first << "\n" << kv.second;
+            return 0;
+        }
+        if (cmd == "trending") {
+            std::vector<TrendWindow> windows;
+            std::string category;
+            size_t k = 10;
+            for (size_t i = 1; i + 1 < args.size(); i += 2) {
+                const std::string &a = args[i], &v = args[i + 1];
+                if (a == "--window") {
+                    if (v == "hour") windows.push_back(TrendWindow::Hour);
+                    else if (v == "day") windows.push_back(TrendWindow::Day);
+                    else if (v == "week") windows.push_back(TrendWindow::Week);
+                    else { usage(); return 2; }
+                }
+                else if (a == "--category") category = v;
+                else if (a == "--top") k = static_cast<size_t>(std::stoul(v));
+                else { usage(); return 2; }
+            }
+            if (args.size() % 2 == 0) { usage(); return 2; }
+            if (windows.empty()) windows = { TrendWindow::Hour, TrendWindow::Day, TrendWindow::Week };
+            drugs = db->loadDrugs();
+            warmTrending();
+            printTrending(windows, category, k);
+            return 0;
+        }
+        if (cmd == "filter" && args.size() >= 2) {
+            size_t limit = 50;
+            if (args.size() == 4 && args[2] == "--limit") limit = static_cast<size_t>(std::stoul(args[3]));
+            else if (args.size() != 2) { usage(); return 2; }
+            {
+                std::lock_guard<std::mutex> lock(drugsMutex);
+                drugs = db->loadDrugs();
+                loadConfigReadOnly();
+            }
+            return printFilter(args[1], limit) ? 0 : 2;
+        }
+        if (cmd == "search" && args.size() >= 2) {
+            size_t topN = 10;
+            if (args.size() == 4 && args[2] == "--top") topN = static_cast<size_t>(std::stoul(args[3]));
+            else if (args.size() != 2) { usage(); return 2; }
+            {
+                std::lock_guard<std::mutex> lock(drugsMutex);
+                drugs = db->loadDrugs();
+                loadConfigReadOnly();
+            }
+            printFuzzy(args[1], topN);
+            return 0;
+        }
+        if (cmd == "federate") {
+            std::vector<std::string> paths;
+            size_t k = 20;
+            int threads = 0;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i] == "--top" && i + 1 < args.size()) k = static_cast<size_t>(std::stoul(args[++i]));
+                else if (args[i] == "--threads" && i + 1 < args.size()) threads = std::stoi(args[++i]);
+                else if (args[i].compare(0, 2, "--") == 0) { usage(); return 2; }
+                else paths.push_back(args[i]);
+            }
+            if (paths.empty()) { usage(); return 2; }
+            return printFederation(paths, k, threads) ? 0 : 1;
+        }
+        if (cmd == "archive") {
+            int keep = 3;
+            bool vacuum = false;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i] == "--keep-months" && i + 1 < args.size()) keep = std::stoi(args[++i]);
+                else if (args[i] == "--vacuum") vacuum = true;
+                else { usage(); return 2; }
+            }
+            if (!requireAdmin("归档")) return 3;
+            std::string summary;
+            bool ok = archiveSales(keep, vacuum, summary);
+            std::cout << (ok ? "[归档] 完成：" : "[归档] 失败：") << summary << "\n";
+            printArchiveStatus();
+            return ok ? 0 : 1;
+        }
+        if (cmd == "reconcile") {
+            size_t limit = 50;
+            std::string sqlPath;
+            bool apply = false;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i] == "--threads" && i + 1 < args.size()) reportThreads = std::stoi(args[++i]);
+                else if (args[i] == "--limit" && i + 1 < args.size()) limit = static_cast<size_t>(std::stoul(args[++i]));
+                else if (args[i] == "--sql" && i + 1 < args.size()) sqlPath = args[++i];
+                else if (args[i] == "--apply") apply = true;
+                else { usage(); return 2; }
+            }
+            if (apply && !requireAdmin("核对")) return 3;
+            // 核对数据库中的目录（上次保存的账面），库存与 lots 表比较
+            ReconcileReport rep = runReconcile(db->loadDrugs(), sqliteDb->lotTotals());
+            if (!rep.complete) { std::cout << "[核对] 读取销售流水失败。\n"; return 1; }
+            printReconcile(rep, limit);
+            if (!sqlPath.empty()) {
+                std::ofstream out(sqlPath, std::ios::binary | std::ios::trunc);
+                out << repairPlanSql(rep.plan);
+                if (!out) { std::cout << "[核对] 无法写入 " << sqlPath << "\n"; return 1; }
+                std::cout << "[核对] 修复计划（" << rep.plan.size() << " 条 UPDATE，单个事务）已写入 " << sqlPath << "\n";
+            }
+            if (apply && !rep.plan.empty()) {
+                if (!sqliteDb->applyDrugRepairs(rep.plan, true)) {
+                    std::cout << "[核对] 修复未执行：核对后目录已被修改或写入失败，已回滚，请重新核对。\n";
+                    return 1;
+                }
+                std::cout << "[核对] 已在一个事务中修复 " << rep.plan.size() << " 种药品。\n";
+            }
+            return 0;
+        }
+        if (cmd == "reorder") {
+            double days = 14;
+            size_t k = 20;
+            for (size_t i = 1; i + 1 < args.size(); i += 2) {
+                if (args[i] == "--days") days = std::stod(args[i + 1]);
+                else if (args[i] == "--top") k = static_cast<size_t>(std::stoul(args[i + 1]));
+                else { usage(); return 2; }
+            }
+            if (args.size() % 2 == 0) { usage(); return 2; }
+            {
+                std::lock_guard<std::mutex> lock(drugsMutex);
+                drugs = db->loadDrugs();
+                loadConfigReadOnly();
+                loadDemand(false);
+            }
+            printReorder(days, k);
+            return 0;
+        }
+        if (cmd == "sales") {
+            SalesQuery q;
+            for (size_t i = 1; i < args.size(); ++i) {
+                const std::string &a = args[i];
+                bool hasValue = i + 1 < args.size();
+                if (a == "--asc") q.newestFirst = false;
+                else if (!hasValue) { usage(); return 2; }
+                else if (a == "--from") q.fromDate = args[++i];
+                else if (a == "--to") q.toDate = args[++i];
+                else if (a == "--drug") q.drugName = args[++i];
+                else if (a == "--operator") q.operatorName = args[++i];
+                else if (a == "--type") q.type = args[++i];
+                else if (a == "--limit") q.limit = std::stoi(args[++i]);
+                else if (a == "--after") {
+                    const std::string &cursor = args[++i];
+                    size_t comma = cursor.rfind(',');
+                    if (comma == std::string::npos) { std::cout << "[命令] --after 格式为 时间戳,流水号。\n"; return 2; }
+                    q.afterTimestamp = cursor.substr(0, comma);
+                    q.afterId = std::stoll(cursor.substr(comma + 1));
+                }
+                else { usage(); return 2; }
+            }
+            std::tm tmDate{};
+            if ((!q.fromDate.empty() && !parseDate(q.fromDate, tmDate)) || (!q.toDate.empty() && !parseDate(q.toDate, tmDate))) {
+                std::cout << "[命令] 日期格式为 YYYY-MM-DD。\n";
+                return 2;
+            }
+            if (q.limit <= 0) { std::cout << "[命令] --limit 需为正。\n"; return 2; }
+            auto page = querySalesAll(q);
+            if (page.empty()) { std::cout << "[销售] 暂无记录。\n"; return 0; }
+            __print_sales_page(page);
+            // 满页时给出下一页游标，便于脚本循环调用
+            if (static_cast<int>(page.size()) == q.limit)
+                std::cout << "下一页：--after " << page.back().timestamp << "," << page.back().id << "\n";
+            return 0;
+        }
+    } catch (const std::exception &) {
+        std::cout << "[命令] 参数格式错误。\n";
+        return 2;
+    }
+    usage();
+    return 2;
+}
+
+void Pharmacy::showMetrics() {
+    std::cout << "\n=== 性能指标（启动以来） ===\n";
+    Metrics::instance().printTable(std::cout);
+    std::cout << "退出时导出到 " << dataDir << "/metrics.json 与 " << dataDir << "/metrics.prom\n";
+}
+
+void Pharmacy::configureSlowQuery() {
+    double cur = sqliteDb->slowQueryThresholdMs();
+    std::cout << "当前慢查询阈值：" << (cur < 0 ? std::string("已关闭") : std::to_string(cur) + " ms")
+              << "，查询计划捕获：" << (sqliteDb->explainCaptureEnabled() ? "开启" : "关闭") << "\n";
+    std::cout << "新阈值毫秒(-1关闭，留空不改)："; std::string tv; std::getline(std::cin, tv);
+    if (!tv.empty()) {
+        try { sqliteDb->setSlowQueryThresholdMs(std::stod(tv)); } catch (...) { std::cout << "[设置] 阈值格式错误。\n"; }
+    }
+    std::cout << "开启 EXPLAIN QUERY PLAN 捕获？(y/n，留空不改)："; std::string ev; std::getline(std::cin, ev);
+    if (ev == "y" || ev == "Y") sqliteDb->setExplainCapture(true);
+    else if (ev == "n" || ev == "N") sqliteDb->setExplainCapture(false);
+    auto plans = sqliteDb->capturedPlans();
+    if (!plans.empty()) {
+        std::cout << "\n=== 已捕获的查询计划 ===\n";
+        for (const auto &kv : plans) std::cout << kv.first << "\n" << kv.second;
+    }
+    std::cout << "[设置] 慢查询日志：" << sqliteDb->slowLogPath() << "\n";
+}
@@ -2,27 +2,168 @@
 #define PHARMACY_H
 
 #include "drug.h"
+#include "sales_scan.h"
+#include "lots.h"
+#include "trending.h"
+#include "forecast.h"
+#include "drug_filter.h"
+#include "fuzzy.h"
+#include "config.h"
+#include "password.h"
+#include "live_counters.h"
+#include "sales_archive.h"
+#include "reconcile.h"
+#include "alerts.h"
 #ifdef HAS_SQLITE
 #include "sqlite_db.h"
 #endif
 #include <vector>
 #include <string>
 #include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+
+// 交易（销售/退货/报损）处理结果
+enum class TxStatus { Ok, InvalidQuantity, NotFound, BadDate, Expired, InsufficientStock, WriteFailed };
+
+struct TxResult {
+    TxStatus status = TxStatus::Ok;
+    int stock = 0;          // 处理后（或拒绝时）的库存
+    int totalSold = 0;
+    int quantity = 0;       // 实际处理数量（报损全部过期批次时）
+    std::string detail;     // 附加信息，如格式错误的日期
+};
 
 class Pharmacy {
 public:
     Pharmacy(const std::string &dataFile);
+    ~Pharmacy();
     void run();
+    // 命令行批处理入口（pharmacy_cli <命令> [参数...]），返回进程退出码
+    int runCommand(const std::vector<std::string> &args);
+
+    // 无需登录的打开方式（初始化数据库并载入药品），供批处理与压测工具使用
+    bool open();
+    std::vector<Drug> snapshotDrugs();
+    // 交易核心逻辑：菜单、批处理与回放压测共用，可被多个线程并发调用
+    TxResult sellDrug(const std::string &name, int qty, const std::string &operatorName);
+    TxResult returnDrug(const std::string &name, int qty, const std::string &operatorName);
+    TxResult wasteDrug(const std::string &name, int qty, const std::string &operatorName);
+    TxResult wasteExpiredLots(const std::string &name, const std::string &operatorName);
+    // 校验用户名与口令（按用户名点查，scrypt 哈希；已验证过的口令走进程内会话缓存），可被多个线程并发调用
+    bool authenticate(const std::string &username, const std::string &password, User &out);
+    const AuthCache &authSessions() const { return authCache; }
+    // 把各药品库存/累计销量与全店合计发布到共享内存段 name（看板用 pharmacy_live 只读读取），此后每笔交易即时更新
+    bool publishLiveCounters(const std::string &name, std::string &error);
 
 private:
+    friend class PharmacyBench; // 基准测试直接驱动内部业务函数
+
     std::vector<Drug> drugs;
+    std::mutex drugsMutex;  // 保护 drugs 与 lotBooks，交易核心逻辑可并发调用
+    std::unordered_map<std::string, LotBook> lotBooks; // 按药品名称的批次账本，库存 = 各批次数量之和
+    TrendTracker trending;  // 近 1 小时/天/周热销（每笔销售更新，启动时用近一周流水预热）
+    // 需求预测与补货建议（受 drugsMutex 保护）：每个药品一份平滑状态，按可售天数建索引堆
+    DemandForecaster forecaster;
+    std::unordered_map<std::string, DemandState> demand;
+    std::unordered_set<std::string> demandDirty;    // 待写库的状态
+    std::unordered_set<std::string> demandRemoved;  // 待从库中删除的状态（药品删除或改名）
+    ReorderHeap reorderHeap;
+    bool demandLoaded = false;
+    long long demandWatermark = 0;              // 该流水号及之前的流水均已计入需求状态（写库时保存）
+    std::mutex demandIdsMutex;                  // 保护以下两项：交易写库后在 drugsMutex 之外登记流水号
+    std::unordered_set<long long> demandOwnIds; // 本进程经 noteDemand 计入、流水号大于 watermark 的流水
+    int demandInFlight = 0;                     // 已经 noteDemand 计入、尚未登记流水号的交易数
+    DrugFilterIndex filterIndex; // 组合条件查询的位图索引（行号 = drugs 下标），受 drugsMutex 保护
+    FuzzyNameIndex nameIndex;    // 容错/拼音首字母名称检索（行号同上），受 drugsMutex 保护
+    LiveCounters liveCounters;   // 共享内存实时计数（槽位号同上），受 drugsMutex 保护，未发布时更新为空操作
+    // 运行配置（与 data 目录同级的 config.txt）：菜单循环轮询文件变化，变化后只重算受影响药品的批次到期日
+    AppConfig config;
+    ConfigWatcher configWatcher;
+    std::string configPath;
     std::string dataFilePath;
     std::string dataDir;
     std::unique_ptr<IDatabase> db;
+    SqliteDatabase *sqliteDb = nullptr; // 指向 db 的具体实现，供备份等 SQLite 专有功能使用
     bool loggedIn = false;
     User currentUser;
+    AuthCache authCache;
+
+    // 定时备份（后台线程，与前台销售共用连接，按页分批复制）
+    std::thread backupThread;
+    std::mutex backupMutex;
+    std::condition_variable backupCv;
+    std::atomic<bool> backupRunning{false};
+    std::string backupDir;
+    int backupIntervalSec = 0;
+    std::string lastBackupSummary;
+
+    // 并行报表引擎（懒创建，线程数默认取硬件并发数）
+    std::unique_ptr<SalesScanEngine> scanEngine;
+    int reportThreads = 0;
+    SalesScanEngine &salesScanner();
+
+    // 冷流水归档（数据库所在目录下的 archive/，段头懒载入）：查询与报表合并热数据与归档数据
+    SalesArchive archive;
+    bool archiveLoaded = false;
+    bool archiveBroken = false; // 清单中的段打不开：归档流水缺失，需求补算不能越过它们
+    SalesArchive &salesArchive();
+    std::string archiveDir() const;
+    std::vector<SaleRecord> querySalesAll(const SalesQuery &q);
+    bool archiveSales(int keepMonths, bool vacuum, std::string &summary);
+    void printArchiveStatus();
+    void archiveNow();
+
+    // 账实核对：并行重算各药品的净销量并与目录比较，给出可在单个事务中执行的修复计划
+    ReconcileReport runReconcile(const std::vector<Drug> &catalog, const std::unordered_map<std::string, long long> &lots);
+    void printReconcile(const ReconcileReport &rep, size_t limit);
+    void reconcileNow();
+
+    // 低库存与到期预警（交互菜单启用）：已报告到的日期与低库存名单记录在 app_meta.alert_state
+    AlertEngine alerts;
+    bool alertsEnabled = false;
+    int alertSavedDay = 0;
+    void beginAlerts();
+    void finishAlerts();
+    void pollAlerts();
+    void saveAlertState();
+    void showAlerts();
 
     void loadData();
+    void loadConfig();
+    void loadConfigReadOnly();
+    void checkConfigReload();
+    bool reExpireDrug(Drug &d, int today, std::vector<Lot> &changed);
+    int applyShelfLifeChange(const ConfigChange &change, bool all, int &drugsChanged);
+    void loadLotBooks(bool migrate = true);
+    void warmTrending();
+    void printTrending(const std::vector<TrendWindow> &windows, const std::string &category, size_t k);
+    void showTrending();
+    bool addStockLot(Drug &d, const std::string &productionDate, int qty);
+    bool stageStockLot(Drug &d, const std::string &productionDate, int qty, std::vector<LotDelta> &deltas, std::vector<Lot> &fresh);
+    bool commitDrugLots(Drug &d, const std::string &oldName, const std::vector<LotDelta> &deltas, std::vector<Lot> &fresh,
+                        const std::vector<Lot> &expiryChanged);
+    void renameDrugState(const std::string &from, const std::string &to);
+    void loadDemand(bool persist = true);
+    bool flushDemand();
+    void noteDemand(const std::string &name, long long netQty);
+    void noteDemandWritten(long long saleId);
+    void undoTransaction(const std::string &name, const std::vector<LotDelta> &deltas, int stockChange, int soldChange,
+                         long long demandQty, LiveEvent event, int eventQty, TxResult &res);
+    void observeDemandRow(const SaleRecord &rec, const std::unordered_set<std::string> &names);
+    void catchUpDemand();
+    double coverDays(const std::string &name, int today);
+    void printReorder(double maxCover, size_t k);
+    void showReorder();
+    void rebuildDrugIndexes();
+    void indexDrug(const Drug &d);
+    bool printFilter(const std::string &expr, size_t limit);
+    void printFuzzy(const std::string &query, size_t topN);
+    bool printFederation(const std::vector<std::string> &dbPaths, size_t topK, int threads);
     void saveData();
     void menuLoop();
     // 二级菜单（五类）
@@ -33,14 +174,26 @@ private:
     void menuSystem();
     void onExit();
     bool login();
+    void preloadConfig();
+    void migratePasswords();
+    ScryptParams passwordParams() const;
     std::string getHiddenPassword();
     void viewSales();
+    void backupNow();
+    void toggleScheduledBackup();
+    bool runBackup(const std::string &destPath, int pagesPerStep, bool showProgress, std::string &summary);
+    void startScheduledBackup(const std::string &dir, int intervalSec);
+    void stopScheduledBackup();
+    void showMetrics();
+    void configureSlowQuery();
     // 删除销售记录交互功能已移除
     
     // 药品管理功能
     void addDrug();
     void queryByName();
     void queryByCategory();
+    void filterQuery();
+    void fuzzyQuery();
     void showAllDrugs();
     void modifyDrug();
     void deleteDrug();
@@ -48,6 +201,8 @@ private:
     // 其他功能
     void showNearExpiry();
     void showExpiredCount();
+    void receiveStock();
+    void showDrugLots();
     void simulateSale();
     void salesReport();
     void processReturn();
@@ -55,6 +210,7 @@ private:
     void analyzeTopBottom();
     void categorySalesTrend();
     void printDrug(const Drug &d) const;
+    Drug *findDrug(const std::string &name);
 };
 
 #endif // PHARMACY_H
\ No newline at end of file
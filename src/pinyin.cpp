@@ -0,0 +1,150 @@
+#include "pinyin.h"
+#include <unordered_map>
+
+namespace {
+
+struct InitialGroup {
+    char initial;
+    const char *chars; // UTF-8
+};
+
+// 按拼音首字母分组的常用汉字（覆盖药品名、厂家名的常见用字）。
+// 多音字取药名中的常见读音：参(shēn)、术(zhú)、藏(zàng)、长(cháng)、行(xíng)、重(chóng)、膀(páng)、调(tiáo)
+const InitialGroup kGroups[] = {
+    { 'a',
+      "阿啊哎埃艾爱安氨胺桉鞍岸按案暗昂凹敖熬奥澳懊" },
+    { 'b',
+      "八巴叭扒吧芭疤拔把坝爸罢霸白百柏摆败拜斑班般颁板版办半伴扮瓣邦帮绑榜棒磅包胞苞褒"
+      "雹宝饱保堡报抱豹暴爆杯卑悲碑北贝钡备背倍被焙辈奔苯本崩泵逼鼻比吡彼笔币必毕闭庇痹"
+      "蓖碧弊壁避臂边编鞭扁便变遍辨辩辫苄标膘表鳖别宾彬滨槟冰兵丙秉柄饼并病拨波玻剥钵菠"
+      "播伯驳泊勃铂舶博搏膊薄卜补捕哺不布步部簿荜萆铋孢" },
+    { 'c',
+      "擦猜才材财裁采彩菜蔡餐残蚕惨灿仓苍舱操糙曹槽草册侧厕测策层叉茶查察差拆柴豺掺蝉馋"
+      "缠蟾产铲颤昌菖长肠尝常偿厂场畅倡唱抄钞超巢朝潮吵炒车扯彻撤尘臣沉辰陈晨衬称撑成呈"
+      "承诚城乘程惩澄橙秤吃痴池驰迟持匙尺齿耻斥赤翅充冲虫崇宠抽仇绸畴稠愁筹酬丑臭出初除"
+      "厨锄雏橱杵础储楚处触川穿传船喘串疮窗床创吹炊垂锤春椿纯唇醇淳蠢磁雌慈辞瓷词此次刺"
+      "从丛葱聪粗促醋簇催脆翠村存寸搓挫措错苁茺茨重" },
+    { 'd',
+      "搭达答打大呆歹代带待贷袋戴丹单担胆旦但诞淡蛋氮当挡党荡档刀导岛倒蹈到盗道稻得德灯"
+      "登等邓低堤滴敌涤笛底抵地弟帝递第蒂典点碘电店垫淀殿雕吊钓掉爹跌迭碟蝶丁叮盯钉顶鼎"
+      "订定锭丢东冬董懂动冻洞都兜斗抖陡豆痘督毒独读堵睹杜肚度渡镀端短段断锻煅堆队对吨敦"
+      "墩蹲盾顿钝多夺朵躲惰堕靛玳黛滇癫" },
+    { 'e',
+      "俄鹅额恶饿鳄儿而尔耳二贰恩蒽厄噁鄂萼洱" },
+    { 'f',
+      "发乏伐罚阀法帆番翻凡矾烦繁反返犯泛饭范贩方芳防妨房肪仿访纺放飞非啡肥匪肺废沸费分"
+      "芬吩纷酚坟焚粉份奋愤粪丰风枫封疯峰锋蜂冯逢缝凤奉佛否夫肤孵敷扶服伏氟浮符幅福辐抚"
+      "斧府俯辅腑腐父付妇负附复赴副傅富赋腹覆呋茯麸芙蝠砜钒菲" },
+    { 'g',
+      "该改钙盖溉干甘杆肝柑竿赶敢感橄刚岗纲钢缸港杠高膏糕搞稿告哥胳鸽割歌阁革格葛隔个各"
+      "给根跟更耕庚羹梗工弓公功攻供宫恭汞巩拱共贡勾沟钩狗构购够估姑孤菇谷股骨鼓固故顾瓜"
+      "刮寡挂乖拐怪关观官冠馆管贯惯灌罐光广归龟规硅轨鬼癸柜贵桂滚棍锅郭国果裹过钆胍枸" },
+    { 'h',
+      "哈孩海害含函寒韩罕汉汗旱焊航毫豪好号浩耗喝合何和河核荷盒贺褐赫鹤黑痕很狠恨恒横衡"
+      "轰哄烘红宏虹洪鸿侯喉猴吼后厚候乎呼忽胡壶湖葫糊蝴虎互户护花华哗滑化划画话怀槐坏欢"
+      "环缓幻唤换患荒慌黄皇凰磺蝗簧恍晃灰恢挥辉徽回茴蛔悔毁汇会绘惠慧昏婚浑混活火伙或货"
+      "获祸霍藿琥癀" },
+    { 'j',
+      "几击饥机肌鸡积基激及吉级极即急疾集籍己挤脊计记纪技忌际剂季既济继寄加夹佳家嘉甲钾"
+      "假价驾架嫁尖坚间肩艰兼监煎拣俭茧捡减剪检简见件建剑健舰渐践鉴键箭江姜将浆僵讲奖降"
+      "酱交郊浇娇胶椒焦蕉角狡绞饺脚搅缴叫轿较教阶皆接揭街节劫杰洁结捷截姐解介戒芥界借金"
+      "津筋仅紧锦尽劲近进晋浸禁京经茎惊晶睛精井颈景警净径竞竟敬静境镜纠究久九酒旧救就舅"
+      "居拘局菊橘举矩句巨拒具俱剧据距锯聚捐卷倦绢决绝觉掘军均君菌俊峻骏桔蒺荆碱匮蕨厥咀"
+      "嚼" },
+    { 'k',
+      "咖卡开凯慨刊堪看康慷糠扛抗炕考烤靠科棵颗壳咳可渴克刻客课肯垦恳坑空孔恐控口扣枯哭"
+      "苦库裤酷夸垮块快宽款筐狂况矿框亏葵魁溃昆困扩括阔坤喹咔" },
+    { 'l',
+      "拉喇腊蜡辣来莱赖兰拦栏蓝篮览懒烂滥郎狼廊朗浪捞劳牢老姥乐勒雷蕾肋类累冷厘梨犁黎篱"
+      "离璃理锂里礼李力历厉立丽利励例隶粒俩连帘怜莲联廉镰脸练炼恋链良凉梁粮两亮辆量晾辽"
+      "疗聊寥了料列劣烈猎裂邻林临淋磷鳞灵玲凌铃陵零龄领令另溜刘流留硫琉瘤柳六龙聋笼隆垄"
+      "拢楼漏卢芦炉庐鲁陆录鹿路露驴吕旅铝履律虑率绿氯卵乱掠略伦轮论罗萝逻锣箩骡螺洛络骆"
+      "落酪镧钌苓羚藜仑岭泪" },
+    { 'm',
+      "妈麻马玛码蚂骂吗埋买迈麦卖脉蛮满曼慢漫蔓芒忙盲茫莽猫毛矛茅茂冒贸帽貌么没玫枚眉梅"
+      "媒煤霉每美镁妹门闷萌蒙盟猛锰梦孟弥迷谜米泌觅秘密蜜眠绵棉免勉面苗描秒妙庙灭民敏名"
+      "明鸣铭命摸模膜磨蘑魔抹末沫莫漠墨默谋某母亩牡姆拇木目牧墓幕慕暮穆咪嘧" },
+    { 'n',
+      "拿哪那纳钠乃奶耐男南难囊挠脑恼闹呢内嫩能尼泥你拟逆年念娘酿鸟尿捏您宁凝牛扭纽农浓"
+      "脓弄奴努怒女暖挪诺懦萘镍钕柠脲" },
+    { 'o',
+      "哦欧殴偶藕鸥噢" },
+    { 'p',
+      "爬帕怕拍排牌派攀盘判叛盼庞旁胖膀抛炮袍跑泡培赔佩配喷盆朋棚蓬硼鹏膨捧碰批披劈皮疲"
+      "脾匹屁譬片偏篇骗飘漂瓢票拼贫频品平评凭苹屏瓶萍坡泼婆迫破剖扑铺葡蒲朴普谱浦瀑哌嘌"
+      "枇杷珀砒潘" },
+    { 'q',
+      "七妻栖期欺漆齐其奇歧骑棋旗企启起气弃汽器契砌千迁牵铅谦签前钱钳潜浅遣欠枪腔强墙抢"
+      "敲桥瞧巧切茄且窃亲侵秦琴禽勤青轻氢倾清情晴请庆穷丘秋求球区曲驱屈躯趋渠取去趣圈全"
+      "权泉拳犬劝券缺却雀确鹊群裙芩芪芡茜羟醌嗪祛羌翘荞" },
+    { 'r',
+      "然燃染嚷壤让饶扰绕惹热人仁忍认任刃韧扔仍日绒荣容溶熔融柔揉肉如儒乳辱入软锐瑞润若"
+      "弱蓉茸" },
+    { 's',
+      "撒洒萨塞腮赛三伞散桑嗓丧扫嫂色涩森僧杀沙纱砂傻啥筛晒山删衫闪陕善伤商赏上尚烧梢稍"
+      "少绍哨舌蛇舍设社射涉摄申伸身深参神审婶肾甚渗慎升生声牲胜绳省圣盛剩尸失师诗施湿十"
+      "什石时识实拾食蚀史使始驶士氏世市示式事侍势视试饰室是适逝释收手守首寿受兽售授瘦书"
+      "叔殊梳疏舒输蔬熟暑署鼠属束述树竖数刷耍衰摔甩帅双霜爽谁水睡税顺瞬说司丝私思斯撕死"
+      "四寺似饲松宋送颂搜艘苏俗诉肃素速宿塑酸蒜算虽随岁碎穗孙损笋缩所索锁杉芍麝蜀羧噻栓"
+      "嗽莎鲨疝扇蛸虱狮蓍薯锶髓" },
+    { 't',
+      "他它她塔獭踏胎台抬太态泰酞贪摊滩坛谈痰坦毯叹炭探碳汤唐堂塘糖躺烫趟涛掏逃桃陶淘萄"
+      "讨套特疼腾藤梯踢提题蹄体替天添田甜填调挑条跳贴铁厅听庭停挺艇通同桐铜童酮统桶筒痛"
+      "偷头投透突图徒涂途屠土吐兔团推腿退吞屯托拖脱驼妥拓唾钛铊锑萜烃菟葶汀" },
+    { 'w',
+      "挖哇蛙娃瓦袜歪外弯湾丸完玩顽晚碗万汪亡王网往忘旺望危威微为违围唯维伟伪尾纬委卫未"
+      "位味胃喂温文纹闻蚊稳问翁窝我沃卧握乌污屋无吴五午武舞务物误悟雾烷戊钨蜈芜瘟肟" },
+    { 'x',
+      "夕西吸希析息牺悉惜稀溪锡熙嘻膝习席袭洗喜戏系细虾瞎峡狭霞下吓夏仙先纤鲜闲弦贤咸衔"
+      "嫌显险县现线限宪陷献腺乡相香箱详祥享响想向项象像橡削消宵萧硝销小晓孝效校笑些歇协"
+      "邪胁斜携鞋写泄泻卸屑械谢心辛欣新薪信兴星腥刑行形型醒杏幸性姓凶兄胸雄熊休修羞朽秀"
+      "袖绣锈须虚需徐许序叙绪续蓄宣悬旋选穴学雪血寻巡询循训讯迅逊昔硒烯酰氙锌溴缬玄薰熏"
+      "苋逍" },
+    { 'y',
+      "压呀押鸦鸭牙芽崖哑雅亚咽烟淹延严言岩沿炎研盐颜衍掩眼演厌宴艳验焰雁燕央羊阳杨洋仰"
+      "养氧痒样腰邀窑谣摇遥咬药要耀爷也冶野业叶页夜液一伊衣医依仪宜姨移遗疑乙已以蚁椅义"
+      "亿忆艺议亦异役抑译易疫益谊意毅翼因阴音银引饮隐印应英婴樱鹰迎营蝇赢影映硬哟拥永泳"
+      "勇涌用优忧幽悠尤由犹油游友有又右幼诱于予余鱼娱渔愉与宇羽雨语玉育郁狱浴预域欲遇喻"
+      "御寓裕愈誉冤元园员原圆援缘源远怨院愿约月岳钥悦阅跃越云匀允运晕孕蕴韵芫茵薏罂芋胰"
+      "溢吲萤柚鸢芸扬" },
+    { 'z',
+      "扎杂灾栽载再在咱暂赞脏葬藏遭糟早枣澡灶皂造噪燥则择泽责贼怎增赠渣闸眨炸榨摘宅窄债"
+      "寨沾粘展站占战张章涨掌丈帐胀障招找召兆照罩遮折哲者这浙针侦珍真诊枕阵振镇震争征挣"
+      "睁蒸整正证郑政症之支汁芝枝知肢织脂蜘执直值职植殖止只旨址纸指至志制治质致秩智置中"
+      "忠终钟肿种仲众舟州周洲粥轴肘皱昼骤朱株珠猪蛛竹烛逐主煮嘱住助注驻柱祝著筑抓爪专砖"
+      "转赚庄装壮状撞追准捉桌着资姿滋子紫籽自字宗综棕踪总纵走奏租足族阻组祖钻嘴最罪醉尊"
+      "遵昨左作坐座做唑甾樟仔栀蛭梓枳佐术" },
+};
+
+uint32_t nextCodePoint(const char *&p) {
+    unsigned char c = static_cast<unsigned char>(*p);
+    if (c < 0x80) { ++p; return c; }
+    int extra = (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : 3;
+    uint32_t cp = c & (0x3F >> extra);
+    ++p;
+    for (int i = 0; i < extra && *p; ++i, ++p) cp = (cp << 6) | (static_cast<unsigned char>(*p) & 0x3F);
+    return cp;
+}
+
+const std::unordered_map<uint32_t, char> &initialTable() {
+    static const std::unordered_map<uint32_t, char> table = [] {
+        std::unordered_map<uint32_t, char> m;
+        for (const auto &g : kGroups)
+            for (const char *p = g.chars; *p; ) m.emplace(nextCodePoint(p), g.initial);
+        return m;
+    }();
+    return table;
+}
+
+} // namespace
+
+char pinyinInitial(uint32_t cp) {
+    if (cp < 0x80) {
+        if (cp >= 'A' && cp <= 'Z') return static_cast<char>(cp - 'A' + 'a');
+        if ((cp >= 'a' && cp <= 'z') || (cp >= '0' && cp <= '9')) return static_cast<char>(cp);
+        return 0;
+    }
+    const auto &table = initialTable();
+    auto it = table.find(cp);
+    return it == table.end() ? 0 : it->second;
+}
@@ -0,0 +1,10 @@
+#ifndef PINYIN_H
+#define PINYIN_H
+
+#include <cstdint>
+
+// 汉字的拼音首字母（小写）；ASCII 字母转小写、数字原样返回；表中没有的字符与其他符号返回 0。
+// 映射表随程序编译在 pinyin.cpp 中，不依赖外部文件
+char pinyinInitial(uint32_t cp);
+
+#endif // PINYIN_H
@@ -0,0 +1,138 @@
+#include "reconcile.h"
+#include "sales_archive.h"
+#include <algorithm>
+#include <climits>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+void addRow(SkuTally &t, std::string_view type, long long qty, long long rows) {
+    if (type == "SALE" || (type.empty() && qty >= 0)) t.sold += qty;
+    else if (type == "RETURN") t.returned += qty;
+    else if (type == "WASTAGE") t.wasted += qty;
+    else { t.adjusted += qty; t.adjustedRows += rows; }
+    t.rows += rows;
+}
+
+void merge(SkuTally &into, const SkuTally &from) {
+    into.sold += from.sold;
+    into.returned += from.returned;
+    into.wasted += from.wasted;
+    into.adjusted += from.adjusted;
+    into.adjustedRows += from.adjustedRows;
+    into.rows += from.rows;
+}
+
+int clampInt(long long v) {
+    if (v < 0) return 0;
+    return v > INT_MAX ? INT_MAX : static_cast<int>(v);
+}
+
+std::string sqlQuote(const std::string &s) {
+    std::string out = "'";
+    for (char c : s) { if (c == '\'') out += '\''; out += c; }
+    return out + "'";
+}
+
+} // namespace
+
+ReconcileReport reconcileSales(SalesScanEngine &engine, const std::vector<Drug> &drugs,
+                               const std::function<long long(const std::string &)> &lotStock, const SalesArchive *archive) {
+    ReconcileReport rep;
+    rep.drugs = static_cast<long long>(drugs.size());
+    // 名称 -> 目录下标（重名时取第一条）；行循环只做 string_view 查表
+    std::unordered_map<std::string_view, size_t> index;
+    index.reserve(drugs.size());
+    for (size_t i = 0; i < drugs.size(); ++i) index.emplace(std::string_view(drugs[i].name), i);
+
+    // 每个工作线程只记它扫到的药品（稀疏），合并时只处理这些条目，内存与合并时间不随线程数×目录规模增长
+    struct Partial {
+        std::unordered_map<size_t, SkuTally> known;
+        std::unordered_map<std::string, SkuTally> unknown;
+    };
+    std::vector<Partial> partials(static_cast<size_t>(engine.threads()));
+    rep.complete = engine.scan([&](int worker, SalesCursor &cur) {
+        Partial &local = partials[static_cast<size_t>(worker)];
+        while (cur.next()) {
+            const char *name = cur.drugName();
+            auto it = index.find(std::string_view(name));
+            SkuTally &t = it != index.end() ? local.known[it->second] : local.unknown[name];
+            addRow(t, cur.type(), cur.quantity(), 1);
+        }
+    }, rep.scan);
+    // 扫描不完整时不给出修复计划（否则会把未扫到的销量“修复”掉）
+    if (!rep.complete) return rep;
+    struct {
+        std::vector<SkuTally> known;
+        std::unordered_map<std::string, SkuTally> unknown;
+    } all;
+    all.known.resize(drugs.size());
+    for (auto &p : partials) {
+        for (const auto &kv : p.known) merge(all.known[kv.first], kv.second);
+        for (const auto &kv : p.unknown) merge(all.unknown[kv.first], kv.second);
+        p = Partial();
+    }
+    for (const auto &t : all.known) rep.scan.rows += t.rows;
+    for (const auto &kv : all.unknown) rep.scan.rows += kv.second.rows;
+
+    if (archive) {
+        archive->forEachSummary([&](const SalesArchive::SummaryEntry &e) {
+            auto it = index.find(std::string_view(*e.drugName));
+            SkuTally &t = it != index.end() ? all.known[it->second] : all.unknown[*e.drugName];
+            addRow(t, *e.type, e.quantity, e.rows);
+            rep.scan.archivedRows += e.rows;
+        });
+        rep.scan.segments = static_cast<int>(archive->segments().size());
+    }
+
+    for (size_t i = 0; i < drugs.size(); ++i) {
+        const Drug &d = drugs[i];
+        merge(rep.total, all.known[i]);
+        // 重名药品的流水只计在第一条上，其余按无流水核对
+        const SkuTally tally = index[std::string_view(d.name)] == i ? all.known[i] : SkuTally();
+        ReconcileItem item;
+        item.name = d.name;
+        item.tally = tally;
+        item.catalogSold = d.totalSold;
+        item.catalogStock = d.stock;
+        item.lotStock = lotStock(d.name);
+        if (item.lotStock < 0) rep.noLots++;
+        // 旧版调整流水可能是退货也可能是报损，按哪种计都会改错销量：单独列出，整种药品不修复
+        if (tally.adjustedRows > 0) {
+            item.stockMismatch = item.lotStock >= 0 && item.lotStock != d.stock;
+            rep.unresolved.push_back(std::move(item));
+            continue;
+        }
+        if (tally.net() < 0) rep.negativeNet++;
+        item.soldMismatch = d.totalSold != clampInt(tally.net());
+        item.stockMismatch = item.lotStock >= 0 && item.lotStock != d.stock;
+        if (!item.soldMismatch && !item.stockMismatch) continue;
+        DrugRepair r;
+        r.name = d.name;
+        r.oldSold = d.totalSold;
+        r.newSold = item.soldMismatch ? clampInt(tally.net()) : d.totalSold;
+        r.oldStock = d.stock;
+        r.newStock = item.stockMismatch ? clampInt(item.lotStock) : d.stock;
+        rep.plan.push_back(r);
+        rep.mismatches.push_back(std::move(item));
+    }
+    for (auto &kv : all.unknown) {
+        merge(rep.total, kv.second);
+        rep.unknown.emplace_back(kv.first, kv.second);
+    }
+    std::sort(rep.unknown.begin(), rep.unknown.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    return rep;
+}
+
+std::string repairPlanSql(const std::vector<DrugRepair> &plan) {
+    std::ostringstream os;
+    os << "BEGIN TRANSACTION;\n";
+    for (const auto &r : plan) {
+        os << "UPDATE drugs SET total_sold = " << r.newSold << ", stock = " << r.newStock
+           << " WHERE name = " << sqlQuote(r.name) << " AND total_sold = " << r.oldSold << " AND stock = " << r.oldStock << ";\n";
+    }
+    os << "COMMIT;\n";
+    return os.str();
+}
@@ -0,0 +1,55 @@
+#ifndef RECONCILE_H
+#define RECONCILE_H
+
+#include "database.h"
+#include "sales_scan.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// 单个药品在流水中按类型的合计（数量为库中带符号的值：SALE 为正，RETURN/WASTAGE 为负；
+// ADJ 及其他类型为旧库遗留的调整，退货与报损无法区分，不计入净销量，单独统计）
+struct SkuTally {
+    long long sold = 0;
+    long long returned = 0;
+    long long wasted = 0;
+    long long adjusted = 0;
+    long long adjustedRows = 0;
+    long long rows = 0;
+    long long net() const { return sold + returned; }
+};
+
+// 账面与流水不一致的药品
+struct ReconcileItem {
+    std::string name;
+    SkuTally tally;
+    int catalogSold = 0;
+    int catalogStock = 0;
+    long long lotStock = -1;     // 批次数量之和，-1 表示没有批次（不核对库存）
+    bool soldMismatch = false;   // totalSold != max(0, 净销量)
+    bool stockMismatch = false;  // stock != 批次合计
+};
+
+struct ReconcileReport {
+    bool complete = true;        // sales 扫描失败时为 false，此时其余字段无意义
+    long long drugs = 0;
+    long long noLots = 0;        // 没有批次、未核对库存的药品数
+    long long negativeNet = 0;   // 退货多于销售（净销量 < 0，按 0 修复）的药品数
+    SkuTally total;              // 全部流水合计（含目录外药品）
+    ScanStats scan;              // sales 表扫描（rows 为行数），archivedRows 为归档段中的行数
+    std::vector<ReconcileItem> mismatches;                 // 按药品在目录中的顺序
+    std::vector<std::pair<std::string, SkuTally>> unknown; // 流水中有、目录中没有的药品（按名称），无法修复
+    std::vector<ReconcileItem> unresolved;                 // 有旧版调整流水（ADJ）的药品：销量无法核对，不列入修复计划
+    std::vector<DrugRepair> plan;                          // 与 mismatches 一一对应
+};
+
+// 账实核对：按 rowid 区间并行扫描一遍 sales（归档月份用段头的按药品、类型合计），按药品分别累计
+// 销售/退货/报损/调整，与目录中的 totalSold 比较；库存与 lotStock(名称) 给出的批次合计比较。
+// 按线程局部累计后合并，结果与线程数无关。扫描期间有新交易时，涉及的药品可能出现暂时的差异
+ReconcileReport reconcileSales(SalesScanEngine &engine, const std::vector<Drug> &drugs,
+                               const std::function<long long(const std::string &)> &lotStock, const SalesArchive *archive);
+
+// 修复计划的 SQL 脚本：一个事务，每条 UPDATE 以旧值为条件（核对之后又被修改的行不会被覆盖）
+std::string repairPlanSql(const std::vector<DrugRepair> &plan);
+
+#endif // RECONCILE_H
@@ -0,0 +1,388 @@
+// pharmacy_replay：回放已记录的销售流水（sales 表或 data/sales.csv），在数据库副本上
+// 驱动与菜单相同的销售/退货/报损逻辑，统计吞吐与延迟分位数，并在结束时核对库存。
+//
+// 用法：pharmacy_replay [--db 源数据库] [--csv 流水文件] [--work 工作目录] [--clients N]
+//                       [--speed 倍速 | --rate 每秒笔数] [--limit 条数] [--keep-stock] [--json 文件]
+//                       [--auth 用户名:口令] [--live 共享内存段名]
+// 时序：--speed 1 按原始间隔、--speed K 加速 K 倍；--rate R 为开环固定速率；都不指定则闭环全速。
+// 开环模式下延迟从“计划发出时刻”起算，避免协调遗漏（coordinated omission）低估尾延迟。
+// --live 在回放期间发布实时计数共享内存段，可同时用 pharmacy_live 观察。
+// --auth 模拟服务端：每笔请求先校验账号（首次走 scrypt，其后命中会话缓存），校验时间计入延迟。
+#include "metrics.h"
+#include "pharmacy.h"
+#include <sqlite3.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+struct ReplayOp {
+    std::string drugName;
+    int quantity = 0;
+    long long ts = 0;   // 记录时间（秒）
+    std::string operatorName;
+    std::string type;
+};
+
+struct ReplayConfig {
+    std::string dbPath = "data/pharmacy.db";
+    std::string csvPath;
+    std::string workDir = "replay_data";
+    int clients = 1;
+    double speed = 0;   // >0 按记录时间间隔回放
+    double rate = 0;    // >0 开环固定速率
+    long long limit = 0;
+    bool keepStock = false;
+    std::string jsonPath;
+    bool auth = false;
+    std::string authUser;
+    std::string authPassword;
+    std::string liveName;
+};
+
+// 解析 YYYY-MM-DDTHH:MM:SS（或空格分隔）为自纪元起的秒数；只用于计算相对间隔，不涉及时区
+bool parseTimestamp(const std::string &s, long long &out) {
+    int y, mo, d, h = 0, mi = 0, se = 0;
+    if (std::sscanf(s.c_str(), "%d-%d-%d%*c%d:%d:%d", &y, &mo, &d, &h, &mi, &se) < 3) return false;
+    y -= mo <= 2;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(y - era * 400);
+    unsigned doy = (153 * (mo + (mo > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long long days = era * 146097 + static_cast<long long>(doe) - 719468;
+    out = days * 86400 + h * 3600 + mi * 60 + se;
+    return true;
+}
+
+std::string inferType(int qty, const std::string &type) {
+    if (!type.empty()) return type;
+    return qty >= 0 ? "SALE" : "RETURN";
+}
+
+bool loadFromDb(const std::string &path, std::vector<ReplayOp> &ops, long long limit) {
+    sqlite3 *db = nullptr;
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        std::cerr << "[回放] 打开数据库失败：" << path << "\n";
+        if (db) sqlite3_close(db);
+        return false;
+    }
+    sqlite3_stmt *stmt = nullptr;
+    bool hasType = sqlite3_prepare_v2(db, "SELECT drug_name, quantity, timestamp, operator, type FROM sales ORDER BY id", -1, &stmt, nullptr) == SQLITE_OK;
+    if (!hasType && sqlite3_prepare_v2(db, "SELECT drug_name, quantity, timestamp, operator FROM sales ORDER BY id", -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_close(db);
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW && (limit <= 0 || static_cast<long long>(ops.size()) < limit)) {
+        ReplayOp op;
+        auto text = [&](int col) { const unsigned char *t = sqlite3_column_text(stmt, col); return t ? std::string(reinterpret_cast<const char*>(t)) : std::string(); };
+        op.drugName = text(0);
+        op.quantity = sqlite3_column_int(stmt, 1);
+        parseTimestamp(text(2), op.ts);
+        op.operatorName = text(3);
+        op.type = inferType(op.quantity, hasType ? text(4) : std::string());
+        ops.push_back(op);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return true;
+}
+
+// CSV 表头：drug_name,quantity,timestamp,operator[,type]
+bool loadFromCsv(const std::string &path, std::vector<ReplayOp> &ops, long long limit) {
+    std::ifstream in(path);
+    if (!in) { std::cerr << "[回放] 无法打开：" << path << "\n"; return false; }
+    std::string line;
+    std::getline(in, line); // 表头
+    while (std::getline(in, line) && (limit <= 0 || static_cast<long long>(ops.size()) < limit)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        std::vector<std::string> f;
+        std::stringstream ss(line); std::string item;
+        while (std::getline(ss, item, ',')) f.push_back(item);
+        if (f.size() < 4) continue;
+        ReplayOp op;
+        op.drugName = f[0];
+        try { op.quantity = std::stoi(f[1]); } catch (...) { continue; }
+        parseTimestamp(f[2], op.ts);
+        op.operatorName = f[3];
+        op.type = inferType(op.quantity, f.size() >= 5 ? f[4] : std::string());
+        ops.push_back(op);
+    }
+    return true;
+}
+
+bool parseArgs(int argc, char **argv, ReplayConfig &cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&](std::string &out) { if (i + 1 >= argc) return false; out = argv[++i]; return true; };
+        std::string v;
+        try {
+            if (a == "--db" && next(v)) cfg.dbPath = v;
+            else if (a == "--csv" && next(v)) cfg.csvPath = v;
+            else if (a == "--work" && next(v)) cfg.workDir = v;
+            else if (a == "--clients" && next(v)) cfg.clients = std::stoi(v);
+            else if (a == "--speed" && next(v)) cfg.speed = std::stod(v);
+            else if (a == "--rate" && next(v)) cfg.rate = std::stod(v);
+            else if (a == "--limit" && next(v)) cfg.limit = std::stoll(v);
+            else if (a == "--keep-stock") cfg.keepStock = true;
+            else if (a == "--json" && next(v)) cfg.jsonPath = v;
+            else if (a == "--live" && next(v)) cfg.liveName = v;
+            else if (a == "--auth" && next(v)) {
+                auto colon = v.find(':');
+                if (colon == std::string::npos) return false;
+                cfg.auth = true;
+                cfg.authUser = v.substr(0, colon);
+                cfg.authPassword = v.substr(colon + 1);
+            }
+            else return false;
+        } catch (...) {
+            return false;
+        }
+    }
+    return cfg.clients > 0 && !(cfg.speed > 0 && cfg.rate > 0);
+}
+
+// 回放前把每种药的库存加上其流水中的总出库量，使历史流水在当前库存上可完整执行；
+// 已有批次的药品补到最晚到期的批次上（尚未迁移批次的药品在打开时按补足后的库存迁移）
+bool topUpStock(const std::string &dbPath, const std::vector<ReplayOp> &ops) {
+    std::unordered_map<std::string, long long> outflow;
+    for (const auto &op : ops) {
+        if (op.type == "SALE" && op.quantity > 0) outflow[op.drugName] += op.quantity;
+        else if (op.type == "WASTAGE" && op.quantity < 0) outflow[op.drugName] += -op.quantity;
+    }
+    sqlite3 *db = nullptr;
+    if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) { if (db) sqlite3_close(db); return false; }
+    sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    sqlite3_stmt *stmt = nullptr;
+    sqlite3_stmt *lotStmt = nullptr;
+    sqlite3_prepare_v2(db, "UPDATE drugs SET stock = stock + ? WHERE name = ?", -1, &stmt, nullptr);
+    // 旧库可能还没有 lots 表，此时准备失败，只调整 drugs
+    sqlite3_prepare_v2(db, "UPDATE lots SET quantity = quantity + ? WHERE id = (SELECT id FROM lots WHERE drug_name = ? "
+                           "AND quantity > 0 ORDER BY expiry_date DESC, id DESC LIMIT 1)", -1, &lotStmt, nullptr);
+    for (const auto &kv : outflow) {
+        for (sqlite3_stmt *s : { stmt, lotStmt }) {
+            if (!s) continue;
+            sqlite3_bind_int64(s, 1, kv.second);
+            sqlite3_bind_text(s, 2, kv.first.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_step(s);
+            sqlite3_reset(s);
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(lotStmt);
+    bool ok = sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK;
+    sqlite3_close(db);
+    return ok;
+}
+
+// 各药品批次数量之和（落库值），用于核对并发交易对批次的增量更新
+std::unordered_map<std::string, long long> lotTotals(const std::string &dbPath) {
+    std::unordered_map<std::string, long long> totals;
+    sqlite3 *db = nullptr;
+    if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK) {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT drug_name, SUM(quantity) FROM lots GROUP BY drug_name", -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+                totals[reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))] = sqlite3_column_int64(stmt, 1);
+            sqlite3_finalize(stmt);
+        }
+    }
+    if (db) sqlite3_close(db);
+    return totals;
+}
+
+long long countSales(const std::string &dbPath) {
+    sqlite3 *db = nullptr;
+    long long n = -1;
+    if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK) {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM sales", -1, &stmt, nullptr) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW) n = sqlite3_column_int64(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+    }
+    if (db) sqlite3_close(db);
+    return n;
+}
+
+const char *statusName(TxStatus s) {
+    switch (s) {
+        case TxStatus::Ok: return "ok";
+        case TxStatus::InvalidQuantity: return "invalid_quantity";
+        case TxStatus::NotFound: return "not_found";
+        case TxStatus::BadDate: return "bad_date";
+        case TxStatus::Expired: return "expired";
+        case TxStatus::InsufficientStock: return "insufficient_stock";
+        case TxStatus::WriteFailed: return "write_failed";
+    }
+    return "unknown";
+}
+
+// 每个客户端线程的统计，结束后合并
+struct ClientStats {
+    std::map<std::string, long long> statusCounts;
+    std::unordered_map<std::string, long long> stockDelta; // 成功交易带来的库存变化
+    long long succeeded = 0;
+    long long skipped = 0;
+    double maxLagMs = 0;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ReplayConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::cerr << "用法：pharmacy_replay [--db 源数据库] [--csv 流水文件] [--work 工作目录] [--clients N]\n"
+                  << "                       [--speed 倍速 | --rate 每秒笔数] [--limit 条数] [--keep-stock] [--json 文件]\n"
+                  << "                       [--auth 用户名:口令] [--live 共享内存段名]\n";
+        return 2;
+    }
+
+    std::vector<ReplayOp> ops;
+    bool loaded = cfg.csvPath.empty() ? loadFromDb(cfg.dbPath, ops, cfg.limit) : loadFromCsv(cfg.csvPath, ops, cfg.limit);
+    if (!loaded) return 1;
+    if (ops.empty()) { std::cout << "[回放] 没有可回放的流水。\n"; return 0; }
+
+    // 在工作副本上回放，不影响源数据库
+#ifdef _WIN32
+    _mkdir(cfg.workDir.c_str());
+#else
+    mkdir(cfg.workDir.c_str(), 0755);
+#endif
+    const std::string workDb = cfg.workDir + "/pharmacy.db";
+    std::remove(workDb.c_str());
+    {
+        SqliteDatabase src(cfg.dbPath);
+        BackupResult br;
+        if (!src.init() || !src.backupTo(workDb, 1024, 0, nullptr, br)) {
+            std::cerr << "[回放] 复制数据库失败：" << br.message << "\n";
+            return 1;
+        }
+    }
+    if (!cfg.keepStock && !topUpStock(workDb, ops)) { std::cerr << "[回放] 调整初始库存失败。\n"; return 1; }
+    long long salesBefore = countSales(workDb);
+
+    Pharmacy app(workDb);
+    if (!app.open()) { std::cerr << "[回放] 打开工作副本失败。\n"; return 1; }
+    std::unordered_map<std::string, int> initialStock;
+    for (const auto &d : app.snapshotDrugs()) initialStock[d.name] = d.stock;
+    if (!cfg.liveName.empty()) {
+        std::string error;
+        if (!app.publishLiveCounters(cfg.liveName, error)) { std::cerr << "[回放] 发布实时计数失败：" << error << "\n"; return 1; }
+    }
+
+    LatencyHistogram latency;
+    std::vector<ClientStats> stats(static_cast<size_t>(cfg.clients));
+    const long long ts0 = ops.front().ts;
+    const auto start = std::chrono::steady_clock::now();
+
+    auto worker = [&](int cid) {
+        ClientStats &st = stats[static_cast<size_t>(cid)];
+        for (size_t i = static_cast<size_t>(cid); i < ops.size(); i += static_cast<size_t>(cfg.clients)) {
+            const ReplayOp &op = ops[i];
+            auto intended = std::chrono::steady_clock::now();
+            bool openLoop = false;
+            if (cfg.rate > 0) {
+                intended = start + std::chrono::nanoseconds(static_cast<long long>(static_cast<double>(i) * 1e9 / cfg.rate));
+                openLoop = true;
+            } else if (cfg.speed > 0) {
+                intended = start + std::chrono::nanoseconds(static_cast<long long>(static_cast<double>(op.ts - ts0) * 1e9 / cfg.speed));
+                openLoop = true;
+            }
+            if (openLoop) {
+                std::this_thread::sleep_until(intended);
+                double lag = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - intended).count();
+                if (lag > st.maxLagMs) st.maxLagMs = lag;
+            }
+            if (cfg.auth) {
+                User user;
+                if (!app.authenticate(cfg.authUser, cfg.authPassword, user)) { st.statusCounts["AuthFailed"]++; continue; }
+            }
+            TxResult r;
+            int delta = 0;
+            if (op.type == "SALE" && op.quantity > 0) {
+                r = app.sellDrug(op.drugName, op.quantity, op.operatorName);
+                delta = -op.quantity;
+            } else if (op.type == "RETURN" && op.quantity < 0) {
+                r = app.returnDrug(op.drugName, -op.quantity, op.operatorName);
+                delta = -op.quantity;
+            } else if (op.type == "WASTAGE" && op.quantity < 0) {
+                r = app.wasteDrug(op.drugName, -op.quantity, op.operatorName);
+                delta = op.quantity;
+            } else {
+                st.skipped++; // ADJ 等无法对应到具体操作的记录
+                continue;
+            }
+            auto done = std::chrono::steady_clock::now();
+            latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(done - intended).count()));
+            st.statusCounts[statusName(r.status)]++;
+            if (r.status == TxStatus::Ok) { st.succeeded++; st.stockDelta[op.drugName] += delta; }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int c = 0; c < cfg.clients; ++c) threads.emplace_back(worker, c);
+    for (auto &t : threads) t.join();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // 合并统计并核对：最终库存 = 初始库存 + 成功交易的库存变化，且不为负；新增流水条数 = 成功交易数
+    ClientStats total;
+    for (const auto &st : stats) {
+        for (const auto &kv : st.statusCounts) total.statusCounts[kv.first] += kv.second;
+        for (const auto &kv : st.stockDelta) total.stockDelta[kv.first] += kv.second;
+        total.succeeded += st.succeeded;
+        total.skipped += st.skipped;
+        if (st.maxLagMs > total.maxLagMs) total.maxLagMs = st.maxLagMs;
+    }
+    long long mismatches = 0, negative = 0, lotMismatches = 0;
+    auto persistedLots = lotTotals(workDb);
+    for (const auto &d : app.snapshotDrugs()) {
+        long long expected = initialStock[d.name] + (total.stockDelta.count(d.name) ? total.stockDelta[d.name] : 0);
+        if (d.stock != expected) mismatches++;
+        if (d.stock < 0) negative++;
+        auto it = persistedLots.find(d.name);
+        if (it != persistedLots.end() && it->second != d.stock) lotMismatches++;
+    }
+    long long appended = countSales(workDb) - salesBefore;
+    bool correct = mismatches == 0 && negative == 0 && lotMismatches == 0 && appended == total.succeeded;
+
+    long long executed = static_cast<long long>(latency.count());
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "\n=== 回放结果 ===\n";
+    std::cout << "流水条数：" << ops.size() << "，执行：" << executed << "，跳过：" << total.skipped
+              << "，客户端：" << cfg.clients << "\n";
+    std::cout << "模式：" << (cfg.rate > 0 ? "开环 " + std::to_string(cfg.rate) + " 笔/秒"
+                              : cfg.speed > 0 ? std::to_string(cfg.speed) + " 倍速" : std::string("闭环全速")) << "\n";
+    std::cout << "耗时：" << wall << " s，吞吐：" << (wall > 0 ? executed / wall : 0) << " 笔/秒\n";
+    std::cout << "延迟(ms)：p50=" << latency.percentile(0.50) / 1e6 << " p99=" << latency.percentile(0.99) / 1e6
+              << " p999=" << latency.percentile(0.999) / 1e6 << " max=" << latency.max() / 1e6 << "\n";
+    if (cfg.rate > 0 || cfg.speed > 0) std::cout << "最大调度滞后：" << total.maxLagMs << " ms\n";
+    if (cfg.auth) std::cout << "账号校验：会话缓存命中 " << app.authSessions().hits() << " 次，完整校验 " << app.authSessions().misses() << " 次\n";
+    std::cout << "结果分布：";
+    for (const auto &kv : total.statusCounts) std::cout << kv.first << "=" << kv.second << " ";
+    std::cout << "\n库存核对：" << (correct ? "通过" : "失败") << "（库存不符 " << mismatches << " 种，负库存 " << negative
+              << " 种，批次落库不符 " << lotMismatches << " 种，新增流水 " << appended << " / 成功交易 " << total.succeeded << "）\n";
+
+    if (!cfg.jsonPath.empty()) {
+        std::ofstream js(cfg.jsonPath, std::ios::app);
+        js << std::setprecision(6) << "{\"records\":" << ops.size() << ",\"executed\":" << executed
+           << ",\"clients\":" << cfg.clients << ",\"speed\":" << cfg.speed << ",\"rate\":" << cfg.rate
+           << ",\"wall_s\":" << wall << ",\"throughput\":" << (wall > 0 ? executed / wall : 0)
+           << ",\"p50_ms\":" << latency.percentile(0.50) / 1e6 << ",\"p99_ms\":" << latency.percentile(0.99) / 1e6
+           << ",\"p999_ms\":" << latency.percentile(0.999) / 1e6 << ",\"max_ms\":" << latency.max() / 1e6
+           << ",\"succeeded\":" << total.succeeded << ",\"stock_check\":" << (correct ? "true" : "false") << "}\n";
+    }
+    return correct ? 0 : 1;
+}
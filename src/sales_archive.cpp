@@ -0,0 +1,479 @@
+#include "sales_archive.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kMagic[4] = { 'P', 'H', 'S', 'A' };
+const uint8_t kVersion = 1;
+
+// ---- 编码 ----
+
+void putVarint(std::string &out, uint64_t v) {
+    while (v >= 0x80) { out.push_back(static_cast<char>((v & 0x7F) | 0x80)); v >>= 7; }
+    out.push_back(static_cast<char>(v));
+}
+
+uint64_t zigzag(long long v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+long long unzigzag(uint64_t v) { return static_cast<long long>(v >> 1) ^ -static_cast<long long>(v & 1); }
+
+void putString(std::string &out, const std::string &s) {
+    putVarint(out, s.size());
+    out += s;
+}
+
+// 读游标：越界时置 ok=false，之后的读取都返回 0
+struct Reader {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool ok = true;
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) { ok = false; return 0; }
+            uint8_t b = *p++;
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+    std::string str() {
+        uint64_t n = varint();
+        if (!ok || static_cast<uint64_t>(end - p) < n) { ok = false; return std::string(); }
+        std::string s(reinterpret_cast<const char *>(p), static_cast<size_t>(n));
+        p += n;
+        return s;
+    }
+};
+
+uint64_t fnv1a(const char *data, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; ++i) { h ^= static_cast<uint8_t>(data[i]); h *= 1099511628211ULL; }
+    return h;
+}
+
+// ---- 时间戳：YYYY-MM-DDTHH:MM:SS <-> 自纪元起的秒数（公历，按 UTC 计算，不涉及时区） ----
+
+long long daysFromCivil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const long long era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<long long>(doe) - 719468;
+}
+
+void civilFromDays(long long z, int &y, unsigned &m, unsigned &d) {
+    z += 719468;
+    const long long era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int>(static_cast<long long>(yoe) + era * 400 + (m <= 2));
+}
+
+bool digitsAt(const std::string &s, size_t pos, size_t n, int &out) {
+    out = 0;
+    for (size_t i = pos; i < pos + n; ++i) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        out = out * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+// 解析 YYYY-MM-DD（withTime 时为 YYYY-MM-DDTHH:MM:SS），要求各字段在合法范围内
+bool parseTs(const std::string &s, bool withTime, long long &out) {
+    if (s.size() != (withTime ? 19u : 10u) || s[4] != '-' || s[7] != '-') return false;
+    int y, mo, d, h = 0, mi = 0, se = 0;
+    if (!digitsAt(s, 0, 4, y) || !digitsAt(s, 5, 2, mo) || !digitsAt(s, 8, 2, d)) return false;
+    if (y < 1970 || mo < 1 || mo > 12 || d < 1 || d > 31) return false;
+    if (withTime) {
+        if (s[10] != 'T' || s[13] != ':' || s[16] != ':') return false;
+        if (!digitsAt(s, 11, 2, h) || !digitsAt(s, 14, 2, mi) || !digitsAt(s, 17, 2, se)) return false;
+        if (h > 23 || mi > 59 || se > 59) return false;
+    }
+    const long long days = daysFromCivil(y, static_cast<unsigned>(mo), static_cast<unsigned>(d));
+    int cy; unsigned cm, cd;
+    civilFromDays(days, cy, cm, cd);
+    if (cy != y || static_cast<int>(cm) != mo || static_cast<int>(cd) != d) return false; // 如 02-30
+    out = days * 86400 + h * 3600 + mi * 60 + se;
+    return true;
+}
+
+std::string formatTs(long long t) {
+    long long days = t / 86400, secs = t % 86400;
+    int y; unsigned m, d;
+    civilFromDays(days, y, m, d);
+    char buf[24];
+    std::snprintf(buf, sizeof(buf), "%04d-%02u-%02uT%02lld:%02lld:%02lld", y, m, d, secs / 3600, secs / 60 % 60, secs % 60);
+    return buf;
+}
+
+bool readFile(const std::string &path, std::string &out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream buf;
+    buf << in.rdbuf();
+    out = buf.str();
+    return true;
+}
+
+uint32_t dictId(std::unordered_map<std::string, uint32_t> &ids, std::vector<std::string> &dict, const std::string &s) {
+    auto it = ids.find(s);
+    if (it != ids.end()) return it->second;
+    const uint32_t id = static_cast<uint32_t>(dict.size());
+    ids.emplace(s, id);
+    dict.push_back(s);
+    return id;
+}
+
+// 在段字典中查找筛选值；空筛选返回 true 且 id 为 -1
+bool lookupFilter(const std::vector<std::string> &dict, const std::string &value, long long &id) {
+    id = -1;
+    if (value.empty()) return true;
+    for (size_t i = 0; i < dict.size(); ++i) if (dict[i] == value) { id = static_cast<long long>(i); return true; }
+    return false;
+}
+
+} // namespace
+
+bool SalesArchive::isArchivable(const std::string &timestamp) {
+    long long t;
+    return parseTs(timestamp, true, t);
+}
+
+bool SalesArchive::writeSegment(const std::string &path, const std::vector<SaleRecord> &rows, SegmentInfo &info, std::string &error) {
+    if (rows.empty()) { error = "没有可归档的流水"; return false; }
+    std::vector<std::string> drugs, operators, types;
+    std::unordered_map<std::string, uint32_t> drugIds, opIds, typeIds;
+    std::map<std::pair<uint32_t, uint32_t>, std::pair<long long, long long>> sums; // (药品, 类型) -> (数量, 行数)
+    std::vector<long long> ts(rows.size());
+    info = SegmentInfo();
+    info.month = rows.front().timestamp.substr(0, 7);
+    info.rows = static_cast<long long>(rows.size());
+    info.minId = info.maxId = rows.front().id;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const SaleRecord &r = rows[i];
+        if (!parseTs(r.timestamp, true, ts[i]) || r.timestamp.compare(0, 7, info.month) != 0) {
+            error = "流水 " + std::to_string(r.id) + " 的时间戳不能归档：" + r.timestamp;
+            return false;
+        }
+        if (i > 0 && (ts[i] < ts[i - 1] || (ts[i] == ts[i - 1] && r.id <= rows[i - 1].id))) { error = "流水未按时间排序"; return false; }
+        info.minId = std::min(info.minId, r.id);
+        info.maxId = std::max(info.maxId, r.id);
+    }
+    info.minTs = ts.front();
+    info.maxTs = ts.back();
+
+    std::string payload;
+    payload.reserve(rows.size() * 8);
+    long long prevTs = info.minTs, prevId = info.minId;
+    for (size_t i = 0; i < rows.size(); ++i) { putVarint(payload, static_cast<uint64_t>(ts[i] - prevTs)); prevTs = ts[i]; }
+    for (const auto &r : rows) { putVarint(payload, zigzag(r.id - prevId)); prevId = r.id; }
+    for (const auto &r : rows) putVarint(payload, dictId(drugIds, drugs, r.drugName));
+    for (const auto &r : rows) putVarint(payload, dictId(opIds, operators, r.operatorName));
+    for (const auto &r : rows) {
+        const uint32_t type = dictId(typeIds, types, r.type);
+        putVarint(payload, type);
+        auto &s = sums[std::make_pair(drugIds[r.drugName], type)];
+        s.first += r.quantity;
+        s.second++;
+    }
+    for (const auto &r : rows) putVarint(payload, zigzag(r.quantity));
+
+    std::string header;
+    putString(header, info.month);
+    putVarint(header, static_cast<uint64_t>(info.rows));
+    putVarint(header, static_cast<uint64_t>(info.minId));
+    putVarint(header, static_cast<uint64_t>(info.maxId));
+    putVarint(header, static_cast<uint64_t>(info.minTs));
+    putVarint(header, static_cast<uint64_t>(info.maxTs));
+    for (const auto *dict : { &drugs, &operators, &types }) {
+        putVarint(header, dict->size());
+        for (const auto &s : *dict) putString(header, s);
+    }
+    putVarint(header, sums.size());
+    for (const auto &kv : sums) {
+        putVarint(header, kv.first.first);
+        putVarint(header, kv.first.second);
+        putVarint(header, zigzag(kv.second.first));
+        putVarint(header, static_cast<uint64_t>(kv.second.second));
+    }
+
+    std::string file(kMagic, 4);
+    file.push_back(static_cast<char>(kVersion));
+    putVarint(file, header.size());
+    file += header;
+    putVarint(file, payload.size());
+    file += payload;
+    const uint64_t sum = fnv1a(file.data(), file.size());
+    for (int i = 0; i < 8; ++i) file.push_back(static_cast<char>(sum >> (8 * i)));
+    info.bytes = static_cast<long long>(file.size());
+    auto slash = path.find_last_of("/\\");
+    info.file = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    // 写临时文件并落盘后再改名：调用方随后才在事务中删除 sales 行
+    if (slash != std::string::npos) {
+#ifdef _WIN32
+        _mkdir(path.substr(0, slash).c_str());
+#else
+        mkdir(path.substr(0, slash).c_str(), 0755);
+#endif
+    }
+    const std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) { error = "无法写入 " + tmp; return false; }
+    bool ok = std::fwrite(file.data(), 1, file.size(), f) == file.size() && std::fflush(f) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = std::fclose(f) == 0 && ok;
+    std::remove(path.c_str());
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        error = "写入段文件失败：" + path;
+        return false;
+    }
+    return true;
+}
+
+void SalesArchive::clear() {
+    dir.clear();
+    segs.clear();
+    infos.clear();
+}
+
+// 只读取段头（字典与合计），行数据在查询时再解码
+bool SalesArchive::open(const std::string &directory, const std::string &manifest, std::string &error) {
+    clear();
+    dir = directory;
+    std::istringstream lines(manifest);
+    std::string name;
+    while (std::getline(lines, name)) {
+        if (name.empty()) continue;
+        const std::string path = dir + "/" + name;
+        std::ifstream in(path, std::ios::binary);
+        char prefix[16] = {};
+        in.read(prefix, sizeof(prefix));
+        const std::streamsize got = in.gcount();
+        if (got < 6 || std::memcmp(prefix, kMagic, 4) != 0 || static_cast<uint8_t>(prefix[4]) != kVersion) {
+            error = "归档段缺失或格式不符：" + path;
+            clear();
+            return false;
+        }
+        Reader lr{ reinterpret_cast<const uint8_t *>(prefix) + 5, reinterpret_cast<const uint8_t *>(prefix) + got };
+        const uint64_t headerLen = lr.varint();
+        const long long headerStart = lr.p - reinterpret_cast<const uint8_t *>(prefix);
+        std::string header(static_cast<size_t>(headerLen), '\0');
+        in.clear();
+        in.seekg(headerStart);
+        in.read(&header[0], static_cast<std::streamsize>(headerLen));
+        if (!lr.ok || in.gcount() != static_cast<std::streamsize>(headerLen)) {
+            error = "归档段头损坏：" + path;
+            clear();
+            return false;
+        }
+        Segment seg;
+        Reader r{ reinterpret_cast<const uint8_t *>(header.data()), reinterpret_cast<const uint8_t *>(header.data()) + header.size() };
+        seg.info.file = name;
+        seg.info.month = r.str();
+        seg.info.rows = static_cast<long long>(r.varint());
+        seg.info.minId = static_cast<long long>(r.varint());
+        seg.info.maxId = static_cast<long long>(r.varint());
+        seg.info.minTs = static_cast<long long>(r.varint());
+        seg.info.maxTs = static_cast<long long>(r.varint());
+        for (auto *dict : { &seg.drugs, &seg.operators, &seg.types }) {
+            const uint64_t n = r.varint();
+            for (uint64_t i = 0; i < n && r.ok; ++i) dict->push_back(r.str());
+        }
+        const uint64_t n = r.varint();
+        for (uint64_t i = 0; i < n && r.ok; ++i) {
+            Summary s;
+            s.drug = static_cast<uint32_t>(r.varint());
+            s.type = static_cast<uint32_t>(r.varint());
+            s.quantity = unzigzag(r.varint());
+            s.rows = static_cast<long long>(r.varint());
+            if (s.drug >= seg.drugs.size() || s.type >= seg.types.size()) r.ok = false;
+            seg.summary.push_back(s);
+        }
+        if (!r.ok) { error = "归档段头损坏：" + path; clear(); return false; }
+        in.seekg(0, std::ios::end);
+        seg.info.bytes = static_cast<long long>(in.tellg());
+        seg.payloadOffset = headerStart + static_cast<long long>(headerLen);
+        segs.push_back(std::move(seg));
+    }
+    // 按时间先后排列（同月多段按最小流水号）
+    std::sort(segs.begin(), segs.end(), [](const Segment &a, const Segment &b) {
+        return a.info.minTs != b.info.minTs ? a.info.minTs < b.info.minTs : a.info.minId < b.info.minId;
+    });
+    for (const auto &s : segs) infos.push_back(s.info);
+    return true;
+}
+
+long long SalesArchive::rows() const {
+    long long n = 0;
+    for (const auto &s : segs) n += s.info.rows;
+    return n;
+}
+
+long long SalesArchive::bytes() const {
+    long long n = 0;
+    for (const auto &s : segs) n += s.info.bytes;
+    return n;
+}
+
+long long SalesArchive::maxId() const {
+    long long n = 0;
+    for (const auto &s : segs) n = std::max(n, s.info.maxId);
+    return n;
+}
+
+// 读入整个段文件、核对校验和后逐列解码
+bool SalesArchive::decode(const Segment &seg, std::vector<Row> &rows) const {
+    if (decodeRows(seg, rows)) return true;
+    std::cerr << "[归档] 段文件读取或校验失败，已跳过：" << dir << "/" << seg.info.file << "\n";
+    rows.clear();
+    return false;
+}
+
+bool SalesArchive::decodeRows(const Segment &seg, std::vector<Row> &rows) const {
+    std::string file;
+    if (!readFile(dir + "/" + seg.info.file, file) || file.size() < 8) return false;
+    const size_t body = file.size() - 8;
+    uint64_t stored = 0;
+    for (int i = 0; i < 8; ++i) stored |= static_cast<uint64_t>(static_cast<uint8_t>(file[body + static_cast<size_t>(i)])) << (8 * i);
+    if (stored != fnv1a(file.data(), body) || static_cast<size_t>(seg.payloadOffset) > body) return false;
+    Reader r{ reinterpret_cast<const uint8_t *>(file.data()) + seg.payloadOffset, reinterpret_cast<const uint8_t *>(file.data()) + body };
+    r.varint(); // 负载长度
+    const size_t n = static_cast<size_t>(seg.info.rows);
+    rows.resize(n);
+    long long ts = seg.info.minTs, id = seg.info.minId;
+    for (size_t i = 0; i < n; ++i) { ts += static_cast<long long>(r.varint()); rows[i].ts = ts; }
+    for (size_t i = 0; i < n; ++i) { id += unzigzag(r.varint()); rows[i].id = id; }
+    for (size_t i = 0; i < n; ++i) rows[i].drug = static_cast<uint32_t>(r.varint());
+    for (size_t i = 0; i < n; ++i) rows[i].op = static_cast<uint32_t>(r.varint());
+    for (size_t i = 0; i < n; ++i) rows[i].type = static_cast<uint32_t>(r.varint());
+    for (size_t i = 0; i < n; ++i) rows[i].quantity = static_cast<int>(unzigzag(r.varint()));
+    if (!r.ok) return false;
+    for (const auto &row : rows)
+        if (row.drug >= seg.drugs.size() || row.op >= seg.operators.size() || row.type >= seg.types.size()) return false;
+    return true;
+}
+
+SaleRecord SalesArchive::toRecord(const Segment &seg, const Row &r) {
+    SaleRecord rec;
+    rec.drugName = seg.drugs[r.drug];
+    rec.quantity = r.quantity;
+    rec.timestamp = formatTs(r.ts);
+    rec.operatorName = seg.operators[r.op];
+    rec.type = seg.types[r.type];
+    rec.id = r.id;
+    return rec;
+}
+
+std::vector<SaleRecord> SalesArchive::query(const SalesQuery &q) const {
+    const size_t limit = static_cast<size_t>(q.limit > 0 ? q.limit : 20);
+    const bool desc = q.newestFirst;
+    // 日期条件换算为秒：timestamp >= 起始日 0 点，timestamp < 截止日次日 0 点。
+    // 与 SQL 一致：起始日无法解析时按字符串比较，截止日无法解析时 date() 为 NULL，没有记录满足
+    long long fromTs = 0, toTs = 0;
+    const bool hasFrom = !q.fromDate.empty() && parseTs(q.fromDate, false, fromTs);
+    const bool textFrom = !q.fromDate.empty() && !hasFrom;
+    const bool hasTo = !q.toDate.empty();
+    if (hasTo && !parseTs(q.toDate, false, toTs)) return {};
+    if (hasTo) toTs += 86400;
+    // 游标：规范格式时按秒比较，否则逐行格式化后按字符串比较（与 SQLite 的文本排序一致）
+    const bool paged = !q.afterTimestamp.empty();
+    long long curTs = 0;
+    const bool curNumeric = paged && parseTs(q.afterTimestamp, true, curTs);
+    auto afterCursor = [&](const Row &r) {
+        if (!paged) return true;
+        if (curNumeric) {
+            if (r.ts != curTs) return desc ? r.ts < curTs : r.ts > curTs;
+        } else {
+            int c = formatTs(r.ts).compare(q.afterTimestamp);
+            if (c != 0) return desc ? c < 0 : c > 0;
+        }
+        return desc ? r.id < q.afterId : r.id > q.afterId;
+    };
+    auto before = [desc](long long ts1, long long id1, long long ts2, long long id2) {
+        return desc ? (ts1 != ts2 ? ts1 > ts2 : id1 > id2) : (ts1 != ts2 ? ts1 < ts2 : id1 < id2);
+    };
+
+    std::vector<size_t> order(segs.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = desc ? order.size() - 1 - i : i;
+    std::vector<std::pair<Row, size_t>> found; // (行, 段下标)，按输出顺序保持有序且不超过 limit
+    std::vector<Row> rows;
+    for (size_t si : order) {
+        const Segment &seg = segs[si];
+        // 按段头的时间范围与字典跳过
+        if (hasFrom && seg.info.maxTs < fromTs) continue;
+        if (hasTo && seg.info.minTs >= toTs) continue;
+        if (curNumeric && (desc ? seg.info.minTs > curTs : seg.info.maxTs < curTs)) continue;
+        if (found.size() >= limit) {
+            const Row &last = found.back().first;
+            if (desc ? seg.info.maxTs < last.ts : seg.info.minTs > last.ts) continue;
+        }
+        long long drugId, opId, typeId;
+        if (!lookupFilter(seg.drugs, q.drugName, drugId) || !lookupFilter(seg.operators, q.operatorName, opId)
+            || !lookupFilter(seg.types, q.type, typeId)) continue;
+        if (!decode(seg, rows)) continue;
+        size_t taken = 0;
+        for (size_t k = 0; k < rows.size() && taken < limit; ++k) {
+            const Row &r = rows[desc ? rows.size() - 1 - k : k];
+            if (drugId >= 0 && r.drug != drugId) continue;
+            if (opId >= 0 && r.op != opId) continue;
+            if (typeId >= 0 && r.type != typeId) continue;
+            if (hasFrom && r.ts < fromTs) continue;
+            if (hasTo && r.ts >= toTs) continue;
+            if (textFrom && formatTs(r.ts).compare(q.fromDate) < 0) continue;
+            if (!afterCursor(r)) continue;
+            found.emplace_back(r, si);
+            ++taken;
+        }
+        std::sort(found.begin(), found.end(), [&](const auto &a, const auto &b) {
+            return before(a.first.ts, a.first.id, b.first.ts, b.first.id);
+        });
+        if (found.size() > limit) found.resize(limit);
+    }
+    std::vector<SaleRecord> out;
+    out.reserve(found.size());
+    for (const auto &f : found) out.push_back(toRecord(segs[f.second], f.first));
+    return out;
+}
+
+void SalesArchive::forEachSummary(const std::function<void(const SummaryEntry &)> &fn) const {
+    for (const auto &seg : segs)
+        for (const auto &s : seg.summary)
+            fn(SummaryEntry{ seg.info.month, &seg.drugs[s.drug], &seg.types[s.type], s.quantity, s.rows });
+}
+
+bool SalesArchive::forEachRow(long long afterId, const std::function<void(const SaleRecord &)> &fn) const {
+    std::vector<Row> rows;
+    for (const auto &seg : segs) {
+        if (seg.info.maxId <= afterId) continue;
+        if (!decode(seg, rows)) return false;
+        for (const auto &r : rows) if (r.id > afterId) fn(toRecord(seg, r));
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef SALES_ARCHIVE_H
+#define SALES_ARCHIVE_H
+
+#include "database.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 冷流水归档：已结束月份的销售流水从 sales 表移出，写成只读的压缩段文件（每段一个月）。
+// 段内按 (时间戳, 流水号) 排序，列式存放：时间戳为相对前一行的秒数增量，流水号为增量（zigzag），
+// 药品/操作员/类型为段内字典编号，数量为 zigzag varint；全部使用 varint 编码。
+// 段头记录行数、时间戳与流水号的最小/最大值、三个字典，以及按 (药品, 类型) 的数量合计与行数，
+// 查询据此跳过无关段，按月汇总的报表直接使用合计而不解码行。文件末尾为 FNV-1a 校验和。
+// 段文件清单保存在 app_meta（键 sales_archive），与删除 sales 行在同一事务内更新，
+// 中途失败时清单外的段文件被忽略，不会重复或丢失流水。
+class SalesArchive {
+public:
+    static const char *manifestKey() { return "sales_archive"; }
+    // 归档目录的绝对路径（键 sales_archive_dir）：备份快照不在原目录时据此找到段文件
+    static const char *dirKey() { return "sales_archive_dir"; }
+
+    struct SegmentInfo {
+        std::string file;       // 段文件名（相对归档目录）
+        std::string month;      // YYYY-MM
+        long long rows = 0;
+        long long minId = 0, maxId = 0;
+        long long minTs = 0, maxTs = 0; // 自纪元起的秒数（按 UTC 解释本地时间字符串，只用于比较）
+        long long bytes = 0;
+    };
+
+    // 按段合计（不解码行）
+    struct SummaryEntry {
+        std::string month;
+        const std::string *drugName;
+        const std::string *type;
+        long long quantity;
+        long long rows;
+    };
+
+    // 只有 YYYY-MM-DDTHH:MM:SS 格式的时间戳可以无损编码；其余记录留在 sales 表
+    static bool isArchivable(const std::string &timestamp);
+    // 把同一个月、已按 (时间戳, 流水号) 排序的流水写成段文件（先写临时文件再改名）
+    static bool writeSegment(const std::string &path, const std::vector<SaleRecord> &rows, SegmentInfo &info, std::string &error);
+
+    // 按清单（每行一个段文件名）载入各段的段头；段文件缺失或损坏时返回 false
+    bool open(const std::string &dir, const std::string &manifest, std::string &error);
+    void clear();
+    const std::string &directory() const { return dir; }
+    const std::vector<SegmentInfo> &segments() const { return infos; }
+    long long rows() const;
+    long long bytes() const;
+    long long maxId() const;
+
+    // 与 SqliteDatabase::querySales 相同的筛选、排序与游标语义，返回归档中的一页
+    std::vector<SaleRecord> query(const SalesQuery &q) const;
+    void forEachSummary(const std::function<void(const SummaryEntry &)> &fn) const;
+    // 按时间顺序回放流水号大于 afterId 的记录
+    bool forEachRow(long long afterId, const std::function<void(const SaleRecord &)> &fn) const;
+
+private:
+    struct Row {
+        long long ts;
+        long long id;
+        uint32_t drug, op, type;
+        int quantity;
+    };
+    struct Summary {
+        uint32_t drug, type;
+        long long quantity, rows;
+    };
+    struct Segment {
+        SegmentInfo info;
+        std::vector<std::string> drugs, operators, types;
+        std::vector<Summary> summary;
+        long long payloadOffset = 0;
+    };
+    std::string dir;
+    std::vector<Segment> segs;
+    std::vector<SegmentInfo> infos;
+
+    bool decode(const Segment &seg, std::vector<Row> &rows) const;   // 失败时输出提示
+    bool decodeRows(const Segment &seg, std::vector<Row> &rows) const;
+    static SaleRecord toRecord(const Segment &seg, const Row &r);
+};
+
+#endif // SALES_ARCHIVE_H
@@ -0,0 +1,197 @@
+#include "sales_scan.h"
+#include "sales_archive.h"
+#include <sqlite3.h>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+bool SalesCursor::next() { return sqlite3_step(static_cast<sqlite3_stmt*>(stmt)) == SQLITE_ROW; }
+
+const char *SalesCursor::drugName() const {
+    const unsigned char *t = sqlite3_column_text(static_cast<sqlite3_stmt*>(stmt), 1);
+    return t ? reinterpret_cast<const char*>(t) : "";
+}
+
+int SalesCursor::quantity() const { return sqlite3_column_int(static_cast<sqlite3_stmt*>(stmt), 2); }
+
+const char *SalesCursor::timestamp() const {
+    const unsigned char *t = sqlite3_column_text(static_cast<sqlite3_stmt*>(stmt), 3);
+    return t ? reinterpret_cast<const char*>(t) : "";
+}
+
+const char *SalesCursor::type() const {
+    const unsigned char *t = sqlite3_column_text(static_cast<sqlite3_stmt*>(stmt), 4);
+    return t ? reinterpret_cast<const char*>(t) : "";
+}
+
+long long SalesCursor::rowid() const { return sqlite3_column_int64(static_cast<sqlite3_stmt*>(stmt), 0); }
+
+SalesScanEngine::SalesScanEngine(const std::string &dbPath, int threads)
+    : path(dbPath), pool(threads), conns(static_cast<size_t>(pool.size()), nullptr) {}
+
+SalesScanEngine::~SalesScanEngine() {
+    for (void *c : conns) if (c) sqlite3_close(static_cast<sqlite3*>(c));
+}
+
+void *SalesScanEngine::connFor(int worker) {
+    void *&c = conns[static_cast<size_t>(worker)];
+    if (!c) {
+        sqlite3 *db = nullptr;
+        if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+            if (db) sqlite3_close(db);
+            return nullptr;
+        }
+        c = db;
+    }
+    return c;
+}
+
+bool SalesScanEngine::scan(const std::function<void(int, SalesCursor &)> &chunkFn, ScanStats &stats) {
+    auto t0 = std::chrono::steady_clock::now();
+    stats = ScanStats{};
+    stats.threads = pool.size();
+    // 在工作线程 0 的连接上读取 rowid 范围（此时池空闲，不会并发使用该连接）
+    sqlite3 *db0 = static_cast<sqlite3*>(connFor(0));
+    sqlite3_stmt *st = nullptr;
+    if (!db0 || sqlite3_prepare_v2(db0, "SELECT MIN(id), MAX(id) FROM sales", -1, &st, nullptr) != SQLITE_OK) {
+        stats.failed = true;
+        return false;
+    }
+    long long lo = 0, hi = -1;
+    if (sqlite3_step(st) == SQLITE_ROW && sqlite3_column_type(st, 0) != SQLITE_NULL) {
+        lo = sqlite3_column_int64(st, 0);
+        hi = sqlite3_column_int64(st, 1);
+    }
+    sqlite3_finalize(st);
+    if (hi < lo) { stats.seconds = 0; return true; }
+
+    // 分片数取线程数的 8 倍，区间较小时减少分片；稀疏区间（大量删除）靠窃取平衡
+    const long long span = hi - lo + 1;
+    long long chunks = static_cast<long long>(pool.size()) * 8;
+    const long long minChunk = 4096;
+    if (span / chunks < minChunk) chunks = span / minChunk + 1;
+    const long long step = (span + chunks - 1) / chunks;
+    std::atomic<bool> failed{false};
+    pool.resetStats();
+    for (long long c = 0; c < chunks; ++c) {
+        long long from = lo + c * step;
+        long long to = from + step - 1;
+        if (from > hi) break;
+        stats.chunks++;
+        pool.submit([this, from, to, &chunkFn, &failed](int worker) {
+            sqlite3 *db = static_cast<sqlite3*>(connFor(worker));
+            sqlite3_stmt *stmt = nullptr;
+            if (!db || sqlite3_prepare_v2(db, "SELECT id, drug_name, quantity, timestamp, type FROM sales WHERE id BETWEEN ? AND ?",
+                                          -1, &stmt, nullptr) != SQLITE_OK) {
+                failed = true;
+                return;
+            }
+            sqlite3_bind_int64(stmt, 1, from);
+            sqlite3_bind_int64(stmt, 2, to);
+            SalesCursor cur;
+            cur.stmt = stmt;
+            chunkFn(worker, cur);
+            sqlite3_finalize(stmt);
+        });
+    }
+    pool.waitIdle();
+    stats.steals = pool.steals();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    stats.failed = failed;
+    return !stats.failed;
+}
+
+namespace {
+
+// Drug 与 DrugView 共用：只读取 name 与 category
+template <typename DrugRow>
+CategoryMonthTotals aggregateRows(SalesScanEngine &engine, const std::vector<DrugRow> &drugs, ScanStats &stats,
+                                  const SalesArchive *archive) {
+    // 品类编号化：行循环里只做 string_view 查表与整数运算，不分配内存
+    std::vector<std::string> categories;
+    std::unordered_map<std::string_view, int> catIds;
+    std::unordered_map<std::string_view, int> nameToCat;
+    nameToCat.reserve(drugs.size());
+    for (const auto &d : drugs) {
+        const std::string_view category(d.category);
+        auto it = catIds.find(category);
+        int id;
+        if (it == catIds.end()) { id = static_cast<int>(categories.size()); catIds.emplace(category, id); categories.emplace_back(category); }
+        else id = it->second;
+        nameToCat[std::string_view(d.name)] = id;
+    }
+    const int unknownId = static_cast<int>(categories.size());
+    categories.push_back("未知");
+
+    // 局部聚合键：品类编号 << 20 | (年 * 12 + 月)
+    using Partial = std::unordered_map<long long, long long>;
+    std::vector<Partial> partials(static_cast<size_t>(engine.threads()));
+    std::vector<long long> rows(static_cast<size_t>(engine.threads()), 0);
+    const bool scanned = engine.scan([&](int worker, SalesCursor &cur) {
+        Partial &local = partials[static_cast<size_t>(worker)];
+        long long n = 0;
+        while (cur.next()) {
+            ++n;
+            const char *ts = cur.timestamp();
+            if (std::strlen(ts) < 7 || ts[4] != '-') continue;
+            bool digits = true;
+            for (int k : {0, 1, 2, 3, 5, 6}) digits = digits && std::isdigit(static_cast<unsigned char>(ts[k]));
+            if (!digits) continue;
+            if (std::strcmp(cur.type(), "WASTAGE") == 0) continue;
+            int year = (ts[0] - '0') * 1000 + (ts[1] - '0') * 100 + (ts[2] - '0') * 10 + (ts[3] - '0');
+            int month = (ts[5] - '0') * 10 + (ts[6] - '0');
+            if (month < 1 || month > 12) continue;
+            auto it = nameToCat.find(std::string_view(cur.drugName()));
+            long long cat = it == nameToCat.end() ? unknownId : it->second;
+            local[(cat << 20) | (year * 12 + month - 1)] += cur.quantity();
+        }
+        rows[static_cast<size_t>(worker)] += n;
+    }, stats);
+    for (long long r : rows) stats.rows += r;
+    // 部分分片缺失时不输出残缺合计
+    if (!scanned) return CategoryMonthTotals();
+
+    // 归档段：月份与 (药品, 类型) 合计已在段头，按与行扫描相同的规则并入第一个局部表
+    if (archive) {
+        Partial &local = partials[0];
+        archive->forEachSummary([&](const SalesArchive::SummaryEntry &e) {
+            stats.archivedRows += e.rows;
+            if (*e.type == "WASTAGE") return;
+            const int year = std::atoi(e.month.substr(0, 4).c_str());
+            const int month = std::atoi(e.month.substr(5, 2).c_str());
+            auto it = nameToCat.find(std::string_view(*e.drugName));
+            long long cat = it == nameToCat.end() ? unknownId : it->second;
+            local[(cat << 20) | (year * 12 + month - 1)] += e.quantity;
+        });
+        stats.segments = static_cast<int>(archive->segments().size());
+    }
+
+    CategoryMonthTotals result;
+    char ym[16];
+    for (const auto &part : partials) {
+        for (const auto &kv : part) {
+            long long cat = kv.first >> 20;
+            long long ymIdx = kv.first & ((1LL << 20) - 1);
+            std::snprintf(ym, sizeof(ym), "%04lld-%02lld", ymIdx / 12, ymIdx % 12 + 1);
+            result[categories[static_cast<size_t>(cat)]][ym] += kv.second;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+CategoryMonthTotals aggregateCategoryMonthly(SalesScanEngine &engine, const std::vector<Drug> &drugs, ScanStats &stats,
+                                             const SalesArchive *archive) {
+    return aggregateRows(engine, drugs, stats, archive);
+}
+
+CategoryMonthTotals aggregateCategoryMonthly(SalesScanEngine &engine, const std::vector<DrugView> &drugs, ScanStats &stats,
+                                             const SalesArchive *archive) {
+    return aggregateRows(engine, drugs, stats, archive);
+}
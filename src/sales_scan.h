@@ -0,0 +1,66 @@
+#ifndef SALES_SCAN_H
+#define SALES_SCAN_H
+
+#include "arena.h"
+#include "drug.h"
+#include "thread_pool.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 单个分片内的行游标（封装只读连接上的预编译语句，头文件不依赖 sqlite3.h）
+class SalesCursor {
+public:
+    bool next();
+    const char *drugName() const;
+    int quantity() const;
+    const char *timestamp() const;
+    const char *type() const;
+    long long rowid() const;
+
+private:
+    friend class SalesScanEngine;
+    void *stmt = nullptr;
+};
+
+struct ScanStats {
+    long long rows = 0;
+    int chunks = 0;
+    int threads = 0;
+    long long steals = 0;
+    double seconds = 0.0;
+    long long archivedRows = 0; // 由归档段合计计入的行数（不解码）
+    int segments = 0;
+    bool failed = false;        // 连接或分片语句失败，合计不完整
+};
+
+class SalesArchive;
+
+// 并行扫描 sales：按 rowid 区间切成多于线程数的分片，交给工作窃取线程池；
+// 每个工作线程使用自己的只读连接（WAL 下与前台写入互不阻塞）。
+// chunkFn(worker, cursor) 在分片上迭代行，调用方按 worker 编号维护局部聚合，最后自行合并。
+class SalesScanEngine {
+public:
+    SalesScanEngine(const std::string &dbPath, int threads);
+    ~SalesScanEngine();
+    int threads() const { return pool.size(); }
+    bool scan(const std::function<void(int, SalesCursor &)> &chunkFn, ScanStats &stats);
+
+private:
+    std::string path;
+    WorkStealingPool pool;
+    std::vector<void *> conns; // 每个工作线程一个 sqlite3*，懒打开
+    void *connFor(int worker);
+};
+
+// 品类 × 月份（YYYY-MM）净销售量：SALE 与 RETURN/ADJ 计入，WASTAGE 忽略；未知药品归入“未知”。
+// archive 非空时叠加已归档月份（直接使用段头的按药品合计）；扫描失败时 stats.failed 置位并返回空结果
+using CategoryMonthTotals = std::map<std::string, std::map<std::string, long long>>;
+CategoryMonthTotals aggregateCategoryMonthly(SalesScanEngine &engine, const std::vector<Drug> &drugs, ScanStats &stats,
+                                             const SalesArchive *archive = nullptr);
+CategoryMonthTotals aggregateCategoryMonthly(SalesScanEngine &engine, const std::vector<DrugView> &drugs, ScanStats &stats,
+                                             const SalesArchive *archive = nullptr);
+
+#endif // SALES_SCAN_H
@@ -1,8 +1,13 @@
 #include "sqlite_db.h"
+#include "metrics.h"
 #include <sqlite3.h>
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <ctime>
 #ifdef _WIN32
 #include <direct.h>
 #else
@@ -24,16 +29,76 @@ static void ensure_dir_exists(const std::string &dir) {
 #endif
 }
 
+// 统计单表行数，表不存在或出错时返回 -1
+// 报表相关的固定查询；explainReportQueries 对同样的语句取查询计划
+static const char *kLoadDrugsSql = "SELECT name, category, manufacturer, specification, production_date, stock, total_sold, shelf_life_days, near_expiry_days FROM drugs";
+static const char *kLoadUsersSql = "SELECT username, password, role FROM users";
+static const char *kLoadSalesSql = "SELECT drug_name, quantity, timestamp, operator, type, id FROM sales ORDER BY id ASC";
+
+// querySales 的语句：只拼接固定的条件片段，取值按顺序放入 texts，全部走参数绑定
+static std::string sales_query_sql(const SalesQuery &q, std::vector<std::string> &texts) {
+    std::string sql = "SELECT drug_name, quantity, timestamp, operator, type, id FROM sales WHERE 1=1";
+    if (!q.drugName.empty()) { sql += " AND drug_name = ?"; texts.push_back(q.drugName); }
+    if (!q.operatorName.empty()) { sql += " AND operator = ?"; texts.push_back(q.operatorName); }
+    if (!q.type.empty()) { sql += " AND type = ?"; texts.push_back(q.type); }
+    if (!q.fromDate.empty()) { sql += " AND timestamp >= ?"; texts.push_back(q.fromDate); }
+    if (!q.toDate.empty()) { sql += " AND timestamp < date(?, '+1 day')"; texts.push_back(q.toDate); }
+    if (!q.afterTimestamp.empty()) {
+        sql += q.newestFirst ? " AND (timestamp, id) < (?, ?)" : " AND (timestamp, id) > (?, ?)";
+        texts.push_back(q.afterTimestamp);
+    }
+    sql += q.newestFirst ? " ORDER BY timestamp DESC, id DESC LIMIT ?" : " ORDER BY timestamp ASC, id ASC LIMIT ?";
+    return sql;
+}
+
+static long long count_rows(sqlite3 *db, const char *table) {
+    std::string sql = std::string("SELECT COUNT(*) FROM ") + table;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return -1;
+    long long n = (sqlite3_step(stmt) == SQLITE_ROW) ? sqlite3_column_int64(stmt, 0) : -1;
+    sqlite3_finalize(stmt);
+    return n;
+}
+
+// 列文本的视图（先取文本再取字节数，避免 strlen；NULL 为空视图），指向语句内部缓冲，下一次 step 前有效
+static std::string_view column_view(sqlite3_stmt *stmt, int col) {
+    const unsigned char *t = sqlite3_column_text(stmt, col);
+    if (!t) return std::string_view();
+    return std::string_view(reinterpret_cast<const char*>(t), static_cast<size_t>(sqlite3_column_bytes(stmt, col)));
+}
+
 SqliteDatabase::SqliteDatabase(const std::string &dbPath) : path(dbPath) {}
 
 SqliteDatabase::~SqliteDatabase() {
+    if (findUserStmt) sqlite3_finalize(static_cast<sqlite3_stmt*>(findUserStmt));
     if (dbHandle) {
         sqlite3_close(static_cast<sqlite3*>(dbHandle));
         dbHandle = nullptr;
     }
 }
 
+// 直接执行语句的指标名：取前两个单词，如 "sql.BEGIN TRANSACTION"、"sql.DELETE FROM"
+static std::string exec_metric_name(const std::string &sql) {
+    std::istringstream is(sql);
+    std::string a, b;
+    is >> a >> b;
+    return "sql." + (b.empty() ? a : a + " " + b);
+}
+
+// 事务控制语句每笔交易都会执行：直方图缓存在函数内静态变量中，不再每次分词、查注册表；
+// 其余语句只在启动、保存或维护时执行，按名称查找
+static LatencyHistogram &exec_histogram(const std::string &sql) {
+    static LatencyHistogram &beginHist = Metrics::instance().histogram("sql.BEGIN TRANSACTION");
+    static LatencyHistogram &commitHist = Metrics::instance().histogram("sql.COMMIT");
+    static LatencyHistogram &rollbackHist = Metrics::instance().histogram("sql.ROLLBACK");
+    if (sql == "BEGIN TRANSACTION") return beginHist;
+    if (sql == "COMMIT") return commitHist;
+    if (sql == "ROLLBACK") return rollbackHist;
+    return Metrics::instance().histogram(exec_metric_name(sql));
+}
+
 bool SqliteDatabase::exec(const std::string &sql) {
+    ScopedTimer timer(exec_histogram(sql));
     char *errmsg = nullptr;
     int rc = sqlite3_exec(static_cast<sqlite3*>(dbHandle), sql.c_str(), nullptr, nullptr, &errmsg);
     if (rc != SQLITE_OK) {
@@ -56,6 +121,9 @@ bool SqliteDatabase::init() {
         return false;
     }
     dbHandle = db;
+    // WAL：并行报表的只读连接与前台写入互不阻塞
+    exec("PRAGMA journal_mode=WAL");
+    sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE, &SqliteDatabase::traceCallback, this);
 
     // 建表
     exec("CREATE TABLE IF NOT EXISTS drugs (\n"
@@ -73,7 +141,41 @@ bool SqliteDatabase::init() {
          "drug_name TEXT, quantity INTEGER, timestamp TEXT, operator TEXT\n"
          ");");
 
-    // 保持旧版 sales 表结构，无交易类型列。
+    // 旧版 sales 表无交易类型列：补列后把历史负数量记录标为 ADJ（无法区分退货与报损）
+    {
+        bool hasType = false;
+        sqlite3_stmt *info = nullptr;
+        if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), "PRAGMA table_info(sales)", -1, &info, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(info) == SQLITE_ROW) {
+                const unsigned char *col = sqlite3_column_text(info, 1);
+                if (col && std::string(reinterpret_cast<const char*>(col)) == "type") hasType = true;
+            }
+            sqlite3_finalize(info);
+        }
+        if (!hasType) {
+            exec("ALTER TABLE sales ADD COLUMN type TEXT DEFAULT 'SALE'");
+            exec("UPDATE sales SET type='ADJ' WHERE quantity < 0");
+        }
+    }
+
+    // 流水查询索引：各筛选列后接时间戳（rowid 隐含在末尾），使 ORDER BY timestamp, id 无需排序
+    exec("CREATE INDEX IF NOT EXISTS idx_sales_ts ON sales(timestamp)");
+    exec("CREATE INDEX IF NOT EXISTS idx_sales_drug_ts ON sales(drug_name, timestamp)");
+    exec("CREATE INDEX IF NOT EXISTS idx_sales_operator_ts ON sales(operator, timestamp)");
+    exec("CREATE INDEX IF NOT EXISTS idx_sales_type_ts ON sales(type, timestamp)");
+
+    // 批次库存：数量扣空的批次保留为历史记录，载入时跳过
+    exec("CREATE TABLE IF NOT EXISTS lots (\n"
+         "id INTEGER PRIMARY KEY AUTOINCREMENT,\n"
+         "drug_name TEXT NOT NULL, production_date TEXT, expiry_date TEXT, quantity INTEGER\n"
+         ");");
+    exec("CREATE INDEX IF NOT EXISTS idx_lots_drug ON lots(drug_name, expiry_date)");
+
+    // 需求预测状态与通用键值元数据
+    exec("CREATE TABLE IF NOT EXISTS demand_state (\n"
+         "drug_name TEXT PRIMARY KEY, level REAL, trend REAL, day INTEGER, pending INTEGER, seeded INTEGER\n"
+         ") WITHOUT ROWID;");
+    exec("CREATE TABLE IF NOT EXISTS app_meta (key TEXT PRIMARY KEY, value TEXT) WITHOUT ROWID;");
 
     // 默认管理员
     const char *sqlCount = "SELECT COUNT(*) FROM users";
@@ -90,28 +192,64 @@ bool SqliteDatabase::init() {
 }
 
 std::vector<Drug> SqliteDatabase::loadDrugs() {
+    METRICS_SCOPE("op.loadDrugs");
     std::vector<Drug> list;
-    const char *sql = "SELECT name, category, manufacturer, specification, production_date, stock, total_sold, shelf_life_days, near_expiry_days FROM drugs";
+    const char *sql = kLoadDrugsSql;
+    if (explainCapture) capturePlan(sql);
     sqlite3_stmt *stmt = nullptr;
     if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return list;
+    long long n = count_rows(static_cast<sqlite3*>(dbHandle), "drugs");
+    if (n > 0) list.reserve(static_cast<size_t>(n));
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         Drug d;
-        d.name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        d.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        d.manufacturer = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        d.specification = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        d.productionDate = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+        d.name = column_view(stmt, 0);
+        d.category = column_view(stmt, 1);
+        d.manufacturer = column_view(stmt, 2);
+        d.specification = column_view(stmt, 3);
+        d.productionDate = column_view(stmt, 4);
         d.stock = sqlite3_column_int(stmt, 5);
         d.totalSold = sqlite3_column_int(stmt, 6);
         d.shelfLifeDays = sqlite3_column_int(stmt, 7);
         d.nearExpiryThresholdDays = sqlite3_column_int(stmt, 8);
-        list.push_back(d);
+        list.push_back(std::move(d));
     }
     sqlite3_finalize(stmt);
     return list;
 }
 
+// 与 loadDrugs 相同的列，字段复制进表的字符串区；行数组按 COUNT(*) 一次定容
+bool SqliteDatabase::loadDrugTable(DrugTable &out) {
+    METRICS_SCOPE("op.loadDrugTable");
+    out.rows.clear();
+    out.arena.clear();
+    const char *sql = kLoadDrugsSql;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+    long long n = count_rows(static_cast<sqlite3*>(dbHandle), "drugs");
+    if (n > 0) out.rows.reserve(static_cast<size_t>(n));
+    auto text = [&](int col) { std::string_view v = column_view(stmt, col); return out.arena.copy(v.data(), v.size()); };
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        DrugView d;
+        d.name = text(0);
+        d.category = text(1);
+        d.manufacturer = text(2);
+        d.specification = text(3);
+        d.productionDate = text(4);
+        d.stock = sqlite3_column_int(stmt, 5);
+        d.totalSold = sqlite3_column_int(stmt, 6);
+        d.shelfLifeDays = sqlite3_column_int(stmt, 7);
+        d.nearExpiryThresholdDays = sqlite3_column_int(stmt, 8);
+        out.rows.push_back(d);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE;
+}
+
 bool SqliteDatabase::saveDrugs(const std::vector<Drug>& drugs) {
+    METRICS_SCOPE("op.saveDrugs");
+    static LatencyHistogram &insertHist = Metrics::instance().histogram("sql.drugs.insert");
+    std::lock_guard<std::mutex> lock(writeMutex);
     exec("BEGIN TRANSACTION");
     exec("DELETE FROM drugs");
     const char *sql = "INSERT INTO drugs(name, category, manufacturer, specification, production_date, stock, total_sold, shelf_life_days, near_expiry_days) VALUES(?,?,?,?,?,?,?,?,?)";
@@ -127,7 +265,8 @@ bool SqliteDatabase::saveDrugs(const std::vector<Drug>& drugs) {
         sqlite3_bind_int(stmt, 7, d.totalSold);
         sqlite3_bind_int(stmt, 8, d.shelfLifeDays);
         sqlite3_bind_int(stmt, 9, d.nearExpiryThresholdDays);
-        int rc = sqlite3_step(stmt);
+        int rc;
+        { ScopedTimer t(insertHist); rc = sqlite3_step(stmt); }
         if (rc != SQLITE_DONE) { sqlite3_finalize(stmt); exec("ROLLBACK"); return false; }
         sqlite3_reset(stmt);
         sqlite3_clear_bindings(stmt);
@@ -138,8 +277,10 @@ bool SqliteDatabase::saveDrugs(const std::vector<Drug>& drugs) {
 }
 
 std::vector<User> SqliteDatabase::loadUsers() {
+    METRICS_SCOPE("op.loadUsers");
     std::vector<User> list;
-    const char *sql = "SELECT username, password, role FROM users";
+    const char *sql = kLoadUsersSql;
+    if (explainCapture) capturePlan(sql);
     sqlite3_stmt *stmt = nullptr;
     if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return list;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
@@ -153,7 +294,71 @@ std::vector<User> SqliteDatabase::loadUsers() {
     return list;
 }
 
+bool SqliteDatabase::findUser(const std::string &username, User &out) {
+    METRICS_SCOPE("op.findUser");
+    std::lock_guard<std::mutex> lock(userStmtMutex);
+    if (!findUserStmt) {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), "SELECT username, password, role FROM users WHERE username = ?",
+                               -1, &stmt, nullptr) != SQLITE_OK) return false;
+        findUserStmt = stmt;
+    }
+    sqlite3_stmt *stmt = static_cast<sqlite3_stmt*>(findUserStmt);
+    sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
+    bool found = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char *pw = sqlite3_column_text(stmt, 1);
+        const unsigned char *role = sqlite3_column_text(stmt, 2);
+        out.username = username;
+        out.password = pw ? reinterpret_cast<const char*>(pw) : "";
+        out.role = role ? reinterpret_cast<const char*>(role) : "";
+        found = true;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return found;
+}
+
+std::vector<User> SqliteDatabase::loadUnhashedUsers() {
+    std::vector<User> list;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), "SELECT username, password, role FROM users WHERE password NOT LIKE 'scrypt$%'",
+                           -1, &stmt, nullptr) != SQLITE_OK) return list;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        User u;
+        const unsigned char *name = sqlite3_column_text(stmt, 0);
+        const unsigned char *pw = sqlite3_column_text(stmt, 1);
+        const unsigned char *role = sqlite3_column_text(stmt, 2);
+        u.username = name ? reinterpret_cast<const char*>(name) : "";
+        u.password = pw ? reinterpret_cast<const char*>(pw) : "";
+        u.role = role ? reinterpret_cast<const char*>(role) : "";
+        list.push_back(u);
+    }
+    sqlite3_finalize(stmt);
+    return list;
+}
+
+bool SqliteDatabase::updateUserPasswords(const std::vector<User> &users) {
+    if (users.empty()) return true;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (!exec("BEGIN TRANSACTION")) return false;
+    sqlite3_stmt *stmt = nullptr;
+    bool ok = sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), "UPDATE users SET password = ? WHERE username = ?",
+                                 -1, &stmt, nullptr) == SQLITE_OK;
+    for (size_t i = 0; ok && i < users.size(); ++i) {
+        sqlite3_bind_text(stmt, 1, users[i].password.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, users[i].username.c_str(), -1, SQLITE_TRANSIENT);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    if (!ok) { exec("ROLLBACK"); return false; }
+    return exec("COMMIT");
+}
+
 bool SqliteDatabase::saveUsers(const std::vector<User>& users) {
+    METRICS_SCOPE("op.saveUsers");
+    std::lock_guard<std::mutex> lock(writeMutex);
     exec("BEGIN TRANSACTION");
     exec("DELETE FROM users");
     const char *sql = "INSERT INTO users(username, password, role) VALUES(?,?,?)";
@@ -174,31 +379,693 @@ bool SqliteDatabase::saveUsers(const std::vector<User>& users) {
 }
 
 bool SqliteDatabase::appendSale(const SaleRecord& record) {
-    const char *sql = "INSERT INTO sales(drug_name, quantity, timestamp, operator) VALUES(?,?,?,?)";
+    METRICS_SCOPE("op.appendSale");
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return insertSaleRow(record);
+}
+
+// 插入一条流水（调用方持有 writeMutex）
+bool SqliteDatabase::insertSaleRow(const SaleRecord &record) {
+    static LatencyHistogram &insertHist = Metrics::instance().histogram("sql.sales.insert");
+    const char *sql = "INSERT INTO sales(drug_name, quantity, timestamp, operator, type) VALUES(?,?,?,?,?)";
     sqlite3_stmt *stmt = nullptr;
     if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
     sqlite3_bind_text(stmt, 1, record.drugName.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_int(stmt, 2, record.quantity);
     sqlite3_bind_text(stmt, 3, record.timestamp.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 4, record.operatorName.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 5, record.type.c_str(), -1, SQLITE_TRANSIENT);
+    int rc;
+    { ScopedTimer t(insertHist); rc = sqlite3_step(stmt); }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE;
+}
+
+// 批次数量按增量更新（quantity = quantity + ?），并发交易的写入顺序不影响结果（调用方持有 writeMutex）
+bool SqliteDatabase::updateLotRows(const std::vector<LotDelta> &deltas) {
+    if (deltas.empty()) return true;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), "UPDATE lots SET quantity = quantity + ? WHERE id = ?",
+                           -1, &stmt, nullptr) != SQLITE_OK) return false;
+    bool ok = true;
+    for (const auto &d : deltas) {
+        sqlite3_bind_int(stmt, 1, d.delta);
+        sqlite3_bind_int64(stmt, 2, d.lotId);
+        if (sqlite3_step(stmt) != SQLITE_DONE) { ok = false; break; }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool SqliteDatabase::recordTransaction(const SaleRecord &record, const std::vector<LotDelta> &deltas, std::vector<Lot> *newLots,
+                                       long long *saleId) {
+    METRICS_SCOPE("op.recordTransaction");
+    if (saleId) *saleId = 0;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (!exec("BEGIN TRANSACTION")) return false;
+    if (!insertSaleRow(record)) { exec("ROLLBACK"); return false; }
+    const long long id = sqlite3_last_insert_rowid(static_cast<sqlite3*>(dbHandle));
+    if (!updateLotRows(deltas) || (newLots && !insertLotRows(*newLots)) || !exec("COMMIT")) { exec("ROLLBACK"); return false; }
+    if (saleId) *saleId = id;
+    return true;
+}
+
+std::vector<Lot> SqliteDatabase::loadLots() {
+    METRICS_SCOPE("op.loadLots");
+    std::vector<Lot> list;
+    const char *sql = "SELECT id, drug_name, production_date, expiry_date, quantity FROM lots WHERE quantity > 0 ORDER BY id";
+    if (explainCapture) capturePlan(sql);
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return list;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        Lot l;
+        l.id = sqlite3_column_int64(stmt, 0);
+        const unsigned char *name = sqlite3_column_text(stmt, 1);
+        const unsigned char *prod = sqlite3_column_text(stmt, 2);
+        const unsigned char *exp = sqlite3_column_text(stmt, 3);
+        l.drugName = name ? reinterpret_cast<const char*>(name) : "";
+        l.productionDate = prod ? reinterpret_cast<const char*>(prod) : "";
+        l.expiryDate = exp ? reinterpret_cast<const char*>(exp) : "";
+        l.quantity = sqlite3_column_int(stmt, 4);
+        list.push_back(l);
+    }
+    sqlite3_finalize(stmt);
+    return list;
+}
+
+bool SqliteDatabase::insertLots(std::vector<Lot> &lots) {
+    if (lots.empty()) return true;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (!exec("BEGIN TRANSACTION")) return false;
+    if (!insertLotRows(lots)) { exec("ROLLBACK"); return false; }
+    return exec("COMMIT");
+}
+
+// 逐行插入批次并回填 id（调用方持有 writeMutex 并已开启事务）
+bool SqliteDatabase::insertLotRows(std::vector<Lot> &lots) {
+    if (lots.empty()) return true;
+    sqlite3 *db = static_cast<sqlite3*>(dbHandle);
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "INSERT INTO lots(drug_name, production_date, expiry_date, quantity) VALUES(?,?,?,?)",
+                           -1, &stmt, nullptr) != SQLITE_OK) return false;
+    bool ok = true;
+    for (auto &l : lots) {
+        sqlite3_bind_text(stmt, 1, l.drugName.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, l.productionDate.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 3, l.expiryDate.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 4, l.quantity);
+        if (sqlite3_step(stmt) != SQLITE_DONE) { ok = false; break; }
+        l.id = sqlite3_last_insert_rowid(db);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool SqliteDatabase::saveDrugLots(const Drug &d, const std::string &oldName, const std::vector<LotDelta> &deltas,
+                                  std::vector<Lot> &newLots, const std::vector<Lot> &expiryChanged) {
+    METRICS_SCOPE("op.saveDrugLots");
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (!exec("BEGIN TRANSACTION")) return false;
+    sqlite3 *db = static_cast<sqlite3*>(dbHandle);
+    bool ok = true;
+    if (!oldName.empty() && oldName != d.name) {
+        const char *sqls[] = { "UPDATE lots SET drug_name = ?1 WHERE drug_name = ?2", "DELETE FROM drugs WHERE name = ?2" };
+        for (const char *sql : sqls) {
+            sqlite3_stmt *stmt = nullptr;
+            ok = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK;
+            if (ok) {
+                sqlite3_bind_text(stmt, 1, d.name.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_text(stmt, 2, oldName.c_str(), -1, SQLITE_TRANSIENT);
+                ok = sqlite3_step(stmt) == SQLITE_DONE;
+            }
+            sqlite3_finalize(stmt);
+            if (!ok) break;
+        }
+    }
+    if (ok) {
+        sqlite3_stmt *stmt = nullptr;
+        ok = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO drugs(name, category, manufacturer, specification, production_date, stock, total_sold, shelf_life_days, near_expiry_days) VALUES(?,?,?,?,?,?,?,?,?)",
+                                -1, &stmt, nullptr) == SQLITE_OK;
+        if (ok) {
+            sqlite3_bind_text(stmt, 1, d.name.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, d.category.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, d.manufacturer.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 4, d.specification.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 5, d.productionDate.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 6, d.stock);
+            sqlite3_bind_int(stmt, 7, d.totalSold);
+            sqlite3_bind_int(stmt, 8, d.shelfLifeDays);
+            sqlite3_bind_int(stmt, 9, d.nearExpiryThresholdDays);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (!ok || !updateLotRows(deltas) || !insertLotRows(newLots) || !updateLotExpiryRows(expiryChanged)) { exec("ROLLBACK"); return false; }
+    return exec("COMMIT");
+}
+
+bool SqliteDatabase::deleteDrugLots(const std::string &name) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (!exec("BEGIN TRANSACTION")) return false;
+    bool ok = true;
+    const char *sqls[] = { "DELETE FROM lots WHERE drug_name = ?", "DELETE FROM drugs WHERE name = ?" };
+    for (const char *sql : sqls) {
+        sqlite3_stmt *stmt = nullptr;
+        ok = sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) == SQLITE_OK;
+        if (ok) {
+            sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+        sqlite3_finalize(stmt);
+        if (!ok) break;
+    }
+    if (!ok) { exec("ROLLBACK"); return false; }
+    return exec("COMMIT");
+}
+
+bool SqliteDatabase::updateLotExpiry(const std::vector<Lot> &lots) {
+    if (lots.empty()) return true;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (!exec("BEGIN TRANSACTION")) return false;
+    if (!updateLotExpiryRows(lots)) { exec("ROLLBACK"); return false; }
+    return exec("COMMIT");
+}
+
+// 调用方持有 writeMutex 并已开启事务
+bool SqliteDatabase::updateLotExpiryRows(const std::vector<Lot> &lots) {
+    if (lots.empty()) return true;
+    sqlite3_stmt *stmt = nullptr;
+    bool ok = sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), "UPDATE lots SET expiry_date = ? WHERE id = ?",
+                                 -1, &stmt, nullptr) == SQLITE_OK;
+    for (size_t i = 0; ok && i < lots.size(); ++i) {
+        sqlite3_bind_text(stmt, 1, lots[i].expiryDate.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, lots[i].id);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool SqliteDatabase::loadMeta(const std::string &key, std::string &value) {
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), "SELECT value FROM app_meta WHERE key = ?", -1, &stmt, nullptr) != SQLITE_OK)
+        return false;
+    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+    bool found = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char *v = sqlite3_column_text(stmt, 0);
+        value = v ? reinterpret_cast<const char*>(v) : "";
+        found = true;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+bool SqliteDatabase::saveMeta(const std::string &key, const std::string &value) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), "INSERT OR REPLACE INTO app_meta(key, value) VALUES(?, ?)",
+                           -1, &stmt, nullptr) != SQLITE_OK) return false;
+    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, value.c_str(), -1, SQLITE_TRANSIENT);
     int rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
     return rc == SQLITE_DONE;
 }
 
+std::unordered_map<std::string, DemandState> SqliteDatabase::loadDemandStates(long long &watermark) {
+    METRICS_SCOPE("op.loadDemandStates");
+    std::unordered_map<std::string, DemandState> states;
+    sqlite3 *db = static_cast<sqlite3*>(dbHandle);
+    watermark = 0;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT value FROM app_meta WHERE key = 'forecast_watermark'", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) watermark = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    if (sqlite3_prepare_v2(db, "SELECT drug_name, level, trend, day, pending, seeded FROM demand_state", -1, &stmt, nullptr) != SQLITE_OK)
+        return states;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        DemandState s;
+        s.level = sqlite3_column_double(stmt, 1);
+        s.trend = sqlite3_column_double(stmt, 2);
+        s.day = sqlite3_column_int(stmt, 3);
+        s.pending = sqlite3_column_int64(stmt, 4);
+        s.seeded = sqlite3_column_int(stmt, 5) != 0;
+        states[reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))] = s;
+    }
+    sqlite3_finalize(stmt);
+    return states;
+}
+
+bool SqliteDatabase::saveDemandStates(const std::vector<std::pair<std::string, DemandState>> &states,
+                                      const std::vector<std::string> &removed, long long watermark) {
+    METRICS_SCOPE("op.saveDemandStates");
+    std::lock_guard<std::mutex> lock(writeMutex);
+    sqlite3 *db = static_cast<sqlite3*>(dbHandle);
+    if (!exec("BEGIN TRANSACTION")) return false;
+    sqlite3_stmt *up = nullptr, *del = nullptr, *meta = nullptr;
+    bool ok = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO demand_state(drug_name, level, trend, day, pending, seeded) VALUES(?,?,?,?,?,?)",
+                                 -1, &up, nullptr) == SQLITE_OK
+           && sqlite3_prepare_v2(db, "DELETE FROM demand_state WHERE drug_name = ?", -1, &del, nullptr) == SQLITE_OK
+           && sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO app_meta(key, value) VALUES('forecast_watermark', ?)", -1, &meta, nullptr) == SQLITE_OK;
+    for (size_t i = 0; ok && i < states.size(); ++i) {
+        const DemandState &s = states[i].second;
+        sqlite3_bind_text(up, 1, states[i].first.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(up, 2, s.level);
+        sqlite3_bind_double(up, 3, s.trend);
+        sqlite3_bind_int(up, 4, s.day);
+        sqlite3_bind_int64(up, 5, s.pending);
+        sqlite3_bind_int(up, 6, s.seeded ? 1 : 0);
+        ok = sqlite3_step(up) == SQLITE_DONE;
+        sqlite3_reset(up);
+    }
+    for (size_t i = 0; ok && i < removed.size(); ++i) {
+        sqlite3_bind_text(del, 1, removed[i].c_str(), -1, SQLITE_TRANSIENT);
+        ok = sqlite3_step(del) == SQLITE_DONE;
+        sqlite3_reset(del);
+    }
+    if (ok) {
+        sqlite3_bind_int64(meta, 1, watermark);
+        ok = sqlite3_step(meta) == SQLITE_DONE;
+    }
+    sqlite3_finalize(up);
+    sqlite3_finalize(del);
+    sqlite3_finalize(meta);
+    if (!ok) { exec("ROLLBACK"); return false; }
+    return exec("COMMIT");
+}
+
+std::vector<SaleRecord> SqliteDatabase::loadSalesAfter(long long afterId, int limit) {
+    std::vector<SaleRecord> list;
+    const char *sql = "SELECT drug_name, quantity, timestamp, operator, type, id FROM sales WHERE id > ? ORDER BY id LIMIT ?";
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return list;
+    sqlite3_bind_int64(stmt, 1, afterId);
+    sqlite3_bind_int(stmt, 2, limit);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        SaleRecord r;
+        const unsigned char *name = sqlite3_column_text(stmt, 0);
+        const unsigned char *ts = sqlite3_column_text(stmt, 2);
+        const unsigned char *op = sqlite3_column_text(stmt, 3);
+        const unsigned char *type = sqlite3_column_text(stmt, 4);
+        r.drugName = name ? reinterpret_cast<const char*>(name) : "";
+        r.quantity = sqlite3_column_int(stmt, 1);
+        r.timestamp = ts ? reinterpret_cast<const char*>(ts) : "";
+        r.operatorName = op ? reinterpret_cast<const char*>(op) : "";
+        r.type = type ? reinterpret_cast<const char*>(type) : (r.quantity >= 0 ? "SALE" : "ADJ");
+        r.id = sqlite3_column_int64(stmt, 5);
+        list.push_back(r);
+    }
+    sqlite3_finalize(stmt);
+    return list;
+}
+
+std::vector<std::string> SqliteDatabase::salesMonthsBefore(const std::string &cutoff) {
+    std::vector<std::string> months;
+    const char *sql = "SELECT DISTINCT substr(timestamp, 1, 7) FROM sales WHERE timestamp < ? ORDER BY 1";
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return months;
+    sqlite3_bind_text(stmt, 1, cutoff.c_str(), -1, SQLITE_TRANSIENT);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char *m = sqlite3_column_text(stmt, 0);
+        if (m) months.push_back(reinterpret_cast<const char*>(m));
+    }
+    sqlite3_finalize(stmt);
+    return months;
+}
+
+std::vector<SaleRecord> SqliteDatabase::loadSalesBetween(const std::string &from, const std::string &to) {
+    METRICS_SCOPE("op.loadSalesBetween");
+    std::vector<SaleRecord> list;
+    const char *sql = "SELECT drug_name, quantity, timestamp, operator, type, id FROM sales "
+                      "WHERE timestamp >= ? AND timestamp < ? ORDER BY timestamp, id";
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return list;
+    sqlite3_bind_text(stmt, 1, from.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, to.c_str(), -1, SQLITE_TRANSIENT);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        SaleRecord r;
+        const unsigned char *name = sqlite3_column_text(stmt, 0);
+        const unsigned char *ts = sqlite3_column_text(stmt, 2);
+        const unsigned char *op = sqlite3_column_text(stmt, 3);
+        const unsigned char *type = sqlite3_column_text(stmt, 4);
+        r.drugName = name ? reinterpret_cast<const char*>(name) : "";
+        r.quantity = sqlite3_column_int(stmt, 1);
+        r.timestamp = ts ? reinterpret_cast<const char*>(ts) : "";
+        r.operatorName = op ? reinterpret_cast<const char*>(op) : "";
+        r.type = type ? reinterpret_cast<const char*>(type) : (r.quantity >= 0 ? "SALE" : "ADJ");
+        r.id = sqlite3_column_int64(stmt, 5);
+        list.push_back(r);
+    }
+    sqlite3_finalize(stmt);
+    return list;
+}
+
+bool SqliteDatabase::deleteArchivedSales(const std::vector<long long> &ids, const std::string &metaKey, const std::string &manifest) {
+    METRICS_SCOPE("op.deleteArchivedSales");
+    std::lock_guard<std::mutex> lock(writeMutex);
+    sqlite3 *db = static_cast<sqlite3*>(dbHandle);
+    if (!exec("BEGIN TRANSACTION")) return false;
+    sqlite3_stmt *del = nullptr, *meta = nullptr;
+    bool ok = sqlite3_prepare_v2(db, "DELETE FROM sales WHERE id = ?", -1, &del, nullptr) == SQLITE_OK
+           && sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO app_meta(key, value) VALUES(?, ?)", -1, &meta, nullptr) == SQLITE_OK;
+    for (size_t i = 0; ok && i < ids.size(); ++i) {
+        sqlite3_bind_int64(del, 1, ids[i]);
+        ok = sqlite3_step(del) == SQLITE_DONE && sqlite3_changes(db) == 1;
+        sqlite3_reset(del);
+    }
+    if (ok) {
+        sqlite3_bind_text(meta, 1, metaKey.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(meta, 2, manifest.c_str(), -1, SQLITE_TRANSIENT);
+        ok = sqlite3_step(meta) == SQLITE_DONE;
+    }
+    sqlite3_finalize(del);
+    sqlite3_finalize(meta);
+    if (!ok) { exec("ROLLBACK"); return false; }
+    return exec("COMMIT");
+}
+
+bool SqliteDatabase::vacuum() {
+    METRICS_SCOPE("op.vacuum");
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return exec("VACUUM");
+}
+
+bool SqliteDatabase::applyDrugRepairs(const std::vector<DrugRepair> &plan, bool requireOld) {
+    METRICS_SCOPE("op.applyDrugRepairs");
+    std::lock_guard<std::mutex> lock(writeMutex);
+    sqlite3 *db = static_cast<sqlite3*>(dbHandle);
+    const char *sql = requireOld
+        ? "UPDATE drugs SET total_sold = ?, stock = ? WHERE name = ? AND total_sold = ? AND stock = ?"
+        : "UPDATE drugs SET total_sold = ?, stock = ? WHERE name = ?";
+    if (!exec("BEGIN TRANSACTION")) return false;
+    sqlite3_stmt *stmt = nullptr;
+    bool ok = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK;
+    for (size_t i = 0; ok && i < plan.size(); ++i) {
+        const DrugRepair &r = plan[i];
+        sqlite3_bind_int(stmt, 1, r.newSold);
+        sqlite3_bind_int(stmt, 2, r.newStock);
+        sqlite3_bind_text(stmt, 3, r.name.c_str(), -1, SQLITE_TRANSIENT);
+        if (requireOld) {
+            sqlite3_bind_int(stmt, 4, r.oldSold);
+            sqlite3_bind_int(stmt, 5, r.oldStock);
+        }
+        ok = sqlite3_step(stmt) == SQLITE_DONE && (!requireOld || sqlite3_changes(db) == 1);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    if (!ok) { exec("ROLLBACK"); return false; }
+    return exec("COMMIT");
+}
+
+std::unordered_map<std::string, long long> SqliteDatabase::lotTotals() {
+    METRICS_SCOPE("op.lotTotals");
+    std::unordered_map<std::string, long long> totals;
+    sqlite3_stmt *stmt = nullptr;
+    const char *sql = "SELECT drug_name, SUM(quantity) FROM lots WHERE quantity > 0 GROUP BY drug_name";
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return totals;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char *name = sqlite3_column_text(stmt, 0);
+        totals[name ? reinterpret_cast<const char*>(name) : ""] = sqlite3_column_int64(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+    return totals;
+}
+
 std::vector<SaleRecord> SqliteDatabase::loadSales() {
+    METRICS_SCOPE("op.loadSales");
     std::vector<SaleRecord> list;
-    const char *sql = "SELECT drug_name, quantity, timestamp, operator FROM sales ORDER BY id ASC";
+    const char *sql = kLoadSalesSql;
+    if (explainCapture) capturePlan(sql);
     sqlite3_stmt *stmt = nullptr;
     if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return list;
+    long long n = count_rows(static_cast<sqlite3*>(dbHandle), "sales");
+    if (n > 0) list.reserve(static_cast<size_t>(n));
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         SaleRecord r;
-        r.drugName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        r.drugName = column_view(stmt, 0);
         r.quantity = sqlite3_column_int(stmt, 1);
-        r.timestamp = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        r.operatorName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        r.timestamp = column_view(stmt, 2);
+        r.operatorName = column_view(stmt, 3);
+        const unsigned char *type = sqlite3_column_text(stmt, 4);
+        if (type) r.type = column_view(stmt, 4);
+        else r.type = r.quantity >= 0 ? "SALE" : "ADJ";
+        r.id = sqlite3_column_int64(stmt, 5);
+        list.push_back(std::move(r));
+    }
+    sqlite3_finalize(stmt);
+    return list;
+}
+
+// 与 loadSales 相同的列与顺序。type 只有少数几种取值，相同的值共用字符串区中的同一份
+bool SqliteDatabase::loadSalesTable(SalesTable &out) {
+    METRICS_SCOPE("op.loadSalesTable");
+    out.rows.clear();
+    out.arena.clear();
+    const char *sql = kLoadSalesSql;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+    long long n = count_rows(static_cast<sqlite3*>(dbHandle), "sales");
+    if (n > 0) out.rows.reserve(static_cast<size_t>(n));
+    auto text = [&](int col) { std::string_view v = column_view(stmt, col); return out.arena.copy(v.data(), v.size()); };
+    std::vector<std::string_view> types;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        SaleView r;
+        r.drugName = text(0);
+        r.quantity = sqlite3_column_int(stmt, 1);
+        r.timestamp = text(2);
+        r.operatorName = text(3);
+        if (!sqlite3_column_text(stmt, 4)) {
+            r.type = r.quantity >= 0 ? "SALE" : "ADJ";
+        } else {
+            std::string_view t = column_view(stmt, 4);
+            size_t k = 0;
+            while (k < types.size() && types[k] != t) ++k;
+            if (k == types.size()) types.push_back(out.arena.copy(t.data(), t.size()));
+            r.type = types[k];
+        }
+        r.id = sqlite3_column_int64(stmt, 5);
+        out.rows.push_back(r);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE;
+}
+
+std::vector<SaleRecord> SqliteDatabase::querySales(const SalesQuery &q) {
+    METRICS_SCOPE("op.querySales");
+    std::vector<SaleRecord> list;
+    std::vector<std::string> texts;
+    const std::string sql = sales_query_sql(q, texts);
+    const bool paged = !q.afterTimestamp.empty();
+    if (explainCapture) capturePlan(sql.c_str());
+
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cout << "[SQLite] 查询失败: " << sqlite3_errmsg(static_cast<sqlite3*>(dbHandle)) << "\n";
+        return list;
+    }
+    int idx = 1;
+    for (const auto &t : texts) sqlite3_bind_text(stmt, idx++, t.c_str(), -1, SQLITE_TRANSIENT);
+    if (paged) sqlite3_bind_int64(stmt, idx++, q.afterId);
+    sqlite3_bind_int(stmt, idx, q.limit > 0 ? q.limit : 20);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        SaleRecord r;
+        const unsigned char *name = sqlite3_column_text(stmt, 0);
+        const unsigned char *ts = sqlite3_column_text(stmt, 2);
+        const unsigned char *op = sqlite3_column_text(stmt, 3);
+        const unsigned char *type = sqlite3_column_text(stmt, 4);
+        r.drugName = name ? reinterpret_cast<const char*>(name) : "";
+        r.quantity = sqlite3_column_int(stmt, 1);
+        r.timestamp = ts ? reinterpret_cast<const char*>(ts) : "";
+        r.operatorName = op ? reinterpret_cast<const char*>(op) : "";
+        r.type = type ? reinterpret_cast<const char*>(type) : (r.quantity >= 0 ? "SALE" : "ADJ");
+        r.id = sqlite3_column_int64(stmt, 5);
         list.push_back(r);
     }
     sqlite3_finalize(stmt);
     return list;
-}
\ No newline at end of file
+}
+bool SqliteDatabase::backupTo(const std::string &destPath, int pagesPerStep, int sleepMs,
+                              const std::function<void(int, int)> &progress, BackupResult &result) {
+    METRICS_SCOPE("op.backup");
+    static LatencyHistogram &stepHist = Metrics::instance().histogram("sql.backup_step");
+    result = BackupResult{};
+    if (!dbHandle) { result.message = "数据库未打开"; return false; }
+    if (destPath == path) { result.message = "备份目标不能与源数据库相同"; return false; }
+    if (pagesPerStep <= 0) pagesPerStep = 64;
+    std::string dir = dir_from_path_sql(destPath);
+    if (!dir.empty() && dir != ".") ensure_dir_exists(dir);
+
+    sqlite3 *src = static_cast<sqlite3*>(dbHandle);
+    sqlite3 *dest = nullptr;
+    if (sqlite3_open(destPath.c_str(), &dest) != SQLITE_OK) {
+        result.message = std::string("打开备份文件失败: ") + sqlite3_errmsg(dest);
+        if (dest) sqlite3_close(dest);
+        return false;
+    }
+    sqlite3_backup *bk = sqlite3_backup_init(dest, "main", src, "main");
+    if (!bk) {
+        result.message = std::string("初始化备份失败: ") + sqlite3_errmsg(dest);
+        sqlite3_close(dest);
+        return false;
+    }
+
+    // 与源库使用同一连接：步间发生的写入会同步到备份，不会导致备份重启
+    const char *tables[] = { "drugs", "users", "sales", "lots" };
+    const int tableCount = 4;
+    long long srcCounts[tableCount] = { -1, -1, -1, -1 };
+    auto t0 = std::chrono::steady_clock::now();
+    int rc = SQLITE_OK;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            { ScopedTimer t(stepHist); rc = sqlite3_backup_step(bk, pagesPerStep); }
+            result.steps++;
+            result.totalPages = sqlite3_backup_pagecount(bk);
+            result.copiedPages = result.totalPages - sqlite3_backup_remaining(bk);
+            // 完成的瞬间仍持有写锁，此时的源表行数即备份应有的行数
+            if (rc == SQLITE_DONE) {
+                for (int i = 0; i < tableCount; ++i) srcCounts[i] = count_rows(src, tables[i]);
+            }
+        }
+        if (progress) progress(result.copiedPages, result.totalPages);
+        if (rc == SQLITE_DONE) break;
+        if (rc != SQLITE_OK && rc != SQLITE_BUSY && rc != SQLITE_LOCKED) break;
+        if (sleepMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+    }
+    sqlite3_backup_finish(bk);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (rc != SQLITE_DONE) {
+        result.message = std::string("备份失败: ") + sqlite3_errmsg(dest);
+        sqlite3_close(dest);
+        return false;
+    }
+    {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(dest, "PRAGMA page_size", -1, &stmt, nullptr) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW) result.pageSize = sqlite3_column_int(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+    }
+    sqlite3_close(dest);
+
+    // 校验：以只读方式重新打开备份，完整性检查并核对各表行数
+    sqlite3 *check = nullptr;
+    if (sqlite3_open_v2(destPath.c_str(), &check, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        result.message = "备份文件无法打开";
+        if (check) sqlite3_close(check);
+        return false;
+    }
+    std::ostringstream msg;
+    bool ok = true;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(check, "PRAGMA quick_check", -1, &stmt, nullptr) == SQLITE_OK) {
+        const unsigned char *txt = (sqlite3_step(stmt) == SQLITE_ROW) ? sqlite3_column_text(stmt, 0) : nullptr;
+        std::string verdict = txt ? reinterpret_cast<const char*>(txt) : "";
+        if (verdict != "ok") { ok = false; msg << "quick_check=" << verdict << "; "; }
+        sqlite3_finalize(stmt);
+    } else {
+        ok = false; msg << "quick_check 执行失败; ";
+    }
+    for (int i = 0; i < tableCount; ++i) {
+        long long n = count_rows(check, tables[i]);
+        msg << tables[i] << "=" << n;
+        if (n != srcCounts[i]) { ok = false; msg << "(源=" << srcCounts[i] << ")"; }
+        msg << (i < tableCount - 1 ? ", " : "");
+    }
+    sqlite3_close(check);
+    result.verified = ok;
+    result.message = msg.str();
+    return ok;
+}
+
+std::string SqliteDatabase::slowLogPath() const {
+    return dir_from_path_sql(path) + "/slow_query.log";
+}
+
+// SQLITE_TRACE_PROFILE 回调：p 为语句，x 指向耗时纳秒数（精度取决于 VFS 时钟，通常为毫秒级）
+int SqliteDatabase::traceCallback(unsigned type, void *ctx, void *p, void *x) {
+    if (type != SQLITE_TRACE_PROFILE) return 0;
+    auto *self = static_cast<SqliteDatabase*>(ctx);
+    sqlite3_stmt *stmt = static_cast<sqlite3_stmt*>(p);
+    long long ns = *static_cast<sqlite3_int64*>(x);
+    const char *raw = sqlite3_sql(stmt);
+    if (!raw) return 0;
+    long long threshold = self->slowThresholdNs.load();
+    if (threshold < 0 || ns < threshold) return 0;
+
+    char *expanded = sqlite3_expanded_sql(stmt);
+    int fullscan = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0);
+    int sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 0);
+    int autoidx = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 0);
+    int vmsteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 0);
+    std::time_t now = std::time(nullptr);
+    std::tm tmNow{};
+#ifdef _WIN32
+    localtime_s(&tmNow, &now);
+#else
+    localtime_r(&now, &tmNow);
+#endif
+    char ts[32];
+    std::strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tmNow);
+    {
+        std::lock_guard<std::mutex> lock(self->traceMutex);
+        std::ofstream log(self->slowLogPath(), std::ios::app);
+        if (log) {
+            log << ts << " elapsed_ms=" << ns / 1e6
+                << " fullscan_steps=" << fullscan << " sorts=" << sorts
+                << " autoindex=" << autoidx << " vm_steps=" << vmsteps
+                << " sql=" << (expanded ? expanded : raw) << "\n";
+        }
+    }
+    if (expanded) sqlite3_free(expanded);
+    return 0;
+}
+
+// 对同一条 SQL 只捕获一次查询计划，按 EXPLAIN QUERY PLAN 的父子关系缩进
+void SqliteDatabase::capturePlan(const char *sql) {
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        if (plans.count(sql)) return;
+    }
+    std::string eqp = std::string("EXPLAIN QUERY PLAN ") + sql;
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(static_cast<sqlite3*>(dbHandle), eqp.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return;
+    std::map<int, int> depth; // id -> 缩进层级
+    std::ostringstream plan;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int id = sqlite3_column_int(stmt, 0);
+        int parent = sqlite3_column_int(stmt, 1);
+        const unsigned char *detail = sqlite3_column_text(stmt, 3);
+        int d = depth.count(parent) ? depth[parent] + 1 : 0;
+        depth[id] = d;
+        plan << std::string(2 * d + 2, ' ') << (detail ? reinterpret_cast<const char*>(detail) : "") << "\n";
+    }
+    sqlite3_finalize(stmt);
+    std::lock_guard<std::mutex> lock(traceMutex);
+    plans[sql] = plan.str();
+    std::ofstream log(slowLogPath(), std::ios::app);
+    if (log) log << "[QUERY PLAN] " << sql << "\n" << plan.str();
+}
+
+// 只准备 EXPLAIN QUERY PLAN，不执行语句本身，也不读取表数据
+std::map<std::string, std::string> SqliteDatabase::explainReportQueries() {
+    const char *fixed[] = { kLoadDrugsSql, kLoadUsersSql, kLoadSalesSql };
+    for (const char *sql : fixed) capturePlan(sql);
+    SalesQuery q;
+    std::vector<std::string> texts;
+    capturePlan(sales_query_sql(q, texts).c_str());
+    q.drugName = "?"; q.fromDate = "2000-01-01"; q.afterTimestamp = "9999"; q.afterId = 1;
+    capturePlan(sales_query_sql(q, texts).c_str());
+    return capturedPlans();
+}
+
+std::map<std::string, std::string> SqliteDatabase::capturedPlans() {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    return plans;
+}
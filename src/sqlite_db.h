@@ -2,7 +2,26 @@
 #define SQLITE_DB_H
 
 #include "database.h"
+#include "arena.h"
 #include <string>
+#include <functional>
+#include <mutex>
+#include <map>
+#include <atomic>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 在线备份结果：页数、耗时与校验结论
+struct BackupResult {
+    int totalPages = 0;
+    int copiedPages = 0;
+    int pageSize = 0;
+    int steps = 0;
+    double seconds = 0.0;
+    bool verified = false;
+    std::string message;      // 失败原因或校验说明
+};
 
 class SqliteDatabase : public IDatabase {
 public:
@@ -20,10 +39,89 @@ public:
     bool appendSale(const SaleRecord& record) override;
     std::vector<SaleRecord> loadSales() override;
 
+    // 整表只读载入：字段为指向表内字符串区的视图（每块一次分配，而非每个字段一个 std::string），行数组按 COUNT(*) 定容
+    bool loadDrugTable(DrugTable &out);
+    bool loadSalesTable(SalesTable &out);
+
+    // 用户：按用户名点查（主键索引，预编译语句在连接内复用），可被多个线程并发调用
+    bool findUser(const std::string &username, User &out);
+    std::vector<User> loadUnhashedUsers();                  // 口令仍为旧版明文的用户
+    bool updateUserPasswords(const std::vector<User> &users); // 按用户名改写口令字段，单个事务
+
+    // 批次库存：交易只更新涉及的批次，流水与批次变化在同一事务内提交
+    std::vector<Lot> loadLots();                 // 数量 > 0 的批次
+    bool insertLots(std::vector<Lot> &lots);     // 写入后回填 id
+    // newLots 非空时在同一事务中新建批次并回填 id；saleId 非空时返回流水号（失败为 0）
+    bool recordTransaction(const SaleRecord &record, const std::vector<LotDelta> &deltas, std::vector<Lot> *newLots = nullptr,
+                           long long *saleId = nullptr);
+    // 药品行与其批次变化在同一事务中写入（新增/修改药品、入库），不等 saveDrugs：
+    // oldName 非空且不同于 d.name 时删除旧名称的药品行并把其批次改名；newLots 写入后回填 id，expiryChanged 按 id 改写到期日
+    bool saveDrugLots(const Drug &d, const std::string &oldName, const std::vector<LotDelta> &deltas,
+                      std::vector<Lot> &newLots, const std::vector<Lot> &expiryChanged);
+    bool deleteDrugLots(const std::string &name); // 删除药品行及其批次，单个事务
+    bool updateLotExpiry(const std::vector<Lot> &lots); // 按 id 改写到期日（保质期配置变化后），单个事务
+
+    // 需求预测状态：每个药品一行（WITHOUT ROWID），watermark 为已计入预测的最大流水号
+    std::unordered_map<std::string, DemandState> loadDemandStates(long long &watermark);
+    bool saveDemandStates(const std::vector<std::pair<std::string, DemandState>> &states,
+                          const std::vector<std::string> &removed, long long watermark);
+    // app_meta 键值（不存在时 loadMeta 返回 false）
+    bool loadMeta(const std::string &key, std::string &value);
+    bool saveMeta(const std::string &key, const std::string &value);
+    // 按流水号顺序读取 afterId 之后的最多 limit 条
+    std::vector<SaleRecord> loadSalesAfter(long long afterId, int limit);
+
+    // 冷流水归档：cutoff（YYYY-MM-DD）之前出现过的月份（YYYY-MM，升序）
+    std::vector<std::string> salesMonthsBefore(const std::string &cutoff);
+    // timestamp ∈ [from, to) 的流水，按 (timestamp, id) 升序
+    std::vector<SaleRecord> loadSalesBetween(const std::string &from, const std::string &to);
+    // 删除已写入段文件的流水并改写归档清单（app_meta 的 metaKey），单个事务
+    bool deleteArchivedSales(const std::vector<long long> &ids, const std::string &metaKey, const std::string &manifest);
+    bool vacuum(); // 归档后回收空闲页，缩小数据库文件
+    // 账实核对的修复计划：单个事务改写 total_sold/stock；requireOld 时以旧值为条件，任一行不匹配则整体回滚
+    bool applyDrugRepairs(const std::vector<DrugRepair> &plan, bool requireOld);
+    // 每个药品的批次数量合计（数量 > 0 的批次）
+    std::unordered_map<std::string, long long> lotTotals();
+
+    // 按日期/药品/操作员/类型筛选销售流水，返回一页（最多 limit 条）
+    std::vector<SaleRecord> querySales(const SalesQuery &q);
+
+    // 在线备份：sqlite3_backup_step 每次复制 pagesPerStep 页，步间释放锁让销售继续写入
+    // progress(已复制页, 总页数) 每步回调一次；完成后打开备份文件校验行数
+    bool backupTo(const std::string &destPath, int pagesPerStep, int sleepMs,
+                  const std::function<void(int, int)> &progress, BackupResult &result);
+
+    const std::string &dbPath() const { return path; }
+
+    // 慢查询追踪：耗时 ≥ 阈值（毫秒，<0 关闭）的语句写入 slow_query.log，
+    // 附带展开后的 SQL、全表扫描步数、排序与自动索引次数
+    void setSlowQueryThresholdMs(double ms) { slowThresholdNs = ms < 0 ? -1 : static_cast<long long>(ms * 1e6); }
+    double slowQueryThresholdMs() const { return slowThresholdNs < 0 ? -1.0 : slowThresholdNs / 1e6; }
+    // 查询计划捕获：开启后报表相关的 SELECT 首次执行前记录 EXPLAIN QUERY PLAN
+    void setExplainCapture(bool on) { explainCapture = on; }
+    bool explainCaptureEnabled() const { return explainCapture; }
+    std::map<std::string, std::string> capturedPlans();
+    // 对报表相关的查询直接取 EXPLAIN QUERY PLAN（不执行查询），返回全部已捕获的计划
+    std::map<std::string, std::string> explainReportQueries();
+    std::string slowLogPath() const;
+
 private:
     std::string path;
     void *dbHandle = nullptr; // sqlite3*，使用void*避免在头文件包含sqlite3.h
+    std::mutex writeMutex;    // 写事务与备份步进互斥，保证备份只在事务边界之间复制页
+    std::atomic<long long> slowThresholdNs{200LL * 1000 * 1000};
+    std::atomic<bool> explainCapture{false};
+    std::mutex traceMutex;    // 保护慢查询日志与计划缓存
+    std::map<std::string, std::string> plans;
+    void *findUserStmt = nullptr; // sqlite3_stmt*，findUser 复用
+    std::mutex userStmtMutex;
     bool exec(const std::string &sql);
+    bool insertSaleRow(const SaleRecord &record);
+    bool updateLotRows(const std::vector<LotDelta> &deltas);
+    bool insertLotRows(std::vector<Lot> &lots);
+    bool updateLotExpiryRows(const std::vector<Lot> &lots);
+    void capturePlan(const char *sql);
+    static int traceCallback(unsigned type, void *ctx, void *p, void *x);
 };
 
 #endif // SQLITE_DB_H
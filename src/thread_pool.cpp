@@ -0,0 +1,77 @@
+#include "thread_pool.h"
+
+WorkStealingPool::WorkStealingPool(int threads) {
+    if (threads < 1) threads = 1;
+    for (int i = 0; i < threads; ++i) workers.push_back(std::make_unique<Worker>());
+    for (int i = 0; i < threads; ++i) workers[i]->thread = std::thread(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        stopping = true;
+    }
+    workCv.notify_all();
+    for (auto &w : workers) if (w->thread.joinable()) w->thread.join();
+}
+
+void WorkStealingPool::submit(Task task) {
+    unsigned idx = nextQueue.fetch_add(1) % static_cast<unsigned>(workers.size());
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(workers[idx]->mtx);
+        workers[idx]->queue.push_back(std::move(task));
+        queued.fetch_add(1);
+    }
+    // 先获取 waitMutex 再通知，避免工作线程在检查与等待之间错过唤醒
+    { std::lock_guard<std::mutex> lock(waitMutex); }
+    workCv.notify_all();
+}
+
+bool WorkStealingPool::tryPop(int self, Task &out) {
+    {
+        Worker &w = *workers[self];
+        std::lock_guard<std::mutex> lock(w.mtx);
+        if (!w.queue.empty()) {
+            out = std::move(w.queue.back());
+            w.queue.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    const int n = size();
+    for (int k = 1; k < n; ++k) {
+        Worker &victim = *workers[(self + k) % n];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.queue.empty()) {
+            out = std::move(victim.queue.front());
+            victim.queue.pop_front();
+            queued.fetch_sub(1);
+            stealCount.fetch_add(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(int self) {
+    while (true) {
+        Task task;
+        if (tryPop(self, task)) {
+            task(self);
+            if (pending.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(waitMutex);
+                idleCv.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(waitMutex);
+        workCv.wait(lock, [this]() { return stopping || queued.load() > 0; });
+        if (stopping) return;
+    }
+}
+
+void WorkStealingPool::waitIdle() {
+    std::unique_lock<std::mutex> lock(waitMutex);
+    idleCv.wait(lock, [this]() { return pending.load() == 0; });
+}
@@ -0,0 +1,54 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作窃取线程池：每个工作线程有自己的双端队列，优先从队尾取自己的任务（LIFO，缓存友好），
+// 空闲时从其他线程队首窃取（FIFO，先拿大块/早提交的任务），以平衡不均匀的分片。
+// 任务参数为执行它的工作线程编号（0 ~ size()-1），便于使用按线程划分的局部状态。
+class WorkStealingPool {
+public:
+    using Task = std::function<void(int)>;
+
+    explicit WorkStealingPool(int threads);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+    // 轮流投递到各线程队列
+    void submit(Task task);
+    // 阻塞直到所有已提交任务执行完毕
+    void waitIdle();
+    // 自上次 resetStats 以来的窃取次数
+    long long steals() const { return stealCount.load(); }
+    void resetStats() { stealCount = 0; }
+
+private:
+    struct Worker {
+        std::deque<Task> queue;
+        std::mutex mtx;
+        std::thread thread;
+    };
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex waitMutex;
+    std::condition_variable workCv;   // 有新任务
+    std::condition_variable idleCv;   // 全部完成
+    std::atomic<long long> pending{0};   // 已提交未完成（含执行中）
+    std::atomic<long long> queued{0};    // 仍在队列中等待执行
+    std::atomic<long long> stealCount{0};
+    std::atomic<unsigned> nextQueue{0};
+    bool stopping = false;
+
+    bool tryPop(int self, Task &out);
+    void workerLoop(int self);
+};
+
+#endif // THREAD_POOL_H
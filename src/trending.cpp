@@ -0,0 +1,195 @@
+#include "trending.h"
+#include "drug.h"
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+
+SpaceSaving::SpaceSaving(size_t capacity) : capacity(capacity < 1 ? 1 : capacity) {
+    slots.reserve(this->capacity);
+    pos.reserve(this->capacity * 2);
+}
+
+void SpaceSaving::swapSlots(size_t a, size_t b) {
+    std::swap(slots[a], slots[b]);
+    pos[slots[a].key] = a;
+    pos[slots[b].key] = b;
+}
+
+void SpaceSaving::siftUp(size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (slots[parent].count <= slots[i].count) break;
+        swapSlots(i, parent);
+        i = parent;
+    }
+}
+
+void SpaceSaving::siftDown(size_t i) {
+    const size_t n = slots.size();
+    while (true) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && slots[l].count < slots[m].count) m = l;
+        if (r < n && slots[r].count < slots[m].count) m = r;
+        if (m == i) return;
+        swapSlots(i, m);
+        i = m;
+    }
+}
+
+void SpaceSaving::add(const std::string &key, long long weight) {
+    if (weight <= 0) return;
+    auto it = pos.find(key);
+    if (it != pos.end()) {
+        slots[it->second].count += weight;
+        siftDown(it->second);
+        return;
+    }
+    if (slots.size() < capacity) {
+        slots.push_back(Item{ key, weight, 0 });
+        pos[key] = slots.size() - 1;
+        siftUp(slots.size() - 1);
+        return;
+    }
+    // 顶替最小项：新键继承其计数作为误差上界
+    Item &victim = slots[0];
+    pos.erase(victim.key);
+    victim.error = victim.count;
+    victim.count += weight;
+    victim.key = key;
+    pos[key] = 0;
+    siftDown(0);
+}
+
+void SpaceSaving::clear() {
+    slots.clear();
+    pos.clear();
+}
+
+WindowedTopK::WindowedTopK(long long bucketSeconds, int buckets, size_t capacity)
+    : bucketSeconds(bucketSeconds), ring(static_cast<size_t>(buckets)) {
+    for (auto &b : ring) b.sketch = SpaceSaving(capacity);
+}
+
+void WindowedTopK::add(const std::string &key, long long weight, long long t) {
+    long long epoch = t / bucketSeconds;
+    Bucket &b = ring[static_cast<size_t>(epoch % static_cast<long long>(ring.size()))];
+    if (b.epoch != epoch) {
+        // 回放历史流水时可能写到已被复用的旧桶，旧于桶内数据的时间直接忽略
+        if (b.epoch > epoch) return;
+        b.sketch.clear();
+        b.epoch = epoch;
+    }
+    b.sketch.add(key, weight);
+}
+
+std::vector<SpaceSaving::Item> WindowedTopK::top(size_t k, long long now) const {
+    const long long nowEpoch = now / bucketSeconds;
+    const long long oldest = nowEpoch - static_cast<long long>(ring.size()) + 1;
+    std::unordered_map<std::string, SpaceSaving::Item> merged;
+    std::unordered_map<std::string, long long> coveredBound; // 键所在的满员桶的最小计数之和
+    long long missingTotal = 0;                               // 全部满员桶的最小计数之和
+    for (const auto &b : ring) {
+        if (b.epoch < oldest || b.epoch > nowEpoch) continue;
+        const long long bound = b.sketch.missingBound();
+        missingTotal += bound;
+        for (const auto &it : b.sketch.items()) {
+            auto &m = merged[it.key];
+            m.key = it.key;
+            m.count += it.count;
+            m.error += it.error;
+            if (bound > 0) coveredBound[it.key] += bound;
+        }
+    }
+    std::vector<SpaceSaving::Item> list;
+    list.reserve(merged.size());
+    for (auto &kv : merged) {
+        // 键不在的满员桶：真实计数可能达到该桶最小计数
+        auto c = coveredBound.find(kv.first);
+        const long long absent = missingTotal - (c == coveredBound.end() ? 0 : c->second);
+        kv.second.count += absent;
+        kv.second.error += absent;
+        list.push_back(std::move(kv.second));
+    }
+    std::sort(list.begin(), list.end(), [](const SpaceSaving::Item &a, const SpaceSaving::Item &b) {
+        return a.count != b.count ? a.count > b.count : a.key < b.key;
+    });
+    if (list.size() > k) list.resize(k);
+    return list;
+}
+
+// 近 1 小时：12 × 5 分钟；近 1 天：24 × 1 小时；近 1 周：28 × 6 小时
+TrendTracker::WindowSet::WindowSet(size_t capacity) {
+    windows.emplace_back(5 * 60, 12, capacity);
+    windows.emplace_back(3600, 24, capacity);
+    windows.emplace_back(6 * 3600, 28, capacity);
+}
+
+const char *TrendTracker::windowLabel(TrendWindow w) {
+    switch (w) {
+        case TrendWindow::Hour: return "近1小时";
+        case TrendWindow::Day: return "近1天";
+        case TrendWindow::Week: return "近1周";
+    }
+    return "";
+}
+
+void TrendTracker::record(const std::string &drugName, const std::string &category, int quantity, long long t) {
+    if (quantity <= 0) return;
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!all) all = std::make_unique<WindowSet>(64);
+    auto &cat = byCategory[category];
+    if (!cat) cat = std::make_unique<WindowSet>(16);
+    for (int w = 0; w < kWindows; ++w) {
+        all->windows[static_cast<size_t>(w)].add(drugName, quantity, t);
+        cat->windows[static_cast<size_t>(w)].add(drugName, quantity, t);
+    }
+}
+
+std::vector<SpaceSaving::Item> TrendTracker::top(TrendWindow w, const std::string &category, size_t k, long long now) {
+    std::lock_guard<std::mutex> lock(mtx);
+    const WindowSet *set = nullptr;
+    if (category.empty()) set = all.get();
+    else {
+        auto it = byCategory.find(category);
+        if (it != byCategory.end()) set = it->second.get();
+    }
+    if (!set) return {};
+    return set->windows[static_cast<size_t>(w)].top(k, now);
+}
+
+std::vector<std::string> TrendTracker::categories() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<std::string> list;
+    for (const auto &kv : byCategory) list.push_back(kv.first);
+    return list;
+}
+
+void TrendTracker::clear() {
+    std::lock_guard<std::mutex> lock(mtx);
+    all.reset();
+    byCategory.clear();
+}
+
+long long trendClockNow() {
+    std::time_t now = std::time(nullptr);
+    std::tm tmNow{};
+#ifdef _WIN32
+    localtime_s(&tmNow, &now);
+#else
+    localtime_r(&now, &tmNow);
+#endif
+    return static_cast<long long>(todayDay()) * 86400 + tmNow.tm_hour * 3600 + tmNow.tm_min * 60 + tmNow.tm_sec;
+}
+
+// 解析 YYYY-MM-DDTHH:MM:SS（日期与时间之间也接受空格）
+bool trendParseTimestamp(const std::string &ts, long long &secondsOut) {
+    if (ts.size() < 19 || (ts[10] != 'T' && ts[10] != ' ') || ts[13] != ':' || ts[16] != ':') return false;
+    int day;
+    if (!dateToDay(ts.substr(0, 10), day)) return false;
+    for (int i : { 11, 12, 14, 15, 17, 18 }) if (!std::isdigit(static_cast<unsigned char>(ts[i]))) return false;
+    int h = (ts[11] - '0') * 10 + (ts[12] - '0');
+    int m = (ts[14] - '0') * 10 + (ts[15] - '0');
+    int s = (ts[17] - '0') * 10 + (ts[18] - '0');
+    secondsOut = static_cast<long long>(day) * 86400 + h * 3600 + m * 60 + s;
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef TRENDING_H
+#define TRENDING_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Space-Saving 摘要：最多保留 capacity 个计数器（按计数的最小堆），新键在满员时顶替最小项，
+// 被顶替的计数记为该键的误差上界。任何真实计数 > 总量/capacity 的键一定在摘要中。
+// 每次更新为一次哈希查找加 O(log capacity) 的堆调整，capacity 固定，与药品种数无关。
+class SpaceSaving {
+public:
+    struct Item {
+        std::string key;
+        long long count = 0;  // 估计值（≥ 真实值）
+        long long error = 0;  // 高估上界：真实值 ≥ count - error
+    };
+
+    explicit SpaceSaving(size_t capacity = 32);
+    void add(const std::string &key, long long weight);
+    void clear();
+    const std::vector<Item> &items() const { return slots; }
+    // 满员时未在摘要中的键真实计数不超过最小计数；未满时为 0
+    long long missingBound() const { return slots.size() < capacity ? 0 : slots[0].count; }
+
+private:
+    size_t capacity;
+    std::vector<Item> slots;                     // 按 count 的最小堆
+    std::unordered_map<std::string, size_t> pos; // 键 -> 堆中下标
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+    void swapSlots(size_t a, size_t b);
+};
+
+// 滑动窗口热销榜：窗口切成若干时间桶，每桶一个 Space-Saving 摘要，环形复用；
+// 查询时合并仍在窗口内的桶，键不在某个满员桶中时按该桶的最小计数补上（计入误差），合并结果仍是上界。
+// 窗口边界的精度为一个桶长。
+class WindowedTopK {
+public:
+    WindowedTopK(long long bucketSeconds, int buckets, size_t capacity);
+    void add(const std::string &key, long long weight, long long t);
+    std::vector<SpaceSaving::Item> top(size_t k, long long now) const;
+
+private:
+    struct Bucket {
+        long long epoch = -1;
+        SpaceSaving sketch;
+    };
+    long long bucketSeconds;
+    std::vector<Bucket> ring;
+};
+
+enum class TrendWindow { Hour = 0, Day = 1, Week = 2 };
+
+// 近 1 小时 / 1 天 / 1 周的热销药品（按销售数量），全店与各分类分别统计；线程安全
+class TrendTracker {
+public:
+    static const int kWindows = 3;
+    static const char *windowLabel(TrendWindow w);
+
+    void record(const std::string &drugName, const std::string &category, int quantity, long long t);
+    // category 为空表示全部药品
+    std::vector<SpaceSaving::Item> top(TrendWindow w, const std::string &category, size_t k, long long now);
+    std::vector<std::string> categories();
+    void clear();
+
+private:
+    struct WindowSet {
+        std::vector<WindowedTopK> windows;
+        explicit WindowSet(size_t capacity);
+    };
+    std::mutex mtx;
+    std::unique_ptr<WindowSet> all;
+    std::map<std::string, std::unique_ptr<WindowSet>> byCategory;
+};
+
+// 与流水时间戳同一基准的本地“朴素秒数”（按本地日期时间换算，不含时区）
+long long trendClockNow();
+bool trendParseTimestamp(const std::string &ts, long long &secondsOut);
+
+#endif // TRENDING_H